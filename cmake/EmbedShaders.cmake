@@ -0,0 +1,51 @@
+# Writes the SPIR-V binaries listed in SHADERS, name=path entries separated
+# by |, to OUTPUT as constexpr word arrays and a lookup table.
+# Run with cmake -DOUTPUT=<file> -DSHADERS=<entries> -P EmbedShaders.cmake
+
+string(REPLACE "|" ";" SHADERS "${SHADERS}")
+
+set(arrays "")
+set(table "")
+set(index 0)
+foreach(entry ${SHADERS})
+  string(FIND "${entry}" "=" split)
+  string(SUBSTRING "${entry}" 0 ${split} name)
+  math(EXPR start "${split} + 1")
+  string(SUBSTRING "${entry}" ${start} -1 path)
+
+  file(READ ${path} hex HEX)
+  string(LENGTH "${hex}" length)
+  math(EXPR remainder "${length} % 8")
+  if(length EQUAL 0 OR NOT remainder EQUAL 0)
+    message(FATAL_ERROR "${path} is not a SPIR-V binary")
+  endif()
+
+  # SPIR-V words are little endian, six of them per line
+  string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " words "${hex}")
+  # No {n} in CMake regular expressions, the group is spelled out
+  set(word "0x[0-9a-f]+, ")
+  set(line "${word}${word}${word}${word}${word}0x[0-9a-f]+,")
+  string(REGEX REPLACE "(${line}) " "\\1\n    " words "${words}")
+  string(REGEX REPLACE "\n    $" "" words "${words}")
+  string(REGEX REPLACE ", $" "," words "${words}")
+
+  string(APPEND arrays "// ${name}\n")
+  string(APPEND arrays "constexpr uint32_t shader${index}[] = {\n")
+  string(APPEND arrays "    ${words}\n};\n\n")
+  string(APPEND table "    {\"${name}\", shader${index},\n")
+  string(APPEND table "     sizeof(shader${index}) / sizeof(uint32_t)},\n")
+  math(EXPR index "${index} + 1")
+endforeach()
+
+set(content "// Generated by cmake/EmbedShaders.cmake, do not edit\n\n")
+string(APPEND content "#include \"embedded_shaders.h\"\n\n")
+string(APPEND content "namespace vkr {\n\nnamespace {\n\n${arrays}")
+string(APPEND content "}  // namespace\n\n")
+string(APPEND content "const EmbeddedShader embeddedShaders[] = {\n")
+string(APPEND content "${table}};\n\n")
+string(APPEND content "const size_t embeddedShaderCount =\n")
+string(APPEND content
+       "    sizeof(embeddedShaders) / sizeof(embeddedShaders[0]);\n\n")
+string(APPEND content "}  // namespace vkr\n")
+
+file(WRITE ${OUTPUT} "${content}")
@@ -0,0 +1,71 @@
+# Compiles GLSL to SPIR-V, optimizes it with spirv-opt and embeds every
+# binary in the executable, see include/embedded_shaders.h
+
+find_program(GLSLC glslc
+  HINTS $ENV{VULKAN_SDK}/bin $ENV{VK_SDK_PATH}/Bin)
+find_program(GLSLANG_VALIDATOR glslangValidator
+  HINTS $ENV{VULKAN_SDK}/bin $ENV{VK_SDK_PATH}/Bin)
+find_program(SPIRV_OPT spirv-opt
+  HINTS $ENV{VULKAN_SDK}/bin $ENV{VK_SDK_PATH}/Bin)
+
+if(NOT GLSLC AND NOT GLSLANG_VALIDATOR)
+  message(FATAL_ERROR "glslc or glslangValidator is required for the shaders")
+endif()
+if(NOT SPIRV_OPT)
+  message(FATAL_ERROR "spirv-opt is required to optimize the shaders")
+endif()
+
+# vkr_add_shader(<name> <source> [DEFINES <define>...])
+#
+# Builds shaders/<source> into the binary looked up as <name>. Calling it
+# again for the same source with other DEFINES adds a variant; feature
+# toggles that only change constants should stay specialization constants.
+function(vkr_add_shader NAME SOURCE)
+  cmake_parse_arguments(SHADER "" "" "DEFINES" ${ARGN})
+
+  set(input ${CMAKE_SOURCE_DIR}/shaders/${SOURCE})
+  set(compiled ${CMAKE_BINARY_DIR}/shaders/${NAME}.unoptimized.spv)
+  set(output ${CMAKE_BINARY_DIR}/shaders/${NAME}.spv)
+
+  set(defines "")
+  foreach(define ${SHADER_DEFINES})
+    list(APPEND defines -D${define})
+  endforeach()
+
+  if(GLSLC)
+    set(compile ${GLSLC} ${defines} ${input} -o ${compiled})
+  else()
+    set(compile ${GLSLANG_VALIDATOR} -V ${defines} ${input} -o ${compiled})
+  endif()
+  add_custom_command(
+    OUTPUT ${output}
+    COMMAND ${CMAKE_COMMAND} -E make_directory ${CMAKE_BINARY_DIR}/shaders
+    COMMAND ${compile}
+    COMMAND ${SPIRV_OPT} -O ${compiled} -o ${output}
+    DEPENDS ${input}
+    COMMENT "Compiling shader ${NAME}"
+    VERBATIM
+  )
+
+  set_property(GLOBAL APPEND PROPERTY VKR_SHADER_ENTRIES "${NAME}=${output}")
+  set_property(GLOBAL APPEND PROPERTY VKR_SHADER_OUTPUTS ${output})
+endfunction()
+
+# vkr_embed_shaders(<output>)
+#
+# Generates <output>, a source file holding every shader added so far.
+function(vkr_embed_shaders OUTPUT)
+  get_property(entries GLOBAL PROPERTY VKR_SHADER_ENTRIES)
+  get_property(outputs GLOBAL PROPERTY VKR_SHADER_OUTPUTS)
+  # Lists do not survive -D, so the entries travel separated by |
+  string(REPLACE ";" "|" entries "${entries}")
+
+  add_custom_command(
+    OUTPUT ${OUTPUT}
+    COMMAND ${CMAKE_COMMAND} -DOUTPUT=${OUTPUT} -DSHADERS=${entries}
+            -P ${CMAKE_SOURCE_DIR}/cmake/EmbedShaders.cmake
+    DEPENDS ${outputs} ${CMAKE_SOURCE_DIR}/cmake/EmbedShaders.cmake
+    COMMENT "Embedding SPIR-V"
+    VERBATIM
+  )
+endfunction()
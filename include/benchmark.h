@@ -0,0 +1,36 @@
+/**
+ * @file benchmark.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_BENCHMARK_H_
+#define VK_RENDERER_BENCHMARK_H_
+
+namespace vkr {
+
+/**
+ * @brief Headless job system stress test and 1..N thread scaling benchmark.
+ *
+ * Needs no window or Vulkan device. Returns EXIT_FAILURE if a stress test
+ * produces a wrong result.
+ */
+int runJobSystemBenchmark();
+
+/**
+ * @brief Frustum culling throughput in objects per millisecond.
+ *
+ * Runs the scalar reference, the SIMD path and the parallel chunked path
+ * over random bounding spheres. Returns EXIT_FAILURE if the visible lists
+ * differ.
+ */
+int runCullingBenchmark();
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_BENCHMARK_H_
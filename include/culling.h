@@ -0,0 +1,79 @@
+/**
+ * @file culling.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_CULLING_H_
+#define VK_RENDERER_CULLING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "job_system.h"
+
+namespace vkr {
+
+// Planes point inwards, xyz is the unit normal and w the distance
+struct Frustum {
+  glm::vec4 planes[6];
+};
+
+/**
+ * @brief Bounding spheres stored as structure of arrays.
+ *
+ * One array per component, so the culling loop loads a register of
+ * centers or radii at a time.
+ */
+struct SphereBounds {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  std::vector<float> radius;
+
+  size_t size() const;
+  void reserve(size_t count);
+  void clear();
+  // xyz is the center, w the radius
+  void push_back(const glm::vec4& sphere);
+};
+
+// Planes of the [0, 1] depth clip volume of a Vulkan projection
+Frustum extractFrustum(const glm::mat4& viewProj);
+
+/**
+ * @brief Writes the indices of the spheres in [begin, end) that touch the
+ * frustum to visible and returns how many there are.
+ *
+ * Tests four spheres per iteration with SSE, and one at a time otherwise.
+ * visible needs room for end - begin indices.
+ */
+size_t cullSpheres(const Frustum& frustum, const SphereBounds& bounds,
+                   size_t begin, size_t end, uint32_t* visible);
+
+// Reference path, one sphere at a time whatever the build supports
+size_t cullSpheresScalar(const Frustum& frustum, const SphereBounds& bounds,
+                         size_t begin, size_t end, uint32_t* visible);
+
+/**
+ * @brief Culls every sphere in parallel chunks into a compact, sorted list.
+ *
+ * Each chunk fills its own range of visible, the ranges are then packed
+ * together in order. Returns the number of visible spheres.
+ */
+size_t cullSpheres(JobSystem& jobSystem, const Frustum& frustum,
+                   const SphereBounds& bounds, std::vector<uint32_t>& visible);
+
+// "SSE" or "scalar"
+const char* getCullingInstructionSet();
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_CULLING_H_
@@ -0,0 +1,46 @@
+/**
+ * @file deletion_queue.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_DELETION_QUEUE_H_
+#define VK_RENDERER_DELETION_QUEUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace vkr {
+
+/**
+ * @brief Destroys GPU objects once no submitted frame can use them anymore.
+ *
+ * Every deleter is tagged with the number of frames submitted when it was
+ * retired, and runs once that many frames are known to have completed.
+ */
+class DeletionQueue {
+ public:
+  void push(uint64_t frame, std::function<void()> deleter);
+  void flush(uint64_t completedFrames);
+
+  size_t size() const;
+
+ private:
+  struct Entry {
+    uint64_t frame;
+    std::function<void()> deleter;
+  };
+
+  std::deque<Entry> entries_;
+};
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_DELETION_QUEUE_H_
@@ -0,0 +1,129 @@
+/**
+ * @file descriptor_allocator.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_DESCRIPTOR_ALLOCATOR_H_
+#define VK_RENDERER_DESCRIPTOR_ALLOCATOR_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace vkr {
+
+/**
+ * @brief Descriptor set layouts shared by binding signature.
+ *
+ * Bindings are sorted before hashing, so the same signature declared in any
+ * order maps to one layout. A hash hit is only used when the stored bindings
+ * match as well. Layouts live until the cache is destroyed.
+ * Safe to call from any thread.
+ */
+class DescriptorLayoutCache {
+ public:
+  DescriptorLayoutCache() = delete;
+  DescriptorLayoutCache(VkDevice device);
+  DescriptorLayoutCache(const DescriptorLayoutCache&) = delete;
+  DescriptorLayoutCache& operator=(const DescriptorLayoutCache&) = delete;
+  ~DescriptorLayoutCache();
+
+  VkDescriptorSetLayout get(
+      std::vector<VkDescriptorSetLayoutBinding> bindings);
+  uint32_t getLayoutCount() const;
+
+ private:
+  struct Layout {
+    // pImmutableSamplers is only kept to tell bindings with samplers apart,
+    // the handles themselves are copied to immutableSamplers
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    std::vector<VkSampler> immutableSamplers;
+    VkDescriptorSetLayout layout;
+  };
+
+  VkDevice device_;
+  mutable std::mutex mutex_;
+  // Layouts whose bindings collide on the hash share a bucket
+  std::unordered_map<uint64_t, std::vector<Layout>> layouts_;
+};
+
+struct DescriptorPoolRatio {
+  VkDescriptorType type;
+  float descriptorsPerSet;
+};
+
+/**
+ * @brief Descriptor sets from a growing list of pools.
+ *
+ * When a pool runs out of memory or is fragmented, another pool is created,
+ * each one twice the size of the last up to a limit. Sets are never freed
+ * one by one; reset() returns every pool in a single call, which is how the
+ * per-frame allocators are recycled once their frame's fence has signaled.
+ * Not thread safe.
+ */
+class DescriptorAllocator {
+ public:
+  DescriptorAllocator() = delete;
+  DescriptorAllocator(VkDevice device, uint32_t setsPerPool,
+                      const std::vector<DescriptorPoolRatio>& ratios);
+  DescriptorAllocator(const DescriptorAllocator&) = delete;
+  DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+  ~DescriptorAllocator();
+
+  VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+  void reset();
+
+  uint32_t getPoolCount() const;
+  uint32_t getSetCount() const;
+
+ private:
+  VkDevice device_;
+  uint32_t setsPerPool_;
+  std::vector<DescriptorPoolRatio> ratios_;
+  std::vector<VkDescriptorPool> readyPools_;
+  std::vector<VkDescriptorPool> fullPools_;
+  uint32_t setCount_ = 0;
+
+  VkDescriptorPool takePool();
+  VkDescriptorPool createPool(uint32_t setCount);
+};
+
+/**
+ * @brief Writes a whole descriptor set from one packed struct.
+ *
+ * Entries give the offset and stride of each binding's VkDescriptorImageInfo,
+ * VkDescriptorBufferInfo or VkBufferView inside the struct. Devices older
+ * than Vulkan 1.1 get the same writes through vkUpdateDescriptorSets.
+ */
+class DescriptorUpdateTemplate {
+ public:
+  DescriptorUpdateTemplate() = delete;
+  DescriptorUpdateTemplate(
+      VkDevice device, VkPhysicalDevice physicalDevice,
+      VkDescriptorSetLayout layout,
+      const std::vector<VkDescriptorUpdateTemplateEntry>& entries);
+  DescriptorUpdateTemplate(const DescriptorUpdateTemplate&) = delete;
+  DescriptorUpdateTemplate& operator=(const DescriptorUpdateTemplate&) =
+      delete;
+  ~DescriptorUpdateTemplate();
+
+  void update(VkDescriptorSet set, const void* data) const;
+
+ private:
+  VkDevice device_;
+  std::vector<VkDescriptorUpdateTemplateEntry> entries_;
+  VkDescriptorUpdateTemplate updateTemplate_ = VK_NULL_HANDLE;
+};
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_DESCRIPTOR_ALLOCATOR_H_
@@ -0,0 +1,41 @@
+/**
+ * @file embedded_shaders.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_EMBEDDED_SHADERS_H_
+#define VK_RENDERER_EMBEDDED_SHADERS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace vkr {
+
+/**
+ * @brief Optimized SPIR-V compiled into the executable.
+ *
+ * The table is generated at build time by cmake/EmbedShaders.cmake from every
+ * vkr_add_shader() call, names are the ones given there.
+ */
+struct EmbeddedShader {
+  const char* name;
+  const uint32_t* code;
+  size_t wordCount;
+};
+
+extern const EmbeddedShader embeddedShaders[];
+extern const size_t embeddedShaderCount;
+
+// Returns nullptr when no shader of that name was embedded
+const EmbeddedShader* findEmbeddedShader(const std::string& name);
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_EMBEDDED_SHADERS_H_
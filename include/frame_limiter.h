@@ -0,0 +1,43 @@
+/**
+ * @file frame_limiter.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_FRAME_LIMITER_H_
+#define VK_RENDERER_FRAME_LIMITER_H_
+
+#include <chrono>
+
+namespace vkr {
+
+/**
+ * @brief CPU-side frame pacing with sleep plus spin.
+ *
+ * Sleeps until shortly before the deadline and spins for the rest. The spin
+ * margin follows the measured oversleep of the OS scheduler, so it stays
+ * small on systems with fine-grained timers.
+ */
+class FrameLimiter {
+ public:
+  void setFrameRate(double frameRate);
+
+  // Blocks until the next frame is due, returns the time spent waiting in ms
+  double wait();
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  Clock::duration period_{0};
+  Clock::time_point nextFrame_{};
+  Clock::duration spinMargin_ = std::chrono::milliseconds(2);
+};
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_FRAME_LIMITER_H_
@@ -17,6 +17,13 @@
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan.h>
 
+#include <vector>
+
+#include "profiler.h"
+#include "settings.h"
+
+struct ImDrawList;
+
 namespace vkr {
 
 struct GUIConfig {
@@ -35,21 +42,50 @@ struct GUIConfig {
   uint32_t subpass;
   uint32_t descriptorPoolSize;
   bool useDynamicRendering;
-#ifdef IMGUI_IMPL_VULKAN_HAS_DYNAMIC_RENDERING
   VkPipelineRenderingCreateInfoKHR pipelineRenderingCreateInfo;
-#endif
   const VkAllocationCallbacks* allocator;
   void (*checkVkResultFn)(VkResult err);
   VkDeviceSize minAllocationSize;
 };
 
+/**
+ * @brief Copy of one frame of ImGui draw data.
+ *
+ * Built on the thread that owns GLFW and ImGui, then handed to the render
+ * thread, so recording never reads the draw lists ImGui is building. The
+ * copies are plain buffers, never passed back to ImGui for editing.
+ */
+class GUIFrame {
+ public:
+  GUIFrame() = default;
+  GUIFrame(const GUIFrame&) = delete;
+  GUIFrame& operator=(const GUIFrame&) = delete;
+  ~GUIFrame();
+
+ private:
+  friend class GUI;
+
+  std::vector<ImDrawList*> drawLists_;
+  size_t drawListCount_ = 0;
+  float displayPos_[2]{};
+  float displaySize_[2]{};
+  float framebufferScale_[2]{};
+};
+
 class GUI {
  public:
   GUI() = delete;
   GUI(const GUIConfig& config);
   ~GUI();
 
-  void draw(VkCommandBuffer commandBuffer);
+  void buildFrame(GUIFrame& frame, const Profiler& profiler,
+                  RenderSettings& settings);
+  void draw(VkCommandBuffer commandBuffer, const GUIFrame& frame);
+  // Milliseconds spent in the backend init, which builds the pipeline
+  double getPipelineTime() const;
+
+ private:
+  double pipelineTime_ = 0.0;
 };
 
 }  // namespace vkr
@@ -0,0 +1,124 @@
+/**
+ * @file job_system.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_JOB_SYSTEM_H_
+#define VK_RENDERER_JOB_SYSTEM_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vkr {
+
+class JobSystem;
+
+/**
+ * @brief Number of unfinished jobs in a group.
+ *
+ * Jobs queued with runAfter() start once the counter drops to zero. The first
+ * exception thrown by a job of the group is rethrown by JobSystem::wait().
+ */
+class JobCounter {
+ public:
+  JobCounter() = default;
+  JobCounter(const JobCounter&) = delete;
+  JobCounter& operator=(const JobCounter&) = delete;
+
+  bool isDone() const;
+
+ private:
+  friend class JobSystem;
+
+  struct Continuation {
+    std::function<void()> job;
+    JobCounter* counter;
+  };
+
+  std::atomic<uint32_t> pending_{0};
+  std::mutex mutex_;
+  std::vector<Continuation> continuations_;
+  std::exception_ptr exception_;
+};
+
+/**
+ * @brief Work-stealing job scheduler.
+ *
+ * Every worker owns a deque: it pops its own jobs LIFO and steals from the
+ * others FIFO. Jobs submitted from outside the pool go to a shared queue.
+ * Threads blocked in wait() execute jobs instead of sleeping, so nested
+ * parallelFor() calls cannot deadlock and a pool with zero workers runs
+ * everything on the waiting thread.
+ *
+ * Background jobs are only picked up by idle workers and never by a thread
+ * blocked in wait(), so a long job cannot stall a frame. Without workers
+ * wait() runs them as a last resort.
+ */
+class JobSystem {
+ public:
+  using Job = std::function<void()>;
+
+  JobSystem() = delete;
+  JobSystem(uint32_t workerCount);
+  ~JobSystem();
+
+  uint32_t getWorkerCount() const;
+
+  void run(Job job, JobCounter* counter = nullptr);
+  void runAfter(JobCounter& dependency, Job job, JobCounter* counter = nullptr);
+  void runBackground(Job job, JobCounter* counter = nullptr);
+  void wait(JobCounter& counter);
+  void parallelFor(size_t count, size_t grainSize,
+                   const std::function<void(size_t begin, size_t end)>& body);
+
+  static uint32_t getDefaultWorkerCount();
+
+ private:
+  struct Task {
+    Job job;
+    JobCounter* counter;
+  };
+
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<TaskQueue>> queues_;
+  std::atomic<uint32_t> queuedTasks_{0};
+  TaskQueue backgroundQueue_;
+  std::atomic<uint32_t> queuedBackgroundTasks_{0};
+  std::mutex sleepMutex_;
+  std::condition_variable sleepCondition_;
+  bool stop_ = false;
+
+  void push(Task task);
+  bool pop(uint32_t queueIndex, Task& task);
+  bool steal(uint32_t queueIndex, Task& task);
+  bool tryExecute();
+  bool tryExecuteBackground();
+  void execute(Task& task);
+  void finish(JobCounter* counter, std::exception_ptr exception);
+  void workerLoop(uint32_t workerIndex);
+  uint32_t getCurrentQueueIndex() const;
+};
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_JOB_SYSTEM_H_
@@ -0,0 +1,45 @@
+/**
+ * @file light_benchmark.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_LIGHT_BENCHMARK_H_
+#define VK_RENDERER_LIGHT_BENCHMARK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace vkr {
+
+/**
+ * @brief Sweeps the light count from 10 to 10k and reports GPU times.
+ *
+ * Drives the renderer's light count: every step skips a few frames, so the
+ * frames in flight with the last count drain, then averages the measured
+ * ones and prints a row of the table.
+ */
+class LightBenchmark {
+ public:
+  explicit LightBenchmark(const std::string& description);
+
+  uint32_t getLightCount() const;
+  // Feeds one frame's GPU times in ms, returns true after the last step
+  bool addFrame(double frameTime, double binningTime);
+
+ private:
+  size_t step_ = 0;
+  uint32_t frame_ = 0;
+  double frameTime_ = 0.0;
+  double binningTime_ = 0.0;
+};
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_LIGHT_BENCHMARK_H_
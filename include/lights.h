@@ -0,0 +1,48 @@
+/**
+ * @file lights.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_LIGHTS_H_
+#define VK_RENDERER_LIGHTS_H_
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace vkr {
+
+// Froxels: screen tiles split into exponential depth slices. Matches the
+// constants of light_binning.comp and shader.frag
+const uint32_t clusterGridX = 16;
+const uint32_t clusterGridY = 9;
+const uint32_t clusterGridZ = 24;
+const uint32_t clusterCount = clusterGridX * clusterGridY * clusterGridZ;
+// Lights past this many in one cluster are dropped from it
+const uint32_t maxLightsPerCluster = 256;
+const uint32_t maxLightCount = 16384;
+
+// Storage buffer element of the lighting buffer, in scene space
+struct PointLight {
+  glm::vec4 position;  // xyz, w is the radius of influence
+  glm::vec4 color;     // rgb, w unused
+};
+
+/**
+ * @brief Scatters count point lights through the box around a sphere.
+ *
+ * The same count always gives the same lights. The radius shrinks with the
+ * cube root of the count, so about as many lights overlap any point
+ * whatever the count is.
+ */
+std::vector<PointLight> createLights(uint32_t count, const glm::vec4& sphere);
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_LIGHTS_H_
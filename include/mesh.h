@@ -0,0 +1,82 @@
+/**
+ * @file mesh.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_MESH_H_
+#define VK_RENDERER_MESH_H_
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "job_system.h"
+
+namespace vkr {
+
+struct Vertex {
+  glm::vec3 pos;
+  glm::vec3 color;
+  glm::vec2 texCoord;
+
+  static VkVertexInputBindingDescription getBindingDescription();
+  static std::array<VkVertexInputAttributeDescription, 3>
+  getAttributeDescriptions();
+
+  bool operator==(const Vertex& other) const;
+};
+
+// Per-instance vertex stream, binding 1 of the scene pipelines
+struct InstanceData {
+  glm::mat4 model;
+  uint32_t materialId;
+
+  static VkVertexInputBindingDescription getBindingDescription();
+  static std::array<VkVertexInputAttributeDescription, 5>
+  getAttributeDescriptions();
+};
+
+struct DrawCommand {
+  uint32_t indexCount;
+  uint32_t firstIndex;
+  int32_t vertexOffset;
+};
+
+struct MeshData {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  std::vector<DrawCommand> drawCommands;
+};
+
+/**
+ * @brief Loads an OBJ file into a deduplicated, indexed mesh.
+ *
+ * Parsing is serial; vertex assembly and deduplication run on the job
+ * system. Needs no Vulkan device, so it can be benchmarked headless.
+ */
+MeshData loadMesh(const std::string& path, JobSystem& jobSystem);
+
+// xyz is the center of the vertices' bounding box, w the radius around it
+glm::vec4 getBoundingSphere(const std::vector<Vertex>& vertices);
+
+/**
+ * @brief Places count copies of a model on a square grid.
+ *
+ * Copies are scaled down so the grid covers the footprint of a single model,
+ * a count of 1 is one untransformed copy. Material IDs alternate between
+ * neighbours.
+ */
+std::vector<InstanceData> createInstanceGrid(uint32_t count);
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_MESH_H_
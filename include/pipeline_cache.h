@@ -0,0 +1,59 @@
+/**
+ * @file pipeline_cache.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_PIPELINE_CACHE_H_
+#define VK_RENDERER_PIPELINE_CACHE_H_
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+namespace vkr {
+
+/**
+ * @brief VkPipelineCache persisted to a file between runs.
+ *
+ * The file is only handed to the driver when its header matches the vendor,
+ * device and pipeline cache UUID of the current physical device; anything
+ * else starts an empty cache. save() writes a temporary file and renames it
+ * over the old one, so an interrupted save never leaves a truncated cache.
+ */
+class PipelineCache {
+ public:
+  PipelineCache() = delete;
+  PipelineCache(VkDevice device, VkPhysicalDevice physicalDevice,
+                const std::string& path);
+  PipelineCache(const PipelineCache&) = delete;
+  PipelineCache& operator=(const PipelineCache&) = delete;
+  ~PipelineCache();
+
+  VkPipelineCache get() const;
+  bool isWarm() const;
+  const std::string& getStatus() const;
+
+  // Returns false and leaves the previous file in place on failure
+  bool save() const;
+
+ private:
+  VkDevice device_;
+  VkPhysicalDevice physicalDevice_;
+  std::string path_;
+  VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+  bool warm_ = false;
+  std::string status_;
+
+  bool validateHeader(const std::vector<char>& data);
+};
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_PIPELINE_CACHE_H_
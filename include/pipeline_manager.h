@@ -0,0 +1,178 @@
+/**
+ * @file pipeline_manager.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_PIPELINE_MANAGER_H_
+#define VK_RENDERER_PIPELINE_MANAGER_H_
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "descriptor_allocator.h"
+#include "job_system.h"
+#include "profiler.h"
+#include "shader_reflection.h"
+
+namespace vkr {
+
+struct PipelineState {
+  std::string name;  // for reporting only, not part of the key
+  std::string vertexShader;
+  std::string fragmentShader;  // empty for depth-only pipelines
+  // 32-bit value of constant_id i in both stages
+  std::vector<uint32_t> specialization;
+  std::vector<VkVertexInputBindingDescription> vertexBindings;
+  std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+  VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  bool depthTest = true;
+  bool depthWrite = true;
+  VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+  // Off while both are 0
+  float depthBiasConstant = 0.f;
+  float depthBiasSlope = 0.f;
+  bool blendEnable = false;
+  VkBlendFactor srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  VkBlendFactor dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+  VkBlendOp colorBlendOp = VK_BLEND_OP_ADD;
+  VkBlendFactor srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  VkBlendFactor dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  VkBlendOp alphaBlendOp = VK_BLEND_OP_ADD;
+  // Must be 0 without a fragment shader
+  VkColorComponentFlags colorWriteMask =
+      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+  bool sampleShading = false;
+  float minSampleShading = 0.f;
+  VkFormat colorFormat = VK_FORMAT_UNDEFINED;  // undefined for depth only
+  VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+  VkRenderPass renderPass = VK_NULL_HANDLE;  // null with dynamic rendering
+  VkPipelineLayout layout = VK_NULL_HANDLE;  // null to reflect the shaders
+};
+
+struct PipelineLayoutInfo {
+  VkPipelineLayout layout;
+  std::vector<VkDescriptorSetLayout> setLayouts;
+  std::vector<VkPushConstantRange> pushConstantRanges;
+};
+
+/**
+ * @brief Graphics pipelines keyed by a hash of their complete state.
+ *
+ * build() compiles and waits for the result, helping with other jobs in the
+ * meantime; request() queues the compile as a background job and returns at
+ * once. build() throws when the pipeline failed to compile, whichever call
+ * started the compile. Until a requested pipeline is ready,
+ * get() hands out a ready pipeline that shares its layout, vertex input and
+ * render targets, or VK_NULL_HANDLE when the draws have to be skipped.
+ *
+ * Keys start at the state hash. A state that collides with another one
+ * takes the next free key, so a hit always compares the full state.
+ *
+ * Pipeline layouts are derived from SPIR-V reflection of the two stages and
+ * shared by every shader pair with the same interface. Vertex attributes
+ * are checked against the reflected shader inputs before compiling.
+ */
+class PipelineManager {
+ public:
+  PipelineManager() = delete;
+  PipelineManager(VkDevice device, VkPipelineCache pipelineCache,
+                  DescriptorLayoutCache& descriptorLayouts,
+                  JobSystem& jobSystem, Profiler& profiler);
+  PipelineManager(const PipelineManager&) = delete;
+  PipelineManager& operator=(const PipelineManager&) = delete;
+  ~PipelineManager();
+
+  uint64_t build(const PipelineState& state);
+  uint64_t request(const PipelineState& state);
+
+  VkPipeline get(uint64_t key) const;
+  bool isReady(uint64_t key) const;
+
+  // Owned by the manager, valid until it is destroyed
+  const PipelineLayoutInfo& getLayout(const std::string& vertexShader,
+                                      const std::string& fragmentShader);
+  const PipelineLayoutInfo& getComputeLayout(const std::string& computeShader);
+
+  // Compute pipelines have no variants, each is built on first use
+  VkPipeline getCompute(const std::string& computeShader);
+
+  // Changes whenever a background compile finishes
+  uint64_t getVersion() const;
+  uint32_t getPipelineCount() const;
+  uint32_t getPendingCount() const;
+
+  static uint64_t hash(const PipelineState& state);
+  static uint64_t hashCompatibility(const PipelineState& state);
+
+ private:
+  enum Status {
+    Pending,
+    Ready,
+    Failed,
+  };
+
+  struct Entry {
+    PipelineState state;
+    uint64_t compatibilityKey;
+    Status status;
+    VkPipeline pipeline;
+    // Tracks the compile, so build() can wait for this entry alone
+    std::unique_ptr<JobCounter> counter;
+    // Why the compile failed, rethrown by every build() of the entry
+    std::exception_ptr error;
+  };
+
+  struct Shader {
+    VkShaderModule module;
+    ShaderReflection reflection;
+  };
+
+  VkDevice device_;
+  VkPipelineCache pipelineCache_;
+  DescriptorLayoutCache& descriptorLayouts_;
+  JobSystem& jobSystem_;
+  Profiler& profiler_;
+  mutable std::mutex mutex_;
+  std::unordered_map<uint64_t, Entry> entries_;
+  // Entry key of the first ready pipeline for each compatibility hash
+  std::unordered_map<uint64_t, uint64_t> fallbacks_;
+  std::unordered_map<std::string, Shader> shaders_;
+  std::unordered_map<std::string, PipelineLayoutInfo> layouts_;
+  // Layouts whose interfaces collide on the hash share a bucket
+  std::unordered_map<uint64_t, std::vector<PipelineLayoutInfo>>
+      pipelineLayouts_;
+  std::unordered_map<std::string, VkPipeline> computePipelines_;
+  std::atomic<uint64_t> version_{0};
+
+  // Called with mutex_ held
+  uint64_t findKey(const PipelineState& state) const;
+  Entry& addEntry(uint64_t key, const PipelineState& state);
+  VkPipeline compile(const PipelineState& state);
+  void finish(uint64_t key, VkPipeline pipeline, std::exception_ptr error);
+  const Shader& getShader(const std::string& path);
+  // Called with mutex_ held
+  const PipelineLayoutInfo& createLayout(
+      const std::string& key, const std::vector<ShaderReflection>& stages);
+};
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_PIPELINE_MANAGER_H_
@@ -0,0 +1,46 @@
+/**
+ * @file profiler.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_PROFILER_H_
+#define VK_RENDERER_PROFILER_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace vkr {
+
+struct ProfilerEntry {
+  std::string name;
+  double value;
+  bool isTime;  // milliseconds, smoothed over frames
+  std::string text;
+};
+
+class Profiler {
+ public:
+  void setTime(const std::string& name, double milliseconds);
+  void setCounter(const std::string& name, uint64_t count);
+  void setText(const std::string& name, const std::string& text);
+
+  std::vector<ProfilerEntry> getEntries() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<ProfilerEntry> entries_;
+
+  ProfilerEntry& findOrAdd(const std::string& name, bool isTime);
+};
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_PROFILER_H_
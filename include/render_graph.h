@@ -0,0 +1,250 @@
+/**
+ * @file render_graph.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_RENDER_GRAPH_H_
+#define VK_RENDERER_RENDER_GRAPH_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace vkr {
+
+struct RenderGraphImageInfo {
+  VkFormat format;
+  VkExtent2D extent;
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+  VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+  uint32_t mipLevels = 1;
+  VkImageUsageFlags usage = 0;  // on top of what the passes declare
+};
+
+/**
+ * @brief Frame graph that derives synchronization from declared accesses.
+ *
+ * Passes declare which resources they read and write. compile() drops passes
+ * that do not contribute to an output, places transient images with disjoint
+ * lifetimes in shared memory, and works out the synchronization2 barriers
+ * that have to precede each pass. The compiled graph is replayed every frame
+ * by execute(); imported resources may change handles between frames.
+ *
+ * Passes can ask for the async compute queue. When it has a family of its
+ * own, compile() splits the passes into batches, one submission each, that
+ * wait on the other queue's batches only where a pass needs their results.
+ * Resources moving between the queues get ownership transfers, and the last
+ * batch, on the graphics queue, waits for all async work so the frame's
+ * fence covers it.
+ */
+class RenderGraph {
+ public:
+  enum Usage {
+    ColorAttachment,
+    DepthAttachment,
+    DepthRead,
+    SampledFragment,
+    SampledCompute,
+    StorageReadCompute,
+    StorageWriteCompute,
+    StorageReadGraphics,
+    TransferSrc,
+    TransferDst,
+    IndirectRead,
+  };
+
+  enum Queue {
+    GraphicsQueue,
+    AsyncComputeQueue,
+  };
+
+  using Record = std::function<void(VkCommandBuffer commandBuffer)>;
+
+  RenderGraph() = delete;
+  RenderGraph(VkDevice device, VkPhysicalDevice physicalDevice,
+              PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2);
+  RenderGraph(const RenderGraph&) = delete;
+  RenderGraph& operator=(const RenderGraph&) = delete;
+  ~RenderGraph();
+
+  // Async passes get a queue of their own only when the families differ
+  void setQueueFamilies(uint32_t graphicsFamily, uint32_t computeFamily);
+
+  // Images owned elsewhere; initialStage is where earlier work, or the
+  // semaphore wait that hands the image over, last touched it, on queue.
+  // Resources the async queue starts with must end the frame there too
+  uint32_t importImage(const std::string& name, VkImageAspectFlags aspect,
+                       VkImageLayout initialLayout,
+                       VkPipelineStageFlags2 initialStage,
+                       VkImageLayout finalLayout,
+                       Queue queue = GraphicsQueue);
+  uint32_t importBuffer(const std::string& name,
+                        VkPipelineStageFlags2 initialStage,
+                        VkAccessFlags2 initialAccess,
+                        Queue queue = GraphicsQueue);
+  uint32_t createImage(const std::string& name,
+                       const RenderGraphImageInfo& info);
+
+  void setImportedImage(uint32_t resource, VkImage image,
+                        VkImageView imageView);
+  void setImportedBuffer(uint32_t resource, VkBuffer buffer);
+  void markOutput(uint32_t resource);
+
+  uint32_t addPass(const std::string& name, Record record,
+                   Queue queue = GraphicsQueue);
+  void read(uint32_t pass, uint32_t resource, Usage usage);
+  void write(uint32_t pass, uint32_t resource, Usage usage);
+
+  void compile();
+  // Batches are submitted in order, each to its queue, and signal their
+  // semaphore when isBatchSignaled(). The last one is on the graphics queue
+  void execute(uint32_t batch, VkCommandBuffer commandBuffer) const;
+  void dump(std::ostream& out) const;
+
+  uint32_t getBatchCount() const;
+  Queue getBatchQueue(uint32_t batch) const;
+  // Earlier batches of the other queue, whose semaphores this one waits on
+  const std::vector<uint32_t>& getBatchWaits(uint32_t batch) const;
+  bool isBatchSignaled(uint32_t batch) const;
+  // Where a semaphore handing an imported resource over has to be waited on
+  uint32_t getFirstBatch(uint32_t resource) const;
+
+  VkImage getImage(uint32_t resource) const;
+  VkImageView getImageView(uint32_t resource) const;
+  VkBuffer getBuffer(uint32_t resource) const;
+
+  uint32_t getPassCount() const;
+  uint32_t getCulledPassCount() const;
+  uint32_t getBarrierCount() const;
+  VkDeviceSize getTransientMemorySize() const;
+  VkDeviceSize getUnaliasedMemorySize() const;
+
+ private:
+  enum ResourceType {
+    ImportedImage,
+    ImportedBuffer,
+    TransientImage,
+  };
+
+  struct Resource {
+    std::string name;
+    ResourceType type;
+    RenderGraphImageInfo info;
+    VkImageLayout initialLayout;
+    VkImageLayout finalLayout;
+    VkPipelineStageFlags2 initialStage;
+    VkAccessFlags2 initialAccess;
+    Queue queue;
+    bool output;
+    VkImage image;
+    VkImageView imageView;
+    VkBuffer buffer;
+    uint32_t firstPass;
+    uint32_t lastPass;
+    uint32_t block;
+    VkDeviceSize size;
+  };
+
+  struct Access {
+    uint32_t resource;
+    VkPipelineStageFlags2 stage;
+    VkAccessFlags2 readAccess;
+    VkAccessFlags2 writeAccess;
+    VkImageLayout layout;
+    VkImageUsageFlags imageUsage;
+  };
+
+  struct ImageBarrier {
+    uint32_t resource;
+    VkPipelineStageFlags2 srcStage;
+    VkAccessFlags2 srcAccess;
+    VkPipelineStageFlags2 dstStage;
+    VkAccessFlags2 dstAccess;
+    VkImageLayout oldLayout;
+    VkImageLayout newLayout;
+    uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+    uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+  };
+
+  // Buffers only need barriers of their own to change queues
+  struct BufferBarrier {
+    uint32_t resource;
+    VkPipelineStageFlags2 srcStage;
+    VkAccessFlags2 srcAccess;
+    VkPipelineStageFlags2 dstStage;
+    VkAccessFlags2 dstAccess;
+    uint32_t srcQueueFamily;
+    uint32_t dstQueueFamily;
+  };
+
+  struct Barriers {
+    std::vector<ImageBarrier> images;
+    std::vector<BufferBarrier> buffers;
+    VkPipelineStageFlags2 srcStage = 0;
+    VkAccessFlags2 srcAccess = 0;
+    VkPipelineStageFlags2 dstStage = 0;
+    VkAccessFlags2 dstAccess = 0;
+
+    bool empty() const;
+  };
+
+  struct Pass {
+    std::string name;
+    Record record;
+    Queue queue;
+    std::vector<Access> accesses;
+    bool culled;
+    uint32_t batch;
+    Barriers barriers;
+  };
+
+  struct Batch {
+    Queue queue;
+    std::vector<uint32_t> passes;
+    std::vector<uint32_t> waits;
+    bool signaled;
+    Barriers endBarriers;  // ownership released to the other queue
+  };
+
+  struct MemoryBlock {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    uint32_t memoryTypeBits;
+    std::vector<uint32_t> resources;
+  };
+
+  VkDevice device_;
+  VkPhysicalDevice physicalDevice_;
+  PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2_;
+  std::vector<Resource> resources_;
+  std::vector<Pass> passes_;
+  std::vector<MemoryBlock> blocks_;
+  std::vector<Batch> batches_;
+  Barriers finalBarriers_;  // at the end of the last batch
+  uint32_t queueFamilies_[2]{VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED};
+  bool compiled_ = false;
+
+  void addAccess(uint32_t pass, uint32_t resource, Usage usage, bool write);
+  void cullPasses();
+  void computeLifetimes();
+  void allocateTransientImages();
+  void buildBarriers();
+  void recordBarriers(VkCommandBuffer commandBuffer,
+                      const Barriers& barriers) const;
+  void dumpBarriers(std::ostream& out, const Barriers& barriers) const;
+  uint32_t findMemoryType(uint32_t typeBits) const;
+};
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_RENDER_GRAPH_H_
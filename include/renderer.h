@@ -14,38 +14,181 @@
 #include <vulkan/vulkan.h>
 
 #include <array>
+#include <atomic>
+#include <exception>
 #include <glm/glm.hpp>
 #include <memory>
 #include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "culling.h"
+#include "deletion_queue.h"
+#include "descriptor_allocator.h"
+#include "frame_limiter.h"
 #include "gui.h"
+#include "job_system.h"
+#include "light_benchmark.h"
+#include "lights.h"
+#include "mesh.h"
+#include "pipeline_cache.h"
+#include "pipeline_manager.h"
+#include "profiler.h"
+#include "render_graph.h"
+#include "resolution_controller.h"
+#include "settings.h"
+#include "shadows.h"
+#include "triple_buffer.h"
 #include "window.h"
 
 namespace vkr {
 
-struct Vertex {
-  glm::vec3 pos;
-  glm::vec3 color;
-  glm::vec2 texCoord;
+// Packed layout written by the material descriptor update template
+struct MaterialDescriptors {
+  VkDescriptorImageInfo texture;
+};
+
+// Packed layout written by the culling descriptor update template
+struct CullingDescriptors {
+  VkDescriptorBufferInfo bounds;
+  VkDescriptorBufferInfo records;
+  VkDescriptorBufferInfo commands;
+  VkDescriptorBufferInfo drawCount;
+};
+
+// Push constants of cull.comp
+struct CullingPushConstants {
+  glm::vec4 planes[6];
+  uint32_t instanceCount;
+  uint32_t recordCount;
+};
+
+// Packed layout written by the occlusion culling descriptor update template
+struct OcclusionDescriptors {
+  VkDescriptorBufferInfo bounds;
+  VkDescriptorBufferInfo records;
+  VkDescriptorBufferInfo commands;
+  VkDescriptorBufferInfo drawCount;
+  VkDescriptorBufferInfo visibility;
+  VkDescriptorImageInfo pyramid;
+};
+
+// Push constants of cull.comp built with OCCLUSION
+struct OcclusionPushConstants {
+  glm::mat4 viewProj;
+  uint32_t instanceCount;
+  uint32_t recordCount;
+  uint32_t phase;
+};
+
+// Count buffer of the culling passes, the statistics are OCCLUSION only
+struct CullingCounts {
+  uint32_t drawCount;
+  uint32_t drawnInstances[2];
+  uint32_t occludedInstances;
+};
+
+// Packed layout written by the Hi-Z descriptor update template
+struct HiZDescriptors {
+  VkDescriptorImageInfo source;
+  VkDescriptorImageInfo destination;
+};
+
+// Push constants of hiz.comp
+struct HiZPushConstants {
+  glm::ivec2 sourceSize;
+  glm::ivec2 destinationSize;
+};
+
+// Packed layout written by the upscale descriptor update template
+struct UpscaleDescriptors {
+  VkDescriptorImageInfo scene;
+};
+
+// Push constants of upscale.frag
+struct UpscalePushConstants {
+  glm::vec2 regionScale;
+  glm::vec2 texelSize;
+};
+
+// Packed layout written by the FXAA descriptor update template
+struct FxaaDescriptors {
+  VkDescriptorImageInfo scene;
+  VkDescriptorImageInfo destination;
+};
+
+// Push constants of fxaa.comp
+struct FxaaPushConstants {
+  glm::ivec2 size;
+  glm::vec2 texelSize;
+};
+
+// Packed layout written by the TAA descriptor update template
+struct TaaDescriptors {
+  VkDescriptorImageInfo scene;
+  VkDescriptorImageInfo depth;
+  VkDescriptorImageInfo history;
+  VkDescriptorImageInfo destination;
+};
+
+// Push constants of taa.comp
+struct TaaPushConstants {
+  glm::mat4 reprojection;
+  glm::ivec2 size;
+  glm::vec2 texelSize;
+  float blend;
+};
+
+// Start of the lighting buffer, the PointLight array follows
+struct LightingHeader {
+  glm::mat4 view;        // scene space to view space
+  glm::vec4 camera;      // position in scene space
+  glm::vec4 projection;  // x and y scale of the projection, near, far
+  glm::vec4 tiles;       // render extent, then cluster tile size in pixels
+  glm::vec2 slicing;     // depth slice = log(view depth) * x + y
+  uint32_t lightCount;
+  uint32_t shadowCascadeMask;  // cascades that hold a shadow map
+  glm::vec4 sunDirection;      // towards the sun, w is 0 without shadows
+  glm::vec4 shadowTexelSizes;  // scene space size of a texel, per cascade
+  glm::mat4 shadowMatrices[shadowCascadeCount];  // scene space to map
+};
+
+// Packed layout written by the lighting and light binning descriptor
+// update templates, the latter stops before the shadow map
+struct LightingDescriptors {
+  VkDescriptorBufferInfo lighting;
+  VkDescriptorBufferInfo clusters;
+  VkDescriptorImageInfo shadowMap;
+};
 
-  static VkVertexInputBindingDescription getBindingDescription();
-  static std::array<VkVertexInputAttributeDescription, 3>
-  getAttributeDescriptions();
+// Consecutive visible instances, drawn together when instancing
+struct InstanceRun {
+  uint32_t first;
+  uint32_t count;
+};
 
-  bool operator==(const Vertex& other) const;
+struct FrameSnapshot {
+  glm::mat4 model;
+  glm::mat4 view;
+  RenderSettings settings;
+  GUIFrame gui;
 };
 
-struct UniformBufferObject {
-  alignas(16) glm::mat4 model;
-  alignas(16) glm::mat4 view;
-  alignas(16) glm::mat4 proj;
+struct RendererConfig {
+  RenderSettings settings;
+  bool dynamicRendering = true;
+  bool dumpRenderGraph = false;
+  uint32_t instanceCount = 1;  // copies of the model, laid out on a grid
+  bool lightBenchmark = false;  // sweep the light count, print, and quit
+  uint32_t workerCount = 0;  // job system threads, 0 is one per core but one
+  bool recordEveryFrame = false;  // re-record the scene to time recording
 };
 
 struct QueueFamilyIndices {
   std::optional<uint32_t> graphicsFamily;
   std::optional<uint32_t> presentFamily;
+  std::optional<uint32_t> computeFamily;  // dedicated, without graphics
 
   bool isComplete();
 };
@@ -58,10 +201,11 @@ struct SwapChainSupportDetails {
 
 class Renderer {
  public:
-  Renderer();
+  Renderer() = delete;
+  Renderer(const RendererConfig& config);
   ~Renderer();
 
-  void setFramebufferResized(bool resized);
+  void setFramebufferSize(int width, int height);
 
   void run();
 
@@ -72,71 +216,284 @@ class Renderer {
   VkSurfaceKHR surface_;
   VkPhysicalDevice physicalDevice_ = VK_NULL_HANDLE;
   VkSampleCountFlagBits msaaSamples_ = VK_SAMPLE_COUNT_1_BIT;
+  VkSampleCountFlags framebufferSampleCounts_ = 0;
+  VkSampleCountFlags sampledDepthSampleCounts_ = 0;
   VkDevice device_;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue computeQueue_ = VK_NULL_HANDLE;
+  // A dedicated compute family, whose queue runs the graph's async passes
+  bool asyncComputeSupported_ = false;
   VkSwapchainKHR swapChain_;
   std::vector<VkImage> swapChainImages_;
   VkFormat swapChainImageFormat_;
   VkExtent2D swapChainExtent_;
   std::vector<VkImageView> swapChainImageViews_;
-  VkRenderPass renderPass_;
+  VkRenderPass renderPass_ = VK_NULL_HANDLE;
+  bool dynamicRendering_ = false;
+  VkPipelineRenderingCreateInfoKHR pipelineRenderingInfo_{};
+  VkCommandBufferInheritanceRenderingInfoKHR inheritanceRenderingInfo_{};
+  // The GUI pass draws to the swapchain alone, without MSAA or depth
+  VkPipelineRenderingCreateInfoKHR guiRenderingInfo_{};
+  VkCommandBufferInheritanceRenderingInfoKHR guiInheritanceRenderingInfo_{};
+  PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR_ = nullptr;
+  PFN_vkCmdEndRenderingKHR vkCmdEndRenderingKHR_ = nullptr;
+  PFN_vkCmdPipelineBarrier2KHR vkCmdPipelineBarrier2KHR_ = nullptr;
+  bool gpuCullingSupported_ = false;
+  PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR_ =
+      nullptr;
+  std::unique_ptr<RenderGraph> renderGraph_;
+  bool dumpRenderGraph_ = false;
+  uint32_t swapChainResource_ = 0;
+  uint32_t colorResource_ = 0;
+  uint32_t depthResource_ = 0;
+  uint32_t sceneColorResource_ = 0;
+  uint32_t sceneTargetResource_ = 0;  // drawn or resolved to by the scene
+  uint32_t upscaleSourceResource_ = 0;
+  bool scaledGraph_ = false;  // the scene is upscaled before the GUI
+  bool cullingGraph_ = false;  // the render graph has the culling pass
+  bool asyncGraph_ = false;    // its compute passes run on computeQueue_
+  VkExtent2D renderExtent_{};  // the scene's share of the attachments
+  ResolutionController resolutionController_;
+  uint64_t upscalePipelines_[2]{};  // bilinear, sharpening
+  VkPipelineLayout upscalePipelineLayout_ = VK_NULL_HANDLE;
+  VkDescriptorSetLayout upscaleSetLayout_ = VK_NULL_HANDLE;
+  std::unique_ptr<DescriptorUpdateTemplate> upscaleUpdate_;
+  VkSampler upscaleSampler_ = VK_NULL_HANDLE;
+  AntiAliasing graphAntiAliasing_ = AntiAliasing::Msaa;
+  std::string antiAliasingName_;
+  std::vector<std::string> frameAntiAliasing_;  // mode each slot recorded
+  bool depthSamplingSupported_ = false;
+  uint32_t antiAliasedResource_ = 0;
+  VkPipeline fxaaPipeline_ = VK_NULL_HANDLE;
+  VkPipelineLayout fxaaPipelineLayout_ = VK_NULL_HANDLE;
+  VkDescriptorSetLayout fxaaSetLayout_ = VK_NULL_HANDLE;
+  std::unique_ptr<DescriptorUpdateTemplate> fxaaUpdate_;
+  VkPipeline taaPipeline_ = VK_NULL_HANDLE;
+  VkPipelineLayout taaPipelineLayout_ = VK_NULL_HANDLE;
+  VkDescriptorSetLayout taaSetLayout_ = VK_NULL_HANDLE;
+  std::unique_ptr<DescriptorUpdateTemplate> taaUpdate_;
+  // Swap roles every frame, one is read as history while the other is
+  // written
+  VkImage historyImages_[2]{};
+  VkDeviceMemory historyImageMemory_[2]{};
+  VkImageView historyImageViews_[2]{};
+  uint32_t historyIndex_ = 0;  // written this frame
+  uint32_t historyResource_ = 0;
+  bool historyValid_ = false;
+  bool historyUndefined_ = false;  // not yet in the layout the graph expects
+  uint32_t jitterIndex_ = 0;
+  glm::mat4 unjitteredTransform_{1.f};
+  glm::mat4 previousTransform_{1.f};
+  // Per frame in flight: the lights with the view they are binned for, and
+  // the clusters binned from them
+  std::vector<PointLight> lights_;
+  uint64_t lightsVersion_ = 1;
+  std::vector<uint64_t> uploadedLightVersions_;
+  std::vector<VkBuffer> lightingBuffers_;
+  std::vector<VkDeviceMemory> lightingBufferMemory_;
+  std::vector<LightingHeader*> lightingData_;
+  std::vector<VkBuffer> clusterBuffers_;
+  std::vector<VkDeviceMemory> clusterBufferMemory_;
+  std::unique_ptr<DescriptorUpdateTemplate> lightingUpdate_;
+  std::vector<VkDescriptorSet> lightingDescriptorSets_;
+  VkPipeline lightBinningPipeline_ = VK_NULL_HANDLE;
+  VkPipelineLayout lightBinningPipelineLayout_ = VK_NULL_HANDLE;
+  std::unique_ptr<DescriptorUpdateTemplate> lightBinningUpdate_;
+  std::vector<VkDescriptorSet> lightBinningDescriptorSets_;
+  uint32_t clusterResource_ = 0;
+  std::unique_ptr<LightBenchmark> lightBenchmark_;
+  // Sun shadows, one layer per cascade. The cached layers outlive the frame
+  // that rendered them, so there is a single map for every frame in flight
+  bool shadowsSupported_ = false;
+  bool shadowGraph_ = false;  // the render graph has the shadow pass
+  ShadowCascades shadowCascades_;
+  VkFormat shadowFormat_ = VK_FORMAT_UNDEFINED;
+  VkImage shadowImage_ = VK_NULL_HANDLE;
+  VkDeviceMemory shadowImageMemory_ = VK_NULL_HANDLE;
+  VkImageView shadowImageView_ = VK_NULL_HANDLE;
+  std::vector<VkImageView> shadowLayerViews_;
+  VkSampler shadowSampler_ = VK_NULL_HANDLE;
+  uint64_t shadowPipeline_ = 0;
+  uint32_t shadowResource_ = 0;
+  std::array<std::vector<InstanceRun>, shadowCascadeCount> shadowRuns_;
+  std::vector<uint32_t> shadowCasters_;
+  std::vector<uint32_t> frameShadowCascades_;  // rendered by each slot
+  std::vector<VkCommandBuffer> mainPassCommandBuffers_;
   VkDescriptorSetLayout descriptorSetLayout_;
+  VkDescriptorSetLayout lightingSetLayout_ = VK_NULL_HANDLE;
   VkPipelineLayout pipelineLayout_;
-  VkPipeline graphicsPipeline_;
+  std::unique_ptr<PipelineCache> pipelineCache_;
+  std::unique_ptr<PipelineManager> pipelines_;
+  uint64_t scenePipeline_ = 0;
+  uint64_t depthPipeline_ = 0;
+  uint64_t pipelineVersion_ = 0;
   std::vector<VkFramebuffer> swapChainFrameBuffers_;
   VkCommandPool commandPool_;
   std::vector<Vertex> vertices_;
   std::vector<uint32_t> indices_;
+  std::vector<DrawCommand> drawCommands_;
+  uint32_t instanceCount_;
+  std::vector<InstanceData> instances_;
+  glm::vec4 modelBounds_{0.f};  // bounding sphere of one copy of the model
+  glm::vec4 sceneBounds_{0.f};  // bounding sphere of every instance
+  SphereBounds instanceBounds_;
+  std::vector<uint32_t> visibleInstances_;
+  std::vector<InstanceRun> visibleRuns_;
+  std::vector<glm::mat4> drawModels_;
+  glm::mat4 sceneTransform_{0.f};
   VkBuffer vertexBuffer_;
   VkDeviceMemory vertexBufferMemory_;
+  VkBuffer positionBuffer_;
+  VkDeviceMemory positionBufferMemory_;
   VkBuffer indexBuffer_;
   VkDeviceMemory indexBufferMemory_;
-  std::vector<VkBuffer> uniformBuffers_;
-  std::vector<VkDeviceMemory> uniformBuffersMemory_;
-  std::vector<void*> uniformBuffersMapped_;
-  VkImage colorImage_;
-  VkDeviceMemory colorImageMemory_;
-  VkImageView colorImageView_;
-  VkImage depthImage_;
-  VkDeviceMemory depthImageMemory_;
-  VkImageView depthImageView_;
+  VkBuffer instanceBuffer_;
+  VkDeviceMemory instanceBufferMemory_;
+  VkBuffer boundsBuffer_ = VK_NULL_HANDLE;
+  VkDeviceMemory boundsBufferMemory_ = VK_NULL_HANDLE;
+  VkBuffer drawRecordBuffer_ = VK_NULL_HANDLE;
+  VkDeviceMemory drawRecordBufferMemory_ = VK_NULL_HANDLE;
+  std::vector<VkBuffer> indirectBuffers_;
+  std::vector<VkDeviceMemory> indirectBufferMemory_;
+  std::vector<VkBuffer> drawCountBuffers_;
+  std::vector<VkDeviceMemory> drawCountBufferMemory_;
+  std::vector<const CullingCounts*> drawCounts_;
+  uint32_t maxIndirectDraws_ = 0;
+  VkPipeline cullingPipeline_ = VK_NULL_HANDLE;
+  VkPipelineLayout cullingPipelineLayout_ = VK_NULL_HANDLE;
+  std::unique_ptr<DescriptorUpdateTemplate> cullingUpdate_;
+  std::vector<VkDescriptorSet> cullingDescriptorSets_;
+  bool occlusionCullingSupported_ = false;
+  bool occlusionGraph_ = false;  // the render graph has the two phases
+  VkBuffer visibilityBuffer_ = VK_NULL_HANDLE;
+  VkDeviceMemory visibilityBufferMemory_ = VK_NULL_HANDLE;
+  VkPipeline occlusionPipeline_ = VK_NULL_HANDLE;
+  VkPipelineLayout occlusionPipelineLayout_ = VK_NULL_HANDLE;
+  VkDescriptorSetLayout occlusionSetLayout_ = VK_NULL_HANDLE;
+  std::unique_ptr<DescriptorUpdateTemplate> occlusionUpdate_;
+  VkPipeline hizPipeline_ = VK_NULL_HANDLE;
+  VkPipeline hizMultisampledPipeline_ = VK_NULL_HANDLE;
+  VkPipelineLayout hizPipelineLayout_ = VK_NULL_HANDLE;
+  VkDescriptorSetLayout hizSetLayout_ = VK_NULL_HANDLE;
+  std::unique_ptr<DescriptorUpdateTemplate> hizUpdate_;
+  VkSampler hizSampler_ = VK_NULL_HANDLE;
+  VkImage hizImage_ = VK_NULL_HANDLE;
+  VkDeviceMemory hizImageMemory_ = VK_NULL_HANDLE;
+  VkImageView hizImageView_ = VK_NULL_HANDLE;
+  std::vector<VkImageView> hizMipViews_;
+  VkExtent2D hizExtent_{};
+  uint32_t hizResource_ = 0;
+  uint32_t indirectResource_ = 0;
+  uint32_t drawCountResource_ = 0;
+  uint32_t visibilityResource_ = 0;
+  VkImage colorImage_ = VK_NULL_HANDLE;
+  VkDeviceMemory colorImageMemory_ = VK_NULL_HANDLE;
+  VkImageView colorImageView_ = VK_NULL_HANDLE;
+  VkImage depthImage_ = VK_NULL_HANDLE;
+  VkDeviceMemory depthImageMemory_ = VK_NULL_HANDLE;
+  VkImageView depthImageView_ = VK_NULL_HANDLE;
   uint32_t mipLevels_;
+  std::vector<uint8_t> texturePixels_;
+  int textureWidth_;
+  int textureHeight_;
   VkImage textureImage_;
   VkDeviceMemory textureImageMemory_;
   VkImageView textureImageView_;
   VkSampler textureSampler_;
-  VkDescriptorPool descriptorPool_;
-  std::vector<VkDescriptorSet> descriptorSets_;
-  std::vector<VkCommandBuffer> commandBuffers_;
+  std::unique_ptr<DescriptorLayoutCache> descriptorLayouts_;
+  std::unique_ptr<DescriptorAllocator> descriptors_;
+  std::vector<std::unique_ptr<DescriptorAllocator>> frameDescriptors_;
+  std::unique_ptr<DescriptorUpdateTemplate> materialUpdate_;
+  VkDescriptorPool guiDescriptorPool_;
+  VkDescriptorSet descriptorSet_;
+  // Per frame slot, one primary per render graph batch, allocated as the
+  // batches first need them
+  std::vector<VkCommandPool> frameCommandPools_;
+  std::vector<std::vector<VkCommandBuffer>> commandBuffers_;
+  std::vector<VkCommandPool> computeCommandPools_;
+  std::vector<std::vector<VkCommandBuffer>> computeCommandBuffers_;
+  std::vector<VkCommandBuffer> guiCommandBuffers_;
+  std::vector<std::vector<VkCommandPool>> sceneCommandPools_;
+  std::vector<std::vector<std::vector<VkCommandBuffer>>> sceneCommandBuffers_;
+  std::vector<uint64_t> recordedSceneVersions_;
+  uint64_t sceneVersion_ = 1;
+  uint64_t sceneRecordCount_ = 0;
+  bool recordEveryFrame_ = false;
+  std::unique_ptr<JobSystem> jobSystem_;
+  Profiler profiler_;
   std::vector<VkSemaphore> imageAvailableSemaphores_;
   std::vector<VkSemaphore> renderFinishiedSemephores_;
   std::vector<VkFence> inFlightFences_;
+  // Per frame slot, signaled by the batches another queue waits on
+  std::vector<std::vector<VkSemaphore>> batchSemaphores_;
+  std::vector<uint64_t> fenceFrames_;
+  uint64_t submittedFrames_ = 0;
+  DeletionQueue deletionQueue_;
+  uint64_t swapchainRecreations_ = 0;
   uint32_t currentFrame_ = 0;
-  bool framebufferResized_ = false;
+  std::atomic<bool> framebufferResized_{false};
+  std::atomic<uint64_t> framebufferSize_{0};
   std::unique_ptr<GUI> gui_;
+  TripleBuffer<FrameSnapshot> snapshots_;
+  std::thread renderThread_;
+  std::atomic<bool> stopRendering_{false};
+  std::exception_ptr renderException_;
+  RenderSettings settings_;
+  RenderSettings activeSettings_;
+  FrameLimiter frameLimiter_;
+  bool pipelineStatisticsSupported_ = false;
+  bool timestampsSupported_ = false;
+  bool lightBenchmarkRequested_ = false;
+  VkQueryPool statisticsQueryPool_ = VK_NULL_HANDLE;
+  VkQueryPool timestampQueryPool_ = VK_NULL_HANDLE;
+  double timestampPeriod_ = 0.0;  // nanoseconds per tick
+  uint64_t timestampMask_ = 0;
+  std::vector<bool> queriesRecorded_;
+  std::vector<uint32_t> frameBatchCounts_;   // submitted by each slot
+  std::vector<uint32_t> frameAsyncBatches_;  // bit per batch on computeQueue_
+  // Culling passes each slot recorded, which wrote its drawCounts_
+  std::vector<bool> frameGPUCulling_;
+  std::vector<bool> frameOcclusionCulling_;
+  bool presentWaitSupported_ = false;
+  PFN_vkWaitForPresentKHR vkWaitForPresentKHR_ = nullptr;
+  uint64_t presentId_ = 0;
 
   void initVulkan();
-  void drawFrame();
+  void renderLoop();
+  void updateSimulation(FrameSnapshot& snapshot);
+  void drawFrame(const FrameSnapshot& snapshot);
+  void applySettings(const RenderSettings& settings);
+  void waitForPresent();
 
   void createInstance();
   void setupDebugMessenger();
   void createSurface();
   void pickPhysicalDevice();
   void createLogicalDevice();
-  void createSwapChain();
+  void createPipelineCache();
+  void createSwapChain(VkSwapchainKHR oldSwapChain);
   void createImageViews();
   void createRenderPass();
-  void createDescriptorSetLayout();
+  void createRenderingInfo();
+  void createRenderGraph();
   void createGraphicsPipeline();
+  PipelineState getScenePipelineState(uint32_t features);
+  PipelineState getDepthPipelineState();
+  PipelineState getShadowPipelineState();
+  PipelineState getUpscalePipelineState(bool sharpen);
   void createCommandPool();
   void createColorResources();
   void createDepthResources();
   void createFramebuffers();
   void loadModel();
+  void loadTexture();
   void createVertexBuffer();
   void createIndexBufffer();
-  void createUniformBuffers();
+  void createInstanceBuffer();
+  void createCullingResources();
+  void createOcclusionResources();
+  void createHiZResources();
   void createTextureImage();
   void createTextureImageView();
   void createTextureSampler();
@@ -144,9 +501,48 @@ class Renderer {
   void createDescriptorSets();
   void createCommandBuffers();
   void createSyncObjects();
-  void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+  void createQueryPools();
+  void createUpscaleResources();
+  void createAntiAliasingResources();
+  void createHistoryResources();
+  void createLightingResources();
+  void createShadowResources();
+  void recordCommandBuffers(uint32_t imageIndex, const FrameSnapshot& snapshot);
+  VkCommandBuffer getBatchCommandBuffer(uint32_t batch, bool async);
+  VkSemaphore getBatchSemaphore(uint32_t batch);
+  void recordMainPass(VkCommandBuffer commandBuffer, bool first, bool last);
+  void recordCulling(VkCommandBuffer commandBuffer);
+  void recordOcclusionCulling(VkCommandBuffer commandBuffer, uint32_t phase);
+  void recordHiZ(VkCommandBuffer commandBuffer);
+  void recordLightBinning(VkCommandBuffer commandBuffer);
+  void recordShadows(VkCommandBuffer commandBuffer);
+  void recordUpscale(VkCommandBuffer commandBuffer);
+  void recordFxaa(VkCommandBuffer commandBuffer);
+  void recordTaa(VkCommandBuffer commandBuffer);
+  void swapHistory();
+  void recordHistoryInit(VkCommandBuffer commandBuffer);
+  void recordGUIPass(VkCommandBuffer commandBuffer);
+  VkCommandBufferInheritanceInfo getInheritanceInfo(uint32_t imageIndex);
+  VkCommandBufferInheritanceInfo getGUIInheritanceInfo(uint32_t imageIndex);
+  void recordSceneCommands(uint32_t sliceIndex);
+  size_t getSceneDrawCount();
+  size_t getDrawSplit();
+  void recordDrawCommands(VkCommandBuffer commandBuffer,
+                          const VkCommandBufferInheritanceInfo& inheritanceInfo,
+                          size_t firstDraw, size_t drawCount, bool depthOnly);
+  void recordGUI(VkCommandBuffer commandBuffer,
+                 const VkCommandBufferInheritanceInfo& inheritanceInfo,
+                 const GUIFrame& frame);
   void recreateSwapchain();
-  void updateUniformBuffer(uint32_t currentFrame);
+  void retireSwapChain();
+  void retireRenderGraph();
+  uint64_t getCompletedFrames();
+  void invalidateSceneCommands();
+  void updateTransforms(const FrameSnapshot& snapshot);
+  void updateLighting(const FrameSnapshot& snapshot);
+  void updateShadows(const FrameSnapshot& snapshot);
+  void cullInstances();
+  void updateRenderExtent(double gpuTime);
 
   std::vector<const char*> getRequiredExtensions();
   bool checkValidationLayerSupport();
@@ -159,17 +555,21 @@ class Renderer {
   VkPresentModeKHR chooseSwapPresentMode(
       const std::vector<VkPresentModeKHR>& availablePresentModes);
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
-  VkShaderModule createShaderModule(const std::vector<char>& code);
   void cleanupSwapChain();
+  // Shared buffers are read by both queues without ownership transfers
   void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                     VkMemoryPropertyFlags properties, VkBuffer& buffer,
-                    VkDeviceMemory& bufferMemory);
+                    VkDeviceMemory& bufferMemory, bool shared = false);
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+  void createDeviceLocalBuffer(const void* data, VkDeviceSize size,
+                               VkBufferUsageFlags usage, VkBuffer& buffer,
+                               VkDeviceMemory& bufferMemory,
+                               bool shared = false);
   void createImage(uint32_t width, uint32_t height, uint32_t mipLevels,
                    VkSampleCountFlagBits numSamples, VkFormat format,
                    VkImageTiling tiling, VkImageUsageFlags usage,
                    VkMemoryPropertyFlags properties, VkImage& image,
-                   VkDeviceMemory& imageMemory);
+                   VkDeviceMemory& imageMemory, uint32_t arrayLayers = 1);
   void transitionImageLayout(VkImage image, VkFormat format,
                              VkImageLayout oldLayout, VkImageLayout newLayout,
                              uint32_t mipLevels);
@@ -179,13 +579,20 @@ class Renderer {
                        int32_t texHeight, uint32_t mipLevels);
   VkImageView createImageView(VkImage image, VkFormat format,
                               VkImageAspectFlags aspectFlags,
-                              uint32_t mipLevels);
+                              uint32_t mipLevels, uint32_t baseMipLevel = 0);
   VkFormat findDepthFormat();
   bool hasStencilComponent(VkFormat format);
-  VkSampleCountFlagBits getMaxUsableSampleCount();
+  VkSampleCountFlagBits getUsableSampleCount(uint32_t requested);
 
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
-  bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool checkDeviceExtensionSupport(
+      VkPhysicalDevice device, const std::vector<const char*>& extensions);
+  bool checkPresentWaitSupport(VkPhysicalDevice device);
+  bool checkDynamicRenderingSupport(VkPhysicalDevice device);
+  bool checkGPUCullingSupport(VkPhysicalDevice device);
+  bool checkDepthSamplingSupport();
+  bool checkPipelineStatisticsSupport(VkPhysicalDevice device);
+  bool checkTimestampSupport(VkPhysicalDevice device);
   SwapChainSupportDetails querySwapChainSupprt(VkPhysicalDevice device);
   uint32_t findMemoryType(uint32_t typeFilter,
                           VkMemoryPropertyFlags properties);
@@ -208,7 +615,6 @@ class Renderer {
                 VkDebugUtilsMessageTypeFlagsEXT messageType,
                 const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
                 void* pUserData);
-  static std::vector<char> readFile(const std::string& filename);
   static void checkVKResult(VkResult result);
 };
 
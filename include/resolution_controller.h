@@ -0,0 +1,59 @@
+/**
+ * @file resolution_controller.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_RESOLUTION_CONTROLLER_H_
+#define VK_RENDERER_RESOLUTION_CONTROLLER_H_
+
+#include <cstdint>
+
+namespace vkr {
+
+/**
+ * @brief Picks the scene's render scale from measured GPU frame times.
+ *
+ * Lowers the scale as far as the smoothed time says is needed in one go,
+ * and raises it one step at a time once there is headroom. The scale moves
+ * in fixed steps so it settles instead of drifting. After a change, the
+ * frames still in flight at the old scale are skipped before measuring
+ * again.
+ */
+class ResolutionController {
+ public:
+  void setTargetTime(double milliseconds);
+  // Feeds one GPU frame time in ms, returns true when the scale changed
+  bool update(double gpuTime);
+  // Back to full resolution with no history
+  void reset();
+
+  float getScale() const;
+  double getSmoothedTime() const;
+  const char* getStateName() const;
+
+ private:
+  enum State {
+    Measuring,
+    Settling,
+    Holding,
+    Lowering,
+    Raising,
+  };
+
+  double targetTime_ = 16.6;
+  double smoothedTime_ = 0.0;
+  float scale_ = 1.f;
+  uint32_t sampleCount_ = 0;
+  uint32_t settleFrames_ = 0;
+  State state_ = Measuring;
+};
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_RESOLUTION_CONTROLLER_H_
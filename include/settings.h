@@ -0,0 +1,85 @@
+/**
+ * @file settings.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_SETTINGS_H_
+#define VK_RENDERER_SETTINGS_H_
+
+#include <cstdint>
+#include <string>
+
+namespace vkr {
+
+enum PresentMode {
+  Fifo,
+  FifoRelaxed,
+  Mailbox,
+  Immediate,
+};
+
+// Anti-aliasing of the scene; the post-process modes render one sample per
+// pixel and filter the result in a compute pass
+enum AntiAliasing {
+  Msaa,
+  Fxaa,
+  Taa,
+};
+
+// Scene shader features, each one a specialization constant or pipeline flag
+enum ShaderFeature {
+  VertexColor = 1 << 0,
+  Texturing = 1 << 1,
+  AlphaTest = 1 << 2,
+  SampleShading = 1 << 3,
+};
+
+const uint32_t shaderFeatureCount = 4;
+
+/**
+ * @brief Options that can change while the renderer is running.
+ *
+ * Edited by the GUI on the main thread and handed to the render thread with
+ * every frame snapshot.
+ */
+struct RenderSettings {
+  PresentMode presentMode = PresentMode::Mailbox;
+  bool presentWait = false;
+  float frameRateLimit = 0.f;  // frames per second, 0 disables the limiter
+  bool backfaceCulling = true;
+  bool instancing = true;  // one draw per mesh part instead of per object
+  bool gpuCulling = false;  // cull in a compute pass and draw indirect
+  bool occlusionCulling = false;  // two-phase Hi-Z test on top of gpuCulling
+  bool depthPrepass = false;  // lay down depth first, then shade on EQUAL
+  bool dynamicResolution = false;  // scale the scene to hold targetGpuTime
+  float targetGpuTime = 16.6f;  // milliseconds per frame
+  bool sharpenUpscale = true;  // sharpening instead of plain bilinear
+  AntiAliasing antiAliasing = AntiAliasing::Msaa;
+  uint32_t msaaSamples = 4;  // 1, 2, 4 or 8, clamped to what the device has
+  uint32_t lightCount = 0;  // point lights binned into clusters, 0 is unlit
+  bool shadows = false;  // sun light with cascaded shadow maps
+  bool shadowCaching = true;  // far cascades re-render only when invalidated
+  uint32_t shadowUpdateBudget = 1;  // cached cascades rendered per frame
+  float sunAzimuth = 30.f;    // degrees around the scene's up axis
+  float sunElevation = 50.f;  // degrees above the horizon
+  bool asyncCompute = true;  // compute passes on a queue of their own
+  uint32_t shaderFeatures = ShaderFeature::Texturing |
+                            ShaderFeature::SampleShading;
+};
+
+const char* getPresentModeName(PresentMode presentMode);
+bool parsePresentMode(const std::string& name, PresentMode& presentMode);
+const char* getAntiAliasingName(AntiAliasing antiAliasing);
+bool parseAntiAliasing(const std::string& name, AntiAliasing& antiAliasing);
+const char* getShaderFeatureName(ShaderFeature feature);
+std::string getShaderVariantName(uint32_t shaderFeatures);
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_SETTINGS_H_
@@ -0,0 +1,79 @@
+/**
+ * @file shader_reflection.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_SHADER_REFLECTION_H_
+#define VK_RENDERER_SHADER_REFLECTION_H_
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vkr {
+
+struct ShaderBinding {
+  uint32_t set;
+  uint32_t binding;
+  VkDescriptorType descriptorType;
+  uint32_t descriptorCount;
+};
+
+struct ShaderInput {
+  uint32_t location;
+  VkFormat format;
+};
+
+struct ShaderReflection {
+  VkShaderStageFlagBits stage;
+  std::vector<ShaderBinding> bindings;
+  // Byte range of the push constant block, size 0 without one
+  uint32_t pushConstantOffset = 0;
+  uint32_t pushConstantSize = 0;
+  // Vertex stage only, sorted by location
+  std::vector<ShaderInput> inputs;
+};
+
+struct PipelineLayoutDescription {
+  // Indexed by set number, sets a shader skips stay empty
+  std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+  std::vector<VkPushConstantRange> pushConstantRanges;
+};
+
+/**
+ * @brief Reads the resource interface of a SPIR-V module.
+ *
+ * Only the instructions that describe descriptors, push constants and
+ * stage inputs are decoded, the rest of the module is skipped. Throws on
+ * malformed code and on resources the renderer cannot build layouts for.
+ */
+ShaderReflection reflectShader(const uint32_t* code, size_t wordCount);
+
+/**
+ * @brief Merges the stages of one pipeline into its layout description.
+ *
+ * A binding used by several stages is visible to all of them. Push constant
+ * blocks are merged into one range covering every stage, so a single
+ * vkCmdPushConstants call with those stages can update it.
+ */
+PipelineLayoutDescription mergeReflections(
+    const std::vector<ShaderReflection>& reflections);
+
+// Throws when a vertex shader input has no attribute of a matching type
+void validateVertexInputs(
+    const ShaderReflection& reflection,
+    const std::vector<VkVertexInputAttributeDescription>& attributes,
+    const std::string& name);
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_SHADER_REFLECTION_H_
@@ -0,0 +1,86 @@
+/**
+ * @file shadows.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_SHADOWS_H_
+#define VK_RENDERER_SHADOWS_H_
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace vkr {
+
+// Layers of the shadow map array. Matches the constants of shader.frag
+const uint32_t shadowCascadeCount = 4;
+const uint32_t shadowMapSize = 2048;
+// These follow the camera every frame, the farther ones are cached
+const uint32_t shadowNearCascadeCount = 2;
+
+/**
+ * @brief Fits the sun's shadow cascades to the camera and decides which
+ * ones have to be rendered this frame.
+ *
+ * Every cascade covers the bounding sphere of its slice of the view
+ * frustum, whose size does not depend on the camera's orientation, and its
+ * origin is snapped to whole texels, so moving the camera does not make
+ * the shadow edges crawl.
+ *
+ * With caching, the far cascades are fitted with a margin and kept until
+ * their slice leaves the covered square, the sun moves, or invalidate() is
+ * called. At most updateBudget of them are re-rendered per frame, the one
+ * waiting longest first; the others keep the map and matrix they have.
+ */
+class ShadowCascades {
+ public:
+  // view takes scene space to view space, projection is getProjection()'s,
+  // bounds is a sphere around every shadow caster in scene space
+  void update(const glm::mat4& view, const glm::mat4& projection,
+              const glm::vec3& sunDirection, const glm::vec4& bounds,
+              bool caching, uint32_t updateBudget);
+  // The casters changed, every cascade is rendered again
+  void invalidate();
+
+  // Rendered this frame with the current matrix
+  bool isDue(uint32_t cascade) const;
+  // Holds a map rendered with the current matrix
+  bool isValid(uint32_t cascade) const;
+  // Scene space to the cascade's clip space
+  const glm::mat4& getMatrix(uint32_t cascade) const;
+  // Scene space size of one texel
+  float getTexelSize(uint32_t cascade) const;
+
+  // Cached cascades that were, or were not, still good for a frame
+  uint64_t getHits() const;
+  uint64_t getMisses() const;
+
+ private:
+  struct Cascade {
+    glm::mat4 matrix{1.f};
+    glm::vec3 direction{0.f};
+    glm::vec2 center{0.f};  // in light space, snapped to texels
+    float halfExtent = 0.f;
+    float texelSize = 0.f;
+    uint64_t version = 0;
+    uint64_t renderedFrame = 0;
+    bool valid = false;
+    bool due = false;
+  };
+
+  std::array<Cascade, shadowCascadeCount> cascades_{};
+  uint64_t version_ = 1;
+  uint64_t frame_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_SHADOWS_H_
@@ -0,0 +1,39 @@
+/**
+ * @file transform.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_TRANSFORM_H_
+#define VK_RENDERER_TRANSFORM_H_
+
+#include <glm/glm.hpp>
+
+namespace vkr {
+
+// Vertex stage push constant block of shader.vert and depth.vert. Vertices
+// go through model, then the instance matrix, then viewProj
+struct ObjectPushConstants {
+  glm::mat4 viewProj;
+  glm::mat4 model;  // of the mesh part being drawn
+};
+
+// Distances of the clip planes of getProjection()
+const float nearPlane = .1f;
+const float farPlane = 10.f;
+
+// Vulkan clip space projection, y flipped
+glm::mat4 getProjection(float aspect);
+
+// Column-major 4x4 product on SSE, with a scalar path elsewhere. out may
+// alias either input
+void multiply(const glm::mat4& lhs, const glm::mat4& rhs, glm::mat4& out);
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_TRANSFORM_H_
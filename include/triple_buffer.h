@@ -0,0 +1,67 @@
+/**
+ * @file triple_buffer.h
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef VK_RENDERER_TRIPLE_BUFFER_H_
+#define VK_RENDERER_TRIPLE_BUFFER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace vkr {
+
+/**
+ * @brief Lock-free single-producer/single-consumer triple buffer.
+ *
+ * The writer fills getWriteBuffer() and publishes it, the reader calls
+ * update() to pick up the latest published value. Neither side ever blocks,
+ * and the reader always sees a complete value.
+ */
+template <typename T>
+class TripleBuffer {
+ public:
+  T& getWriteBuffer() { return buffers_[writeIndex_]; }
+
+  void publish() {
+    uint8_t previous =
+        middle_.exchange(writeIndex_ | kDirtyBit, std::memory_order_acq_rel);
+    writeIndex_ = previous & kIndexMask;
+  }
+
+  bool isConsumed() const {
+    return !(middle_.load(std::memory_order_acquire) & kDirtyBit);
+  }
+
+  bool update() {
+    if (!(middle_.load(std::memory_order_acquire) & kDirtyBit)) {
+      return false;
+    }
+
+    uint8_t previous = middle_.exchange(readIndex_, std::memory_order_acq_rel);
+    readIndex_ = previous & kIndexMask;
+    return true;
+  }
+
+  const T& getReadBuffer() const { return buffers_[readIndex_]; }
+
+ private:
+  static constexpr uint8_t kDirtyBit = 0x4;
+  static constexpr uint8_t kIndexMask = 0x3;
+
+  std::array<T, 3> buffers_{};
+  uint8_t writeIndex_ = 0;
+  uint8_t readIndex_ = 1;
+  std::atomic<uint8_t> middle_{2};
+};
+
+}  // namespace vkr
+
+#endif  // VK_RENDERER_TRIPLE_BUFFER_H_
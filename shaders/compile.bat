@@ -1,3 +0,0 @@
-%VK_SDK_PATH%/Bin/glslc.exe shader.vert -o vert.spv
-%VK_SDK_PATH%/Bin/glslc.exe shader.frag -o frag.spv
-pause
@@ -0,0 +1,20 @@
+#version 450
+
+// Position-only twin of shader.vert for the depth pre-pass
+layout(push_constant) uniform PushConstants {
+  mat4 viewProj;
+  mat4 model;
+} object;
+
+layout(location = 0) in vec3 inPosition;
+
+layout(location = 3) in mat4 inModel;
+
+// The scene pass tests EQUAL against this depth, so both shaders have to
+// compute the exact same position
+invariant gl_Position;
+
+void main() {
+  vec4 position = inModel * (object.model * vec4(inPosition, 1.0));
+  gl_Position = object.viewProj * position;
+}
@@ -1,12 +1,156 @@
 #version 450
 
+// Shared with the vertex stage, see ShaderFeature
+layout(constant_id = 0) const bool useVertexColor = true;
+layout(constant_id = 1) const bool useTexture = true;
+layout(constant_id = 2) const bool useAlphaTest = false;
+layout(constant_id = 3) const float alphaCutoff = 0.5;
+
+// See lights.h
+const uint clusterGridX = 16;
+const uint clusterGridY = 9;
+const uint clusterGridZ = 24;
+const uint clusterCount = clusterGridX * clusterGridY * clusterGridZ;
+const uint maxLightsPerCluster = 256;
+const float ambient = 0.05;
+// See shadows.h
+const uint shadowCascadeCount = 4;
+const vec3 sunColor = vec3(1.0, 0.95, 0.85);
+
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterial;
+layout(location = 3) in vec3 fragPosition;
 
 layout(binding = 1) uniform sampler2D texSampler;
 
+// See PointLight
+struct PointLight {
+  vec4 position;  // scene space, w is the radius
+  vec4 color;
+};
+
+// See LightingHeader
+layout(set = 1, binding = 0) readonly buffer Lighting {
+  mat4 view;
+  vec4 camera;
+  vec4 projection;
+  vec4 tiles;
+  vec2 slicing;
+  uint lightCount;
+  uint shadowCascadeMask;  // cascades that hold a shadow map
+  vec4 sunDirection;       // towards the sun, w is 0 without shadows
+  vec4 shadowTexelSizes;
+  mat4 shadowMatrices[shadowCascadeCount];
+  PointLight lights[];
+} lighting;
+
+// Written by light_binning.comp
+layout(set = 1, binding = 1) readonly buffer Clusters {
+  uint lightCounts[clusterCount];
+  uint lightIndices[];
+} clusters;
+
+// One layer per cascade, compared against with linear filtering
+layout(set = 1, binding = 2) uniform sampler2DArrayShadow shadowMap;
+
 layout(location = 0) out vec4 outColor;
 
+// Indexed by material ID, tells neighbouring instances apart
+const vec3 materialTints[4] = vec3[](
+    vec3(1.0), vec3(1.0, 0.8, 0.8), vec3(0.8, 1.0, 0.8), vec3(0.8, 0.8, 1.0));
+
+uint getCluster() {
+  float depth = -(lighting.view * vec4(fragPosition, 1.0)).z;
+  float slice = log(max(depth, 1e-4)) * lighting.slicing.x + lighting.slicing.y;
+  uvec3 cluster = uvec3(gl_FragCoord.xy / lighting.tiles.zw,
+                        clamp(slice, 0.0, float(clusterGridZ - 1)));
+  cluster.xy = min(cluster.xy, uvec2(clusterGridX - 1, clusterGridY - 1));
+  return (cluster.z * clusterGridY + cluster.y) * clusterGridX + cluster.x;
+}
+
+// Share of the sunlight reaching the fragment, from the first cascade
+// that covers it. Cascades are picked by coverage rather than by depth,
+// since a cached one may still cover a region it was fitted for earlier
+float getShadow(vec3 normal) {
+  float texel = 1.0 / float(textureSize(shadowMap, 0).x);
+  for (uint i = 0; i < shadowCascadeCount; ++i) {
+    if (0 == (lighting.shadowCascadeMask & (1u << i))) {
+      continue;
+    }
+
+    // Pushed out along the normal by about a texel, against acne
+    vec3 position = fragPosition + normal * lighting.shadowTexelSizes[i] * 1.5;
+    vec3 coord = (lighting.shadowMatrices[i] * vec4(position, 1.0)).xyz;
+    vec2 uv = coord.xy * 0.5 + 0.5;
+    if (any(lessThan(uv, vec2(2.0 * texel))) ||
+        any(greaterThan(uv, vec2(1.0 - 2.0 * texel))) || 1.0 < coord.z) {
+      continue;
+    }
+
+    // Four bilinear comparisons, a tent over 3x3 texels. No mips, so the
+    // gradients can be zero in this non-uniform branch
+    float lit = 0.0;
+    for (int y = 0; y < 2; ++y) {
+      for (int x = 0; x < 2; ++x) {
+        vec2 offset = (vec2(x, y) - 0.5) * texel;
+        lit += textureGrad(shadowMap, vec4(uv + offset, float(i), coord.z),
+                           vec2(0.0), vec2(0.0));
+      }
+    }
+    return lit * 0.25;
+  }
+
+  return 1.0;
+}
+
+// Diffuse light from the sun and the lights binned into this fragment's
+// cluster
+vec3 getLighting(vec3 normal) {
+  uint cluster = getCluster();
+  uint count = clusters.lightCounts[cluster];
+  uint first = cluster * maxLightsPerCluster;
+  vec3 result = vec3(ambient);
+  if (0.0 < lighting.sunDirection.w) {
+    float sun = max(dot(normal, lighting.sunDirection.xyz), 0.0);
+    result += sunColor * sun * getShadow(normal);
+  }
+  for (uint i = 0; i < count; ++i) {
+    PointLight light = lighting.lights[clusters.lightIndices[first + i]];
+    vec3 toLight = light.position.xyz - fragPosition;
+    float distance = length(toLight);
+    // Smooth window that reaches zero at the radius
+    float falloff = clamp(1.0 - pow(distance / light.position.w, 4.0), 0.0,
+                          1.0);
+    float attenuation = falloff * falloff / (1.0 + distance * distance);
+    float diffuse = max(dot(normal, toLight / max(distance, 1e-4)), 0.0);
+    result += light.color.rgb * diffuse * attenuation;
+  }
+
+  return result;
+}
+
 void main() {
-  outColor = texture(texSampler, fragTexCoord);
+  // The mesh has no normals, the face normal comes from the derivatives,
+  // taken before any discard and turned towards the camera
+  vec3 normal = normalize(cross(dFdx(fragPosition), dFdy(fragPosition)));
+  if (dot(normal, lighting.camera.xyz - fragPosition) < 0.0) {
+    normal = -normal;
+  }
+
+  vec4 color = vec4(materialTints[fragMaterial % 4], 1.0);
+  if (useVertexColor) {
+    color.rgb *= fragColor;
+  }
+  if (useTexture) {
+    color *= texture(texSampler, fragTexCoord);
+  }
+  if (useAlphaTest && color.a < alphaCutoff) {
+    discard;
+  }
+  // Unlit while there are no lights
+  if (0 < lighting.lightCount || 0.0 < lighting.sunDirection.w) {
+    color.rgb *= getLighting(normal);
+  }
+  outColor = color;
 }
@@ -1,20 +1,36 @@
 #version 450
 
-layout(binding = 0) uniform UniformBufferObject {
+layout(constant_id = 0) const bool useVertexColor = true;
+
+// The instance places the model between the two, see ObjectPushConstants
+layout(push_constant) uniform PushConstants {
+  mat4 viewProj;
   mat4 model;
-  mat4 view;
-  mat4 proj;
-} ubo;
+} object;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
+// Per-instance stream, see InstanceData
+layout(location = 3) in mat4 inModel;
+layout(location = 7) in uint inMaterial;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterial;
+// Scene space, where the lights are, see PointLight
+layout(location = 3) out vec3 fragPosition;
+
+// Matches depth.vert bit for bit, see the depth pre-pass
+invariant gl_Position;
 
 void main() {
-  gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
-  fragColor = inColor;
+  // Mesh part into model space first, then the instance into the scene
+  vec4 position = inModel * (object.model * vec4(inPosition, 1.0));
+  gl_Position = object.viewProj * position;
+  fragColor = useVertexColor ? inColor : vec3(1.0);
   fragTexCoord = inTexCoord;
+  fragMaterial = inMaterial;
+  fragPosition = position.xyz;
 }
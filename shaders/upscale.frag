@@ -0,0 +1,44 @@
+#version 450
+
+// Filters the scaled scene up to the swapchain
+layout(constant_id = 0) const bool sharpen = true;
+const float sharpness = 0.5;
+
+// The scene covers the top-left region of a swapchain-sized image
+layout(push_constant) uniform Upscale {
+  vec2 regionScale;  // rendered extent over image extent
+  vec2 texelSize;    // one texel of the image in texture coordinates
+} upscale;
+
+layout(set = 0, binding = 0) uniform sampler2D scene;
+
+layout(location = 0) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+vec3 fetch(vec2 texCoord) {
+  // Clamped half a texel inside, so bilinear taps never read past the region
+  vec2 limit = upscale.regionScale - upscale.texelSize * 0.5;
+  return texture(scene, clamp(texCoord, upscale.texelSize * 0.5, limit)).rgb;
+}
+
+void main() {
+  vec2 texCoord = fragTexCoord * upscale.regionScale;
+  vec3 color = fetch(texCoord);
+
+  if (sharpen) {
+    // Unsharp mask over the four neighbours, limited to their range so
+    // edges do not ring
+    vec3 north = fetch(texCoord - vec2(0.0, upscale.texelSize.y));
+    vec3 south = fetch(texCoord + vec2(0.0, upscale.texelSize.y));
+    vec3 west = fetch(texCoord - vec2(upscale.texelSize.x, 0.0));
+    vec3 east = fetch(texCoord + vec2(upscale.texelSize.x, 0.0));
+    vec3 low = min(min(north, south), min(west, east));
+    vec3 high = max(max(north, south), max(west, east));
+    vec3 blur = (north + south + west + east) * 0.25;
+    color = clamp(color + (color - blur) * sharpness,
+                  min(low, color), max(high, color));
+  }
+
+  outColor = vec4(color, 1.0);
+}
@@ -0,0 +1,269 @@
+/**
+ * @file benchmark.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+#include "culling.h"
+#include "job_system.h"
+#include "mesh.h"
+#include "transform.h"
+
+namespace vkr {
+
+namespace {
+
+double measureMilliseconds(const std::function<void()>& fn, int runs) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; ++i) {
+    fn();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::milli>(end - start).count() / runs;
+}
+
+bool check(bool condition, const std::string& name, uint32_t workerCount) {
+  if (!condition) {
+    std::cerr << "FAILED: " << name << " with " << workerCount << " workers"
+              << std::endl;
+  }
+
+  return condition;
+}
+
+bool runStressTests(uint32_t workerCount) {
+  JobSystem jobSystem{workerCount};
+  bool passed = true;
+
+  // Many tiny jobs
+  {
+    const uint32_t jobCount = 100000;
+    std::atomic<uint32_t> sum{0};
+    JobCounter counter{};
+    for (uint32_t i = 0; i < jobCount; ++i) {
+      jobSystem.run([&sum] { sum.fetch_add(1, std::memory_order_relaxed); },
+                    &counter);
+    }
+    jobSystem.wait(counter);
+    passed &= check(jobCount == sum, "tiny jobs", workerCount);
+  }
+
+  // Dependencies: every job of the second group must see the first finished
+  {
+    const uint32_t jobCount = 1000;
+    std::vector<uint8_t> produced(jobCount, 0);
+    std::atomic<uint32_t> violations{0};
+    JobCounter first{};
+    JobCounter second{};
+    for (uint32_t i = 0; i < jobCount; ++i) {
+      jobSystem.run([&produced, i] { produced[i] = 1; }, &first);
+    }
+    for (uint32_t i = 0; i < jobCount; ++i) {
+      jobSystem.runAfter(
+          first,
+          [&produced, &violations, i] {
+            if (!produced[i]) {
+              violations.fetch_add(1, std::memory_order_relaxed);
+            }
+          },
+          &second);
+    }
+    jobSystem.wait(second);
+    passed &= check(first.isDone() && 0 == violations, "dependencies",
+                    workerCount);
+  }
+
+  // Nested parallelFor from inside jobs
+  {
+    std::atomic<uint64_t> sum{0};
+    jobSystem.parallelFor(64, 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        jobSystem.parallelFor(1000, 100, [&](size_t innerBegin,
+                                             size_t innerEnd) {
+          uint64_t local = 0;
+          for (size_t j = innerBegin; j < innerEnd; ++j) {
+            local += j;
+          }
+          sum.fetch_add(local, std::memory_order_relaxed);
+        });
+      }
+    });
+    passed &= check(64ull * 999 * 1000 / 2 == sum, "nested parallelFor",
+                    workerCount);
+  }
+
+  // Exceptions reach the waiting thread
+  {
+    JobCounter counter{};
+    jobSystem.run([] { throw std::runtime_error("expected"); }, &counter);
+    bool caught = false;
+    try {
+      jobSystem.wait(counter);
+    } catch (const std::runtime_error&) {
+      caught = true;
+    }
+    passed &= check(caught, "exception propagation", workerCount);
+  }
+
+  return passed;
+}
+
+double syntheticWork(size_t begin, size_t end) {
+  double value = 0.0;
+  for (size_t i = begin; i < end; ++i) {
+    value += std::sqrt(static_cast<double>(i)) * std::sin(i * 0.001);
+  }
+
+  return value;
+}
+
+}  // namespace
+
+int runJobSystemBenchmark() {
+  uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  std::cout << "Job system stress tests" << std::endl;
+  bool passed = true;
+  for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+    passed &= runStressTests(threads - 1);
+  }
+  passed &= runStressTests(maxThreads - 1);
+  std::cout << (passed ? "\tpassed" : "\tFAILED") << std::endl;
+
+  std::cout << "Job system scaling (ms per run)" << std::endl;
+  std::cout << std::setw(8) << "threads" << std::setw(14) << "parallelFor"
+            << std::setw(10) << "speedup" << std::setw(12) << "loadMesh"
+            << std::setw(10) << "speedup" << std::endl;
+
+  double baseSynthetic = 0.0;
+  double baseMesh = 0.0;
+  for (uint32_t threads = 1; threads <= maxThreads; ++threads) {
+    JobSystem jobSystem{threads - 1};
+
+    std::atomic<uint64_t> sink{0};
+    double synthetic = measureMilliseconds(
+        [&] {
+          jobSystem.parallelFor(1 << 22, 1 << 14, [&](size_t begin,
+                                                      size_t end) {
+            double value = syntheticWork(begin, end);
+            sink.fetch_add(static_cast<uint64_t>(value != 0.0),
+                           std::memory_order_relaxed);
+          });
+        },
+        5);
+
+    loadMesh(VK_RENDERER_MODEL_PATH, jobSystem);
+    double mesh = measureMilliseconds(
+        [&] { loadMesh(VK_RENDERER_MODEL_PATH, jobSystem); }, 5);
+
+    if (1 == threads) {
+      baseSynthetic = synthetic;
+      baseMesh = mesh;
+    }
+
+    std::cout << std::fixed << std::setprecision(2) << std::setw(8) << threads
+              << std::setw(14) << synthetic << std::setw(10)
+              << baseSynthetic / synthetic << std::setw(12) << mesh
+              << std::setw(10) << baseMesh / mesh << std::endl;
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int runCullingBenchmark() {
+  JobSystem jobSystem{JobSystem::getDefaultWorkerCount()};
+  glm::mat4 proj = getProjection(16.f / 9.f);
+  glm::mat4 view{1.f};
+  view[3] = glm::vec4(0.f, 0.f, -5.f, 1.f);
+  Frustum frustum = extractFrustum(proj * view);
+
+  std::cout << "Frustum culling (" << getCullingInstructionSet() << ", "
+            << jobSystem.getWorkerCount() + 1 << " threads, objects/ms)"
+            << std::endl;
+  std::cout << std::setw(9) << "objects" << std::setw(9) << "visible"
+            << std::setw(12) << "scalar" << std::setw(12) << "SIMD"
+            << std::setw(10) << "speedup" << std::setw(12) << "parallel"
+            << std::setw(10) << "speedup" << std::endl;
+
+  // Spheres spread well past the far plane, so some of each kind is culled
+  std::mt19937 random{233};
+  std::uniform_real_distribution<float> position{-12.f, 12.f};
+  std::uniform_real_distribution<float> radius{.01f, .5f};
+
+  bool passed = true;
+  for (size_t objectCount : {10000, 100000, 1000000}) {
+    SphereBounds bounds{};
+    bounds.reserve(objectCount);
+    for (size_t i = 0; i < objectCount; ++i) {
+      bounds.push_back(glm::vec4(position(random), position(random),
+                                 position(random), radius(random)));
+    }
+    std::vector<uint32_t> expected(objectCount);
+    std::vector<uint32_t> visible(objectCount);
+    int runs = static_cast<int>(10000000 / objectCount);
+
+    size_t expectedCount = 0;
+    double scalar = measureMilliseconds(
+        [&] {
+          expectedCount = cullSpheresScalar(frustum, bounds, 0, objectCount,
+                                            expected.data());
+        },
+        runs);
+    expected.resize(expectedCount);
+
+    size_t visibleCount = 0;
+    double simd = measureMilliseconds(
+        [&] {
+          visibleCount =
+              cullSpheres(frustum, bounds, 0, objectCount, visible.data());
+        },
+        runs);
+    visible.resize(visibleCount);
+    passed &= expected == visible;
+
+    double parallel = measureMilliseconds(
+        [&] { cullSpheres(jobSystem, frustum, bounds, visible); }, runs);
+    passed &= expected == visible;
+
+    double objects = static_cast<double>(objectCount);
+    std::cout << std::fixed << std::setprecision(0) << std::setw(9)
+              << objectCount << std::setw(9) << expectedCount << std::setw(12)
+              << objects / scalar << std::setw(12) << objects / simd
+              << std::setw(10) << std::setprecision(2) << scalar / simd
+              << std::setw(12) << std::setprecision(0) << objects / parallel
+              << std::setw(10) << std::setprecision(2) << scalar / parallel
+              << std::endl;
+  }
+  if (!passed) {
+    std::cerr << "FAILED: SIMD culling differs from the scalar path"
+              << std::endl;
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+}  // namespace vkr
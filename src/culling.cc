@@ -0,0 +1,212 @@
+/**
+ * @file culling.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "culling.h"
+
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VK_RENDERER_CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace vkr {
+
+namespace {
+
+// Multiple of the SIMD width, so only the last chunk has a scalar tail
+const size_t cullingGrainSize = 16384;
+
+inline glm::vec4 getRow(const glm::mat4& m, int row) {
+  return glm::vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+}
+
+inline glm::vec4 normalizePlane(const glm::vec4& plane) {
+  return plane / glm::length(glm::vec3(plane));
+}
+
+#ifdef VK_RENDERER_CULLING_SSE
+using Lanes = __m128;
+const size_t laneCount = 4;
+
+inline Lanes load(const float* p) { return _mm_loadu_ps(p); }
+inline Lanes broadcast(float value) { return _mm_set1_ps(value); }
+inline Lanes add(Lanes lhs, Lanes rhs) { return _mm_add_ps(lhs, rhs); }
+inline Lanes mul(Lanes lhs, Lanes rhs) { return _mm_mul_ps(lhs, rhs); }
+inline Lanes negate(Lanes value) {
+  return _mm_sub_ps(_mm_setzero_ps(), value);
+}
+inline Lanes greaterEqual(Lanes lhs, Lanes rhs) {
+  return _mm_cmpge_ps(lhs, rhs);
+}
+inline Lanes both(Lanes lhs, Lanes rhs) { return _mm_and_ps(lhs, rhs); }
+inline int getMask(Lanes value) { return _mm_movemask_ps(value); }
+inline Lanes allSet() {
+  return _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+}
+
+struct PlaneLanes {
+  Lanes x;
+  Lanes y;
+  Lanes z;
+  Lanes w;
+};
+
+size_t cullLanes(const Frustum& frustum, const SphereBounds& bounds,
+                 size_t begin, size_t end, uint32_t* visible) {
+  PlaneLanes planes[6];
+  for (int p = 0; p < 6; ++p) {
+    planes[p] = {broadcast(frustum.planes[p].x),
+                 broadcast(frustum.planes[p].y),
+                 broadcast(frustum.planes[p].z),
+                 broadcast(frustum.planes[p].w)};
+  }
+
+  size_t count = 0;
+  size_t i = begin;
+  for (; i + laneCount <= end; i += laneCount) {
+    Lanes x = load(&bounds.x[i]);
+    Lanes y = load(&bounds.y[i]);
+    Lanes z = load(&bounds.z[i]);
+    Lanes minDistance = negate(load(&bounds.radius[i]));
+
+    Lanes inside = allSet();
+    for (const PlaneLanes& plane : planes) {
+      Lanes distance = add(add(add(mul(plane.x, x), mul(plane.y, y)),
+                               mul(plane.z, z)),
+                           plane.w);
+      inside = both(inside, greaterEqual(distance, minDistance));
+    }
+
+    // Every lane is written, only the visible ones advance the count
+    int mask = getMask(inside);
+    for (size_t lane = 0; lane < laneCount; ++lane) {
+      visible[count] = static_cast<uint32_t>(i + lane);
+      count += (mask >> lane) & 1;
+    }
+  }
+
+  return count + cullSpheresScalar(frustum, bounds, i, end, visible + count);
+}
+#endif
+
+}  // namespace
+
+size_t SphereBounds::size() const { return this->radius.size(); }
+
+void SphereBounds::reserve(size_t count) {
+  this->x.reserve(count);
+  this->y.reserve(count);
+  this->z.reserve(count);
+  this->radius.reserve(count);
+}
+
+void SphereBounds::clear() {
+  this->x.clear();
+  this->y.clear();
+  this->z.clear();
+  this->radius.clear();
+}
+
+void SphereBounds::push_back(const glm::vec4& sphere) {
+  this->x.push_back(sphere.x);
+  this->y.push_back(sphere.y);
+  this->z.push_back(sphere.z);
+  this->radius.push_back(sphere.w);
+}
+
+Frustum extractFrustum(const glm::mat4& viewProj) {
+  // Clip space keeps -w <= x, y <= w and 0 <= z <= w
+  glm::vec4 x = getRow(viewProj, 0);
+  glm::vec4 y = getRow(viewProj, 1);
+  glm::vec4 z = getRow(viewProj, 2);
+  glm::vec4 w = getRow(viewProj, 3);
+
+  Frustum frustum{};
+  frustum.planes[0] = normalizePlane(w + x);
+  frustum.planes[1] = normalizePlane(w - x);
+  frustum.planes[2] = normalizePlane(w + y);
+  frustum.planes[3] = normalizePlane(w - y);
+  frustum.planes[4] = normalizePlane(z);
+  frustum.planes[5] = normalizePlane(w - z);
+
+  return frustum;
+}
+
+size_t cullSpheres(const Frustum& frustum, const SphereBounds& bounds,
+                   size_t begin, size_t end, uint32_t* visible) {
+#ifdef VK_RENDERER_CULLING_SSE
+  return cullLanes(frustum, bounds, begin, end, visible);
+#else
+  return cullSpheresScalar(frustum, bounds, begin, end, visible);
+#endif
+}
+
+size_t cullSpheresScalar(const Frustum& frustum, const SphereBounds& bounds,
+                         size_t begin, size_t end, uint32_t* visible) {
+  size_t count = 0;
+  for (size_t i = begin; i < end; ++i) {
+    float minDistance = -bounds.radius[i];
+
+    bool inside = true;
+    for (const glm::vec4& plane : frustum.planes) {
+      float distance = plane.x * bounds.x[i] + plane.y * bounds.y[i] +
+                       plane.z * bounds.z[i] + plane.w;
+      inside &= distance >= minDistance;
+    }
+
+    visible[count] = static_cast<uint32_t>(i);
+    count += inside;
+  }
+
+  return count;
+}
+
+size_t cullSpheres(JobSystem& jobSystem, const Frustum& frustum,
+                   const SphereBounds& bounds,
+                   std::vector<uint32_t>& visible) {
+  size_t count = bounds.size();
+  size_t chunkCount = (count + cullingGrainSize - 1) / cullingGrainSize;
+  std::vector<size_t> chunkVisible(chunkCount, 0);
+  visible.resize(count);
+
+  // parallelFor splits at multiples of the grain size
+  jobSystem.parallelFor(
+      count, cullingGrainSize, [&](size_t begin, size_t end) {
+        chunkVisible[begin / cullingGrainSize] =
+            cullSpheres(frustum, bounds, begin, end, visible.data() + begin);
+      });
+
+  size_t visibleCount = 0;
+  for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+    size_t first = chunk * cullingGrainSize;
+    if (first != visibleCount) {
+      std::copy(visible.begin() + first,
+                visible.begin() + first + chunkVisible[chunk],
+                visible.begin() + visibleCount);
+    }
+    visibleCount += chunkVisible[chunk];
+  }
+  visible.resize(visibleCount);
+
+  return visibleCount;
+}
+
+const char* getCullingInstructionSet() {
+#ifdef VK_RENDERER_CULLING_SSE
+  return "SSE";
+#else
+  return "scalar";
+#endif
+}
+
+}  // namespace vkr
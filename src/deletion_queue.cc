@@ -0,0 +1,33 @@
+/**
+ * @file deletion_queue.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "deletion_queue.h"
+
+#include <utility>
+
+namespace vkr {
+
+void DeletionQueue::push(uint64_t frame, std::function<void()> deleter) {
+  this->entries_.push_back({frame, std::move(deleter)});
+}
+
+void DeletionQueue::flush(uint64_t completedFrames) {
+  // Entries are pushed in frame order, so the ready ones are at the front
+  while (!this->entries_.empty() &&
+         this->entries_.front().frame <= completedFrames) {
+    this->entries_.front().deleter();
+    this->entries_.pop_front();
+  }
+}
+
+size_t DeletionQueue::size() const { return this->entries_.size(); }
+
+}  // namespace vkr
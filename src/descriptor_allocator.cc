@@ -0,0 +1,315 @@
+/**
+ * @file descriptor_allocator.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "descriptor_allocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+namespace vkr {
+
+namespace {
+
+const uint32_t maxSetsPerPool = 4096;
+
+// Handles of every immutable sampler, binding by binding
+std::vector<VkSampler> getImmutableSamplers(
+    const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+  std::vector<VkSampler> samplers{};
+  for (const auto& binding : bindings) {
+    if (binding.pImmutableSamplers) {
+      samplers.insert(samplers.end(), binding.pImmutableSamplers,
+                      binding.pImmutableSamplers + binding.descriptorCount);
+    }
+  }
+
+  return samplers;
+}
+
+uint64_t hashBindings(
+    const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+    const std::vector<VkSampler>& immutableSamplers) {
+  uint64_t hash = 14695981039346656037ull;
+  auto add = [&hash](uint64_t value) {
+    for (size_t i = 0; i < sizeof(value); ++i) {
+      hash = (hash ^ ((value >> (i * 8)) & 0xff)) * 1099511628211ull;
+    }
+  };
+
+  add(bindings.size());
+  for (const auto& binding : bindings) {
+    add(binding.binding);
+    add(binding.descriptorType);
+    add(binding.descriptorCount);
+    add(binding.stageFlags);
+    add(nullptr != binding.pImmutableSamplers);
+  }
+  for (VkSampler sampler : immutableSamplers) {
+    add(reinterpret_cast<uint64_t>(sampler));
+  }
+
+  return hash;
+}
+
+bool isSameBinding(const VkDescriptorSetLayoutBinding& lhs,
+                   const VkDescriptorSetLayoutBinding& rhs) {
+  return lhs.binding == rhs.binding &&
+         lhs.descriptorType == rhs.descriptorType &&
+         lhs.descriptorCount == rhs.descriptorCount &&
+         lhs.stageFlags == rhs.stageFlags &&
+         (nullptr == lhs.pImmutableSamplers) ==
+             (nullptr == rhs.pImmutableSamplers);
+}
+
+bool isImageDescriptor(VkDescriptorType type) {
+  return VK_DESCRIPTOR_TYPE_SAMPLER == type ||
+         VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER == type ||
+         VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE == type ||
+         VK_DESCRIPTOR_TYPE_STORAGE_IMAGE == type ||
+         VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT == type;
+}
+
+bool isTexelBufferDescriptor(VkDescriptorType type) {
+  return VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER == type ||
+         VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER == type;
+}
+
+}  // namespace
+
+DescriptorLayoutCache::DescriptorLayoutCache(VkDevice device)
+    : device_(device) {}
+
+DescriptorLayoutCache::~DescriptorLayoutCache() {
+  for (const auto& entry : layouts_) {
+    for (const Layout& layout : entry.second) {
+      vkDestroyDescriptorSetLayout(device_, layout.layout, nullptr);
+    }
+  }
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::get(
+    std::vector<VkDescriptorSetLayoutBinding> bindings) {
+  std::sort(bindings.begin(), bindings.end(),
+            [](const VkDescriptorSetLayoutBinding& lhs,
+               const VkDescriptorSetLayoutBinding& rhs) {
+              return lhs.binding < rhs.binding;
+            });
+  std::vector<VkSampler> immutableSamplers = getImmutableSamplers(bindings);
+  uint64_t hash = hashBindings(bindings, immutableSamplers);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Layout>& bucket = layouts_[hash];
+  for (const Layout& layout : bucket) {
+    if (layout.immutableSamplers == immutableSamplers &&
+        std::equal(layout.bindings.begin(), layout.bindings.end(),
+                   bindings.begin(), bindings.end(), isSameBinding)) {
+      return layout.layout;
+    }
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+  VkResult result =
+      vkCreateDescriptorSetLayout(device_, &layoutInfo, nullptr, &layout);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to create descriptor set layout!");
+  }
+  bucket.push_back({std::move(bindings), std::move(immutableSamplers), layout});
+
+  return layout;
+}
+
+uint32_t DescriptorLayoutCache::getLayoutCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t count = 0;
+  for (const auto& entry : layouts_) {
+    count += entry.second.size();
+  }
+
+  return static_cast<uint32_t>(count);
+}
+
+DescriptorAllocator::DescriptorAllocator(
+    VkDevice device, uint32_t setsPerPool,
+    const std::vector<DescriptorPoolRatio>& ratios)
+    : device_(device), setsPerPool_(setsPerPool), ratios_(ratios) {}
+
+DescriptorAllocator::~DescriptorAllocator() {
+  for (VkDescriptorPool pool : readyPools_) {
+    vkDestroyDescriptorPool(device_, pool, nullptr);
+  }
+  for (VkDescriptorPool pool : fullPools_) {
+    vkDestroyDescriptorPool(device_, pool, nullptr);
+  }
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+  VkDescriptorPool pool = takePool();
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = pool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &layout;
+
+  VkDescriptorSet set = VK_NULL_HANDLE;
+  VkResult result = vkAllocateDescriptorSets(device_, &allocInfo, &set);
+  if (VK_ERROR_OUT_OF_POOL_MEMORY == result ||
+      VK_ERROR_FRAGMENTED_POOL == result) {
+    // Retired until the next reset, the retry goes to a fresh pool
+    fullPools_.push_back(pool);
+    pool = takePool();
+    allocInfo.descriptorPool = pool;
+    result = vkAllocateDescriptorSets(device_, &allocInfo, &set);
+  }
+  readyPools_.push_back(pool);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to allocate descriptor sets!");
+  }
+
+  ++setCount_;
+
+  return set;
+}
+
+void DescriptorAllocator::reset() {
+  for (VkDescriptorPool pool : readyPools_) {
+    vkResetDescriptorPool(device_, pool, 0);
+  }
+  for (VkDescriptorPool pool : fullPools_) {
+    vkResetDescriptorPool(device_, pool, 0);
+    readyPools_.push_back(pool);
+  }
+  fullPools_.clear();
+  setCount_ = 0;
+}
+
+uint32_t DescriptorAllocator::getPoolCount() const {
+  return static_cast<uint32_t>(readyPools_.size() + fullPools_.size());
+}
+
+uint32_t DescriptorAllocator::getSetCount() const { return this->setCount_; }
+
+VkDescriptorPool DescriptorAllocator::takePool() {
+  if (!readyPools_.empty()) {
+    VkDescriptorPool pool = readyPools_.back();
+    readyPools_.pop_back();
+    return pool;
+  }
+
+  VkDescriptorPool pool = createPool(setsPerPool_);
+  setsPerPool_ = std::min(setsPerPool_ * 2, maxSetsPerPool);
+
+  return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount) {
+  std::vector<VkDescriptorPoolSize> poolSizes{};
+  for (const auto& ratio : ratios_) {
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = ratio.type;
+    poolSize.descriptorCount = std::max(
+        1u, static_cast<uint32_t>(ratio.descriptorsPerSet * setCount));
+    poolSizes.push_back(poolSize);
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = setCount;
+
+  VkDescriptorPool pool = VK_NULL_HANDLE;
+  VkResult result = vkCreateDescriptorPool(device_, &poolInfo, nullptr, &pool);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to create descriptor pool!");
+  }
+
+  return pool;
+}
+
+DescriptorUpdateTemplate::DescriptorUpdateTemplate(
+    VkDevice device, VkPhysicalDevice physicalDevice,
+    VkDescriptorSetLayout layout,
+    const std::vector<VkDescriptorUpdateTemplateEntry>& entries)
+    : device_(device), entries_(entries) {
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  if (properties.apiVersion < VK_API_VERSION_1_1) {
+    return;
+  }
+
+  VkDescriptorUpdateTemplateCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+  createInfo.descriptorUpdateEntryCount =
+      static_cast<uint32_t>(entries_.size());
+  createInfo.pDescriptorUpdateEntries = entries_.data();
+  createInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+  createInfo.descriptorSetLayout = layout;
+
+  VkResult result = vkCreateDescriptorUpdateTemplate(device_, &createInfo,
+                                                     nullptr, &updateTemplate_);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to create descriptor update template!");
+  }
+}
+
+DescriptorUpdateTemplate::~DescriptorUpdateTemplate() {
+  if (VK_NULL_HANDLE != updateTemplate_) {
+    vkDestroyDescriptorUpdateTemplate(device_, updateTemplate_, nullptr);
+  }
+}
+
+void DescriptorUpdateTemplate::update(VkDescriptorSet set,
+                                      const void* data) const {
+  if (VK_NULL_HANDLE != updateTemplate_) {
+    vkUpdateDescriptorSetWithTemplate(device_, set, updateTemplate_, data);
+    return;
+  }
+
+  const char* bytes = static_cast<const char*>(data);
+  std::vector<VkWriteDescriptorSet> descriptorWrites{};
+  for (const auto& entry : entries_) {
+    for (uint32_t i = 0; i < entry.descriptorCount; ++i) {
+      const char* info = bytes + entry.offset + i * entry.stride;
+
+      VkWriteDescriptorSet descriptorWrite{};
+      descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      descriptorWrite.dstSet = set;
+      descriptorWrite.dstBinding = entry.dstBinding;
+      descriptorWrite.dstArrayElement = entry.dstArrayElement + i;
+      descriptorWrite.descriptorType = entry.descriptorType;
+      descriptorWrite.descriptorCount = 1;
+      if (isImageDescriptor(entry.descriptorType)) {
+        descriptorWrite.pImageInfo =
+            reinterpret_cast<const VkDescriptorImageInfo*>(info);
+      } else if (isTexelBufferDescriptor(entry.descriptorType)) {
+        descriptorWrite.pTexelBufferView =
+            reinterpret_cast<const VkBufferView*>(info);
+      } else {
+        descriptorWrite.pBufferInfo =
+            reinterpret_cast<const VkDescriptorBufferInfo*>(info);
+      }
+      descriptorWrites.push_back(descriptorWrite);
+    }
+  }
+
+  vkUpdateDescriptorSets(device_,
+                         static_cast<uint32_t>(descriptorWrites.size()),
+                         descriptorWrites.data(), 0, nullptr);
+}
+
+}  // namespace vkr
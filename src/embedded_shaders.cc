@@ -0,0 +1,26 @@
+/**
+ * @file embedded_shaders.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "embedded_shaders.h"
+
+namespace vkr {
+
+const EmbeddedShader* findEmbeddedShader(const std::string& name) {
+  for (size_t i = 0; i < embeddedShaderCount; ++i) {
+    if (name == embeddedShaders[i].name) {
+      return &embeddedShaders[i];
+    }
+  }
+
+  return nullptr;
+}
+
+}  // namespace vkr
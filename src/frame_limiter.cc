@@ -0,0 +1,65 @@
+/**
+ * @file frame_limiter.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "frame_limiter.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace vkr {
+
+void FrameLimiter::setFrameRate(double frameRate) {
+  Clock::duration period{0};
+  if (frameRate > 0.0) {
+    period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / frameRate));
+  }
+
+  if (period != this->period_) {
+    this->period_ = period;
+    this->nextFrame_ = Clock::now();
+  }
+}
+
+double FrameLimiter::wait() {
+  if (Clock::duration::zero() == this->period_) {
+    return 0.0;
+  }
+
+  Clock::time_point start = Clock::now();
+  this->nextFrame_ += this->period_;
+
+  // Missed the deadline by more than a frame: restart the schedule instead of
+  // rendering a burst of frames to catch up
+  if (start > this->nextFrame_ + this->period_) {
+    this->nextFrame_ = start;
+    return 0.0;
+  }
+
+  Clock::time_point sleepUntil = this->nextFrame_ - this->spinMargin_;
+  if (start < sleepUntil) {
+    std::this_thread::sleep_until(sleepUntil);
+
+    Clock::duration oversleep = Clock::now() - sleepUntil;
+    Clock::duration margin = std::max(this->spinMargin_ * 15 / 16, oversleep);
+    this->spinMargin_ = std::clamp<Clock::duration>(
+        margin, std::chrono::microseconds(200), std::chrono::milliseconds(4));
+  }
+
+  while (Clock::now() < this->nextFrame_) {
+    std::this_thread::yield();
+  }
+
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+}  // namespace vkr
@@ -15,6 +15,12 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_vulkan.h>
 
+#include <chrono>
+#include <stdexcept>
+
+#include "lights.h"
+#include "shadows.h"
+
 namespace vkr {
 
 GUI::GUI(const GUIConfig& config) {
@@ -35,21 +41,48 @@ GUI::GUI(const GUIConfig& config) {
   info.DescriptorPool = config.descriptorPool;
   info.RenderPass = config.renderPass;
   info.Subpass = config.subpass;
+#ifdef IMGUI_IMPL_VULKAN_HAS_DYNAMIC_RENDERING
+  info.UseDynamicRendering = config.useDynamicRendering;
+  info.PipelineRenderingCreateInfo = config.pipelineRenderingCreateInfo;
+#else
+  if (config.useDynamicRendering) {
+    throw std::runtime_error("ImGui was built without dynamic rendering!");
+  }
+#endif
   info.MinImageCount = config.minImageCount;
   info.ImageCount = config.imageCount;
   info.MSAASamples = config.msaaSamples;
   info.Allocator = config.allocator;
   info.CheckVkResultFn = config.checkVkResultFn;
+  // The pipeline is the bulk of the backend init; the context and the font
+  // upload are left out
+  auto pipelineStart = std::chrono::steady_clock::now();
   ImGui_ImplVulkan_Init(&info);
+  auto pipelineEnd = std::chrono::steady_clock::now();
+  this->pipelineTime_ =
+      std::chrono::duration<double, std::milli>(pipelineEnd - pipelineStart)
+          .count();
+
+  // Upload the font atlas now, while this thread still owns the queue
+  ImGui_ImplVulkan_CreateFontsTexture();
 }
 
+GUIFrame::~GUIFrame() {
+  for (ImDrawList* drawList : this->drawLists_) {
+    IM_DELETE(drawList);
+  }
+}
+
+double GUI::getPipelineTime() const { return this->pipelineTime_; }
+
 GUI::~GUI() {
   ImGui_ImplVulkan_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();
 }
 
-void GUI::draw(VkCommandBuffer commandBuffer) {
+void GUI::buildFrame(GUIFrame& frame, const Profiler& profiler,
+                     RenderSettings& settings) {
   ImGui_ImplVulkan_NewFrame();
   ImGui_ImplGlfw_NewFrame();
   ImGui::NewFrame();
@@ -62,11 +95,142 @@ void GUI::draw(VkCommandBuffer commandBuffer) {
   ImGui::Text("Average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate,
               io.Framerate);
 
+  for (const auto& entry : profiler.getEntries()) {
+    if (!entry.text.empty()) {
+      ImGui::Text("%s: %s", entry.name.c_str(), entry.text.c_str());
+    } else if (entry.isTime) {
+      ImGui::Text("%s: %.3f ms", entry.name.c_str(), entry.value);
+    } else {
+      ImGui::Text("%s: %.0f", entry.name.c_str(), entry.value);
+    }
+  }
+
+  ImGui::End();
+
+  ImGui::Begin("Settings");
+
+  if (ImGui::BeginCombo("Present mode",
+                        getPresentModeName(settings.presentMode))) {
+    for (int i = PresentMode::Fifo; i <= PresentMode::Immediate; ++i) {
+      PresentMode presentMode = static_cast<PresentMode>(i);
+      if (ImGui::Selectable(getPresentModeName(presentMode),
+                            presentMode == settings.presentMode)) {
+        settings.presentMode = presentMode;
+      }
+    }
+    ImGui::EndCombo();
+  }
+
+  ImGui::Checkbox("Present wait", &settings.presentWait);
+  ImGui::SliderFloat("Frame limit", &settings.frameRateLimit, 0.f, 480.f,
+                     settings.frameRateLimit > 0.f ? "%.0f FPS" : "off");
+  ImGui::Checkbox("Backface culling", &settings.backfaceCulling);
+  ImGui::Checkbox("Instanced draws", &settings.instancing);
+  ImGui::Checkbox("GPU culling", &settings.gpuCulling);
+  ImGui::Checkbox("Occlusion culling", &settings.occlusionCulling);
+  ImGui::Checkbox("Async compute", &settings.asyncCompute);
+  ImGui::Checkbox("Depth pre-pass", &settings.depthPrepass);
+  ImGui::Checkbox("Dynamic resolution", &settings.dynamicResolution);
+  ImGui::SliderFloat("Target GPU time", &settings.targetGpuTime, 2.f, 50.f,
+                     "%.1f ms");
+  ImGui::Checkbox("Sharpen upscale", &settings.sharpenUpscale);
+
+  if (ImGui::BeginCombo("Anti-aliasing",
+                        getAntiAliasingName(settings.antiAliasing))) {
+    for (int i = AntiAliasing::Msaa; i <= AntiAliasing::Taa; ++i) {
+      AntiAliasing antiAliasing = static_cast<AntiAliasing>(i);
+      if (ImGui::Selectable(getAntiAliasingName(antiAliasing),
+                            antiAliasing == settings.antiAliasing)) {
+        settings.antiAliasing = antiAliasing;
+      }
+    }
+    ImGui::EndCombo();
+  }
+
+  const char* sampleCountNames[] = {"1x", "2x", "4x", "8x"};
+  int sampleCountIndex = 0;
+  while (sampleCountIndex < 3 &&
+         (2u << sampleCountIndex) <= settings.msaaSamples) {
+    ++sampleCountIndex;
+  }
+  if (ImGui::Combo("MSAA samples", &sampleCountIndex, sampleCountNames, 4)) {
+    settings.msaaSamples = 1u << sampleCountIndex;
+  }
+
+  const uint32_t minLights = 0;
+  const uint32_t maxLights = maxLightCount;
+  ImGui::SliderScalar("Lights", ImGuiDataType_U32, &settings.lightCount,
+                      &minLights, &maxLights, "%u",
+                      ImGuiSliderFlags_Logarithmic);
+
+  ImGui::Checkbox("Shadows", &settings.shadows);
+  ImGui::Checkbox("Cache far cascades", &settings.shadowCaching);
+  const uint32_t minUpdates = 1;
+  const uint32_t maxUpdates = shadowCascadeCount - shadowNearCascadeCount;
+  ImGui::SliderScalar("Cascade updates per frame", ImGuiDataType_U32,
+                      &settings.shadowUpdateBudget, &minUpdates, &maxUpdates,
+                      "%u");
+  ImGui::SliderFloat("Sun azimuth", &settings.sunAzimuth, 0.f, 360.f,
+                     "%.0f deg");
+  ImGui::SliderFloat("Sun elevation", &settings.sunElevation, 5.f, 90.f,
+                     "%.0f deg");
+
+  ImGui::SeparatorText("Shader features");
+  for (uint32_t i = 0; i < shaderFeatureCount; ++i) {
+    ShaderFeature feature = static_cast<ShaderFeature>(1u << i);
+    ImGui::CheckboxFlags(getShaderFeatureName(feature),
+                         &settings.shaderFeatures, feature);
+  }
+
   ImGui::End();
 
   ImGui::Render();
   ImDrawData* drawData = ImGui::GetDrawData();
-  ImGui_ImplVulkan_RenderDrawData(drawData, commandBuffer);
+
+  frame.drawListCount_ = static_cast<size_t>(drawData->CmdListsCount);
+  while (frame.drawLists_.size() < frame.drawListCount_) {
+    frame.drawLists_.push_back(
+        IM_NEW(ImDrawList)(ImGui::GetDrawListSharedData()));
+  }
+
+  for (size_t i = 0; i < frame.drawListCount_; ++i) {
+    const ImDrawList* src = drawData->CmdLists[static_cast<int>(i)];
+    ImDrawList* dst = frame.drawLists_[i];
+    dst->CmdBuffer = src->CmdBuffer;
+    dst->IdxBuffer = src->IdxBuffer;
+    dst->VtxBuffer = src->VtxBuffer;
+    dst->Flags = src->Flags;
+  }
+
+  frame.displayPos_[0] = drawData->DisplayPos.x;
+  frame.displayPos_[1] = drawData->DisplayPos.y;
+  frame.displaySize_[0] = drawData->DisplaySize.x;
+  frame.displaySize_[1] = drawData->DisplaySize.y;
+  frame.framebufferScale_[0] = drawData->FramebufferScale.x;
+  frame.framebufferScale_[1] = drawData->FramebufferScale.y;
+}
+
+void GUI::draw(VkCommandBuffer commandBuffer, const GUIFrame& frame) {
+  ImDrawData drawData{};
+  drawData.Valid = true;
+  drawData.DisplayPos = ImVec2(frame.displayPos_[0], frame.displayPos_[1]);
+  drawData.DisplaySize = ImVec2(frame.displaySize_[0], frame.displaySize_[1]);
+  drawData.FramebufferScale =
+      ImVec2(frame.framebufferScale_[0], frame.framebufferScale_[1]);
+  // Filled by hand, AddDrawList() would trim the copies as if they were
+  // being built
+  for (size_t i = 0; i < frame.drawListCount_; ++i) {
+    ImDrawList* drawList = frame.drawLists_[i];
+    drawData.CmdLists.push_back(drawList);
+    drawData.TotalVtxCount += drawList->VtxBuffer.Size;
+    drawData.TotalIdxCount += drawList->IdxBuffer.Size;
+  }
+  drawData.CmdListsCount = drawData.CmdLists.Size;
+
+  // The backend only reads its own data through the context, set up in the
+  // constructor and never written by NewFrame(); the font atlas is uploaded
+  // there too, so recording does not race the main thread
+  ImGui_ImplVulkan_RenderDrawData(&drawData, commandBuffer);
 }
 
 }  // namespace vkr
\ No newline at end of file
@@ -0,0 +1,292 @@
+/**
+ * @file job_system.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "job_system.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace vkr {
+
+namespace {
+
+thread_local const JobSystem* currentJobSystem = nullptr;
+thread_local uint32_t currentWorkerIndex = 0;
+
+}  // namespace
+
+bool JobCounter::isDone() const {
+  return 0 == this->pending_.load(std::memory_order_acquire);
+}
+
+JobSystem::JobSystem(uint32_t workerCount) {
+  // The last queue is shared by threads outside the pool
+  for (uint32_t i = 0; i < workerCount + 1; ++i) {
+    this->queues_.push_back(std::make_unique<TaskQueue>());
+  }
+
+  this->workers_.reserve(workerCount);
+  for (uint32_t i = 0; i < workerCount; ++i) {
+    this->workers_.emplace_back(&JobSystem::workerLoop, this, i);
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(this->sleepMutex_);
+    this->stop_ = true;
+  }
+  this->sleepCondition_.notify_all();
+
+  for (auto& worker : this->workers_) {
+    worker.join();
+  }
+}
+
+uint32_t JobSystem::getWorkerCount() const {
+  return static_cast<uint32_t>(this->workers_.size());
+}
+
+void JobSystem::run(Job job, JobCounter* counter) {
+  if (counter) {
+    counter->pending_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  push({std::move(job), counter});
+}
+
+void JobSystem::runAfter(JobCounter& dependency, Job job, JobCounter* counter) {
+  if (counter) {
+    counter->pending_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(dependency.mutex_);
+    if (!dependency.isDone()) {
+      dependency.continuations_.push_back({std::move(job), counter});
+      return;
+    }
+  }
+
+  push({std::move(job), counter});
+}
+
+void JobSystem::runBackground(Job job, JobCounter* counter) {
+  if (counter) {
+    counter->pending_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->backgroundQueue_.mutex);
+    this->backgroundQueue_.tasks.push_back({std::move(job), counter});
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->sleepMutex_);
+    this->queuedBackgroundTasks_.fetch_add(1, std::memory_order_release);
+  }
+  this->sleepCondition_.notify_one();
+}
+
+void JobSystem::wait(JobCounter& counter) {
+  while (!counter.isDone()) {
+    if (!tryExecute() &&
+        !(this->workers_.empty() && tryExecuteBackground())) {
+      std::this_thread::yield();
+    }
+  }
+
+  std::exception_ptr exception{};
+  {
+    std::lock_guard<std::mutex> lock(counter.mutex_);
+    std::swap(exception, counter.exception_);
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+void JobSystem::parallelFor(
+    size_t count, size_t grainSize,
+    const std::function<void(size_t begin, size_t end)>& body) {
+  grainSize = std::max<size_t>(grainSize, 1);
+
+  JobCounter counter{};
+  for (size_t begin = 0; begin < count; begin += grainSize) {
+    size_t end = std::min(begin + grainSize, count);
+    run([&body, begin, end] { body(begin, end); }, &counter);
+  }
+
+  wait(counter);
+}
+
+uint32_t JobSystem::getDefaultWorkerCount() {
+  // Leave one core to the thread that submits and waits
+  return std::max(std::thread::hardware_concurrency(), 2u) - 1;
+}
+
+void JobSystem::push(Task task) {
+  TaskQueue& queue = *this->queues_[getCurrentQueueIndex()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->sleepMutex_);
+    this->queuedTasks_.fetch_add(1, std::memory_order_release);
+  }
+  this->sleepCondition_.notify_one();
+}
+
+bool JobSystem::pop(uint32_t queueIndex, Task& task) {
+  TaskQueue& queue = *this->queues_[queueIndex];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty()) {
+    return false;
+  }
+
+  task = std::move(queue.tasks.back());
+  queue.tasks.pop_back();
+  this->queuedTasks_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool JobSystem::steal(uint32_t queueIndex, Task& task) {
+  TaskQueue& queue = *this->queues_[queueIndex];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty()) {
+    return false;
+  }
+
+  task = std::move(queue.tasks.front());
+  queue.tasks.pop_front();
+  this->queuedTasks_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool JobSystem::tryExecute() {
+  if (0 == this->queuedTasks_.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  uint32_t ownQueue = getCurrentQueueIndex();
+  uint32_t queueCount = static_cast<uint32_t>(this->queues_.size());
+
+  Task task{};
+  bool found = pop(ownQueue, task);
+  for (uint32_t i = 1; !found && i < queueCount; ++i) {
+    found = steal((ownQueue + i) % queueCount, task);
+  }
+
+  if (found) {
+    execute(task);
+  }
+
+  return found;
+}
+
+bool JobSystem::tryExecuteBackground() {
+  if (0 == this->queuedBackgroundTasks_.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  Task task{};
+  {
+    std::lock_guard<std::mutex> lock(this->backgroundQueue_.mutex);
+    if (this->backgroundQueue_.tasks.empty()) {
+      return false;
+    }
+    task = std::move(this->backgroundQueue_.tasks.front());
+    this->backgroundQueue_.tasks.pop_front();
+    this->queuedBackgroundTasks_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  execute(task);
+  return true;
+}
+
+void JobSystem::execute(Task& task) {
+  std::exception_ptr exception{};
+  try {
+    task.job();
+  } catch (...) {
+    exception = std::current_exception();
+  }
+
+  // Nobody waits for a job without a counter, so its error is only logged
+  if (!task.counter) {
+    if (exception) {
+      try {
+        std::rethrow_exception(exception);
+      } catch (const std::exception& e) {
+        std::clog << "Job failed: " << e.what() << std::endl;
+      } catch (...) {
+        std::clog << "Job failed" << std::endl;
+      }
+    }
+    return;
+  }
+
+  finish(task.counter, exception);
+}
+
+void JobSystem::finish(JobCounter* counter, std::exception_ptr exception) {
+  // The last job drops the count and takes the continuations in one step.
+  // wait() locks the mutex before it returns, so the counter outlives this
+  // block, and is not touched after it
+  std::vector<JobCounter::Continuation> continuations{};
+  {
+    std::lock_guard<std::mutex> lock(counter->mutex_);
+    if (exception && !counter->exception_) {
+      counter->exception_ = exception;
+    }
+    if (1 != counter->pending_.fetch_sub(1, std::memory_order_acq_rel)) {
+      return;
+    }
+    std::swap(continuations, counter->continuations_);
+  }
+
+  for (auto& continuation : continuations) {
+    push({std::move(continuation.job), continuation.counter});
+  }
+}
+
+void JobSystem::workerLoop(uint32_t workerIndex) {
+  currentJobSystem = this;
+  currentWorkerIndex = workerIndex;
+
+  while (true) {
+    if (tryExecute() || tryExecuteBackground()) {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(this->sleepMutex_);
+    this->sleepCondition_.wait(lock, [this] {
+      return this->stop_ ||
+             0 != this->queuedTasks_.load(std::memory_order_acquire) ||
+             0 != this->queuedBackgroundTasks_.load(std::memory_order_acquire);
+    });
+    if (this->stop_) {
+      return;
+    }
+  }
+}
+
+uint32_t JobSystem::getCurrentQueueIndex() const {
+  if (this == currentJobSystem) {
+    return currentWorkerIndex;
+  }
+
+  return static_cast<uint32_t>(this->workers_.size());
+}
+
+}  // namespace vkr
@@ -0,0 +1,70 @@
+/**
+ * @file light_benchmark.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "light_benchmark.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace vkr {
+
+namespace {
+
+const uint32_t lightCounts[] = {10, 30, 100, 300, 1000, 3000, 10000};
+const size_t stepCount = sizeof(lightCounts) / sizeof(lightCounts[0]);
+// Frames in flight with the last count, plus pipeline and upload warm-up
+const uint32_t warmupFrames = 16;
+const uint32_t measuredFrames = 128;
+
+}  // namespace
+
+LightBenchmark::LightBenchmark(const std::string& description) {
+  std::cout << "Clustered lighting (" << description << ", GPU ms)"
+            << std::endl;
+  std::cout << std::setw(8) << "lights" << std::setw(10) << "frame"
+            << std::setw(10) << "binning" << std::setw(10) << "rest"
+            << std::endl;
+}
+
+uint32_t LightBenchmark::getLightCount() const {
+  return lightCounts[std::min(this->step_, stepCount - 1)];
+}
+
+bool LightBenchmark::addFrame(double frameTime, double binningTime) {
+  if (this->step_ >= stepCount) {
+    return true;
+  }
+
+  if (++this->frame_ <= warmupFrames) {
+    return false;
+  }
+  this->frameTime_ += frameTime;
+  this->binningTime_ += binningTime;
+  if (this->frame_ < warmupFrames + measuredFrames) {
+    return false;
+  }
+
+  double frame = this->frameTime_ / measuredFrames;
+  double binning = this->binningTime_ / measuredFrames;
+  std::cout << std::fixed << std::setprecision(3) << std::setw(8)
+            << getLightCount() << std::setw(10) << frame << std::setw(10)
+            << binning << std::setw(10) << frame - binning << std::endl;
+
+  ++this->step_;
+  this->frame_ = 0;
+  this->frameTime_ = 0.0;
+  this->binningTime_ = 0.0;
+
+  return this->step_ >= stepCount;
+}
+
+}  // namespace vkr
@@ -0,0 +1,59 @@
+/**
+ * @file lights.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "lights.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+#include <random>
+
+namespace vkr {
+
+namespace {
+
+// Overlapping lights at any point, roughly
+const float lightDensity = 2.f;
+
+// Fully saturated, hue in [0, 1)
+glm::vec3 getHueColor(float hue) {
+  glm::vec3 phase = glm::fract(hue + glm::vec3(1.f, 2.f / 3.f, 1.f / 3.f));
+  return glm::clamp(glm::abs(phase * 6.f - 3.f) - 1.f, 0.f, 1.f);
+}
+
+}  // namespace
+
+std::vector<PointLight> createLights(uint32_t count, const glm::vec4& sphere) {
+  std::mt19937 random{count};
+  std::uniform_real_distribution<float> offset{-1.f, 1.f};
+  std::uniform_real_distribution<float> hue{0.f, 1.f};
+
+  // count spheres of this radius add up to lightDensity times the 8 r^3
+  // of the box
+  float lightCount = static_cast<float>(std::max(count, 1u));
+  float radius = sphere.w * std::cbrt(lightDensity * 6.f /
+                                      (glm::pi<float>() * lightCount));
+
+  std::vector<PointLight> lights(count);
+  for (PointLight& light : lights) {
+    // One draw per statement, argument order is unspecified
+    float x = offset(random);
+    float y = offset(random);
+    float z = offset(random);
+    glm::vec3 position = glm::vec3(sphere) + sphere.w * glm::vec3(x, y, z);
+    light.position = glm::vec4(position, radius);
+    light.color = glm::vec4(getHueColor(hue(random)), 1.f);
+  }
+
+  return lights;
+}
+
+}  // namespace vkr
@@ -9,16 +9,161 @@
  *
  */
 
+#include <cctype>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
+#include "benchmark.h"
+#include "lights.h"
 #include "renderer.h"
 
-int main() {
-  vkr::Renderer renderer{};
+namespace {
+
+// One thread each, far beyond any core count
+const unsigned long maxWorkerCount = 256;
+
+// The whole argument has to be a number in [min, max]
+bool parseCount(const char* text, unsigned long min, unsigned long max,
+                uint32_t& value) {
+  // strtoul() would accept a sign and wrap negative numbers around
+  if (!std::isdigit(static_cast<unsigned char>(text[0]))) {
+    return false;
+  }
+  char* end = nullptr;
+  unsigned long number = std::strtoul(text, &end, 10);
+  if ('\0' != *end || number < min || number > max) {
+    return false;
+  }
+  value = static_cast<uint32_t>(number);
+
+  return true;
+}
+
+bool parseFrameRate(const char* text, float& value) {
+  char* end = nullptr;
+  float number = std::strtof(text, &end);
+  if (text == end || '\0' != *end || !std::isfinite(number) || 0.f > number) {
+    return false;
+  }
+  value = number;
+
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc > 1 && 0 == std::strcmp(argv[1], "--bench-jobs")) {
+    try {
+      return vkr::runJobSystemBenchmark();
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (argc > 1 && 0 == std::strcmp(argv[1], "--bench-culling")) {
+    try {
+      return vkr::runCullingBenchmark();
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  vkr::RendererConfig config{};
+  for (int i = 1; i < argc; ++i) {
+    std::string option = argv[i];
+    if ("--present-mode" == option && i + 1 < argc) {
+      if (!vkr::parsePresentMode(argv[++i], config.settings.presentMode)) {
+        std::cerr << "Unknown present mode: " << argv[i] << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if ("--present-wait" == option) {
+      config.settings.presentWait = true;
+    } else if ("--render-pass" == option) {
+      config.dynamicRendering = false;
+    } else if ("--dump-render-graph" == option) {
+      config.dumpRenderGraph = true;
+    } else if ("--fps-limit" == option && i + 1 < argc) {
+      if (!parseFrameRate(argv[++i], config.settings.frameRateLimit)) {
+        std::cerr << "Invalid frame limit: " << argv[i] << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if ("--instances" == option && i + 1 < argc) {
+      if (!parseCount(argv[++i], 1, UINT32_MAX, config.instanceCount)) {
+        std::cerr << "Invalid instance count: " << argv[i] << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if ("--per-object-draws" == option) {
+      config.settings.instancing = false;
+    } else if ("--gpu-culling" == option) {
+      config.settings.gpuCulling = true;
+    } else if ("--occlusion-culling" == option) {
+      config.settings.gpuCulling = true;
+      config.settings.occlusionCulling = true;
+    } else if ("--depth-prepass" == option) {
+      config.settings.depthPrepass = true;
+    } else if ("--anti-aliasing" == option && i + 1 < argc) {
+      if (!vkr::parseAntiAliasing(argv[++i], config.settings.antiAliasing)) {
+        std::cerr << "Unknown anti-aliasing mode: " << argv[i] << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if ("--msaa" == option && i + 1 < argc) {
+      uint32_t samples = 0;
+      if (!parseCount(argv[++i], 1, 8, samples) || (samples & (samples - 1))) {
+        std::cerr << "Invalid MSAA sample count: " << argv[i] << std::endl;
+        return EXIT_FAILURE;
+      }
+      config.settings.msaaSamples = samples;
+    } else if ("--lights" == option && i + 1 < argc) {
+      if (!parseCount(argv[++i], 0, vkr::maxLightCount,
+                      config.settings.lightCount)) {
+        std::cerr << "Invalid light count: " << argv[i] << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if ("--bench-lights" == option) {
+      config.lightBenchmark = true;
+    } else if ("--shadows" == option) {
+      config.settings.shadows = true;
+    } else if ("--no-shadow-cache" == option) {
+      config.settings.shadowCaching = false;
+    } else if ("--workers" == option && i + 1 < argc) {
+      // Counts the render thread, so at least one
+      if (!parseCount(argv[++i], 1, maxWorkerCount, config.workerCount)) {
+        std::cerr << "Invalid worker count: " << argv[i] << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else if ("--record-every-frame" == option) {
+      config.recordEveryFrame = true;
+    } else if ("--no-async-compute" == option) {
+      config.settings.asyncCompute = false;
+    } else if ("--dynamic-resolution" == option) {
+      if (i + 1 >= argc) {
+        std::cerr << "Missing GPU time target for " << option << std::endl;
+        return EXIT_FAILURE;
+      }
+      // Milliseconds, the whole argument has to be a positive number
+      char* end = nullptr;
+      float targetGpuTime = std::strtof(argv[++i], &end);
+      if (argv[i] == end || '\0' != *end || !(targetGpuTime > 0.f)) {
+        std::cerr << "Invalid GPU time target: " << argv[i] << std::endl;
+        return EXIT_FAILURE;
+      }
+      config.settings.dynamicResolution = true;
+      config.settings.targetGpuTime = targetGpuTime;
+    } else {
+      std::cerr << "Unknown option: " << option << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
 
   try {
+    vkr::Renderer renderer{config};
     renderer.run();
   } catch (const std::exception& e) {
     std::cerr << e.what() << std::endl;
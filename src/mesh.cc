@@ -0,0 +1,244 @@
+/**
+ * @file mesh.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+namespace std {
+
+template <>
+struct hash<vkr::Vertex> {
+  size_t operator()(vkr::Vertex const& vertex) const {
+    return ((hash<glm::vec3>()(vertex.pos) ^
+             (hash<glm::vec3>()(vertex.color) << 1)) >>
+            1) ^
+           (hash<glm::vec2>()(vertex.texCoord) << 1);
+  }
+};
+
+}  // namespace std
+
+namespace vkr {
+
+const size_t vertexGrainSize = 4096;
+const uint32_t instanceMaterialCount = 4;
+
+VkVertexInputBindingDescription Vertex::getBindingDescription() {
+  VkVertexInputBindingDescription bindingDescription{};
+  bindingDescription.binding = 0;
+  bindingDescription.stride = sizeof(Vertex);
+  bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+  return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 3>
+Vertex::getAttributeDescriptions() {
+  std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+  attributeDescriptions[0].binding = 0;
+  attributeDescriptions[0].location = 0;
+  attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+  attributeDescriptions[0].offset = offsetof(Vertex, pos);
+
+  attributeDescriptions[1].binding = 0;
+  attributeDescriptions[1].location = 1;
+  attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+  attributeDescriptions[1].offset = offsetof(Vertex, color);
+
+  attributeDescriptions[2].binding = 0;
+  attributeDescriptions[2].location = 2;
+  attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+  attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+
+  return attributeDescriptions;
+}
+
+VkVertexInputBindingDescription InstanceData::getBindingDescription() {
+  VkVertexInputBindingDescription bindingDescription{};
+  bindingDescription.binding = 1;
+  bindingDescription.stride = sizeof(InstanceData);
+  bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+  return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 5>
+InstanceData::getAttributeDescriptions() {
+  std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions{};
+  // A mat4 input takes one location per column
+  for (uint32_t i = 0; i < 4; ++i) {
+    attributeDescriptions[i].binding = 1;
+    attributeDescriptions[i].location = 3 + i;
+    attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescriptions[i].offset =
+        static_cast<uint32_t>(offsetof(InstanceData, model) +
+                              i * sizeof(glm::vec4));
+  }
+
+  attributeDescriptions[4].binding = 1;
+  attributeDescriptions[4].location = 7;
+  attributeDescriptions[4].format = VK_FORMAT_R32_UINT;
+  attributeDescriptions[4].offset = offsetof(InstanceData, materialId);
+
+  return attributeDescriptions;
+}
+
+bool Vertex::operator==(const Vertex& other) const {
+  return pos == other.pos && color == other.color && texCoord == other.texCoord;
+}
+
+MeshData loadMesh(const std::string& path, JobSystem& jobSystem) {
+  tinyobj::attrib_t attrib{};
+  std::vector<tinyobj::shape_t> shapes{};
+  std::vector<tinyobj::material_t> materials{};
+  std::string warn{};
+  std::string err{};
+
+  bool result =
+      tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str());
+  if (!result) {
+    throw std::runtime_error(warn + err);
+  }
+
+  MeshData mesh{};
+
+  std::vector<tinyobj::index_t> objIndices{};
+  for (const auto& shape : shapes) {
+    DrawCommand drawCommand{};
+    drawCommand.firstIndex = static_cast<uint32_t>(objIndices.size());
+    drawCommand.indexCount = static_cast<uint32_t>(shape.mesh.indices.size());
+    drawCommand.vertexOffset = 0;
+    mesh.drawCommands.push_back(drawCommand);
+
+    objIndices.insert(objIndices.end(), shape.mesh.indices.begin(),
+                      shape.mesh.indices.end());
+  }
+
+  size_t indexCount = objIndices.size();
+  std::vector<Vertex> expanded(indexCount);
+  std::vector<size_t> hashes(indexCount);
+
+  jobSystem.parallelFor(
+      indexCount, vertexGrainSize, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          const auto& index = objIndices[i];
+          Vertex& vertex = expanded[i];
+          vertex.pos = {attrib.vertices[3 * index.vertex_index + 0],
+                        attrib.vertices[3 * index.vertex_index + 1],
+                        attrib.vertices[3 * index.vertex_index + 2]};
+          vertex.texCoord = {
+              attrib.texcoords[2 * index.texcoord_index + 0],
+              1.f - attrib.texcoords[2 * index.texcoord_index + 1]};
+          vertex.color = {1.f, 1.f, 1.f};
+
+          hashes[i] = std::hash<Vertex>()(vertex);
+        }
+      });
+
+  // Equal vertices share a hash, so every partition deduplicates
+  // independently and the partitions are simply concatenated afterwards
+  size_t partitionCount = jobSystem.getWorkerCount() + 1;
+  std::vector<std::vector<Vertex>> partitionVertices(partitionCount);
+  std::vector<uint32_t> localIndices(indexCount);
+
+  jobSystem.parallelFor(partitionCount, 1, [&](size_t begin, size_t end) {
+    for (size_t p = begin; p < end; ++p) {
+      std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+      auto& vertices = partitionVertices[p];
+
+      for (size_t i = 0; i < indexCount; ++i) {
+        if (hashes[i] % partitionCount != p) {
+          continue;
+        }
+
+        auto inserted = uniqueVertices.try_emplace(
+            expanded[i], static_cast<uint32_t>(vertices.size()));
+        if (inserted.second) {
+          vertices.push_back(expanded[i]);
+        }
+        localIndices[i] = inserted.first->second;
+      }
+    }
+  });
+
+  std::vector<uint32_t> partitionOffsets(partitionCount);
+  for (size_t p = 0; p < partitionCount; ++p) {
+    partitionOffsets[p] = static_cast<uint32_t>(mesh.vertices.size());
+    mesh.vertices.insert(mesh.vertices.end(), partitionVertices[p].begin(),
+                         partitionVertices[p].end());
+  }
+
+  mesh.indices.resize(indexCount);
+  jobSystem.parallelFor(
+      indexCount, vertexGrainSize, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          mesh.indices[i] =
+              partitionOffsets[hashes[i] % partitionCount] + localIndices[i];
+        }
+      });
+
+  return mesh;
+}
+
+glm::vec4 getBoundingSphere(const std::vector<Vertex>& vertices) {
+  if (vertices.empty()) {
+    return glm::vec4(0.f);
+  }
+
+  glm::vec3 min = vertices[0].pos;
+  glm::vec3 max = vertices[0].pos;
+  for (const Vertex& vertex : vertices) {
+    min = glm::min(min, vertex.pos);
+    max = glm::max(max, vertex.pos);
+  }
+
+  glm::vec3 center = (min + max) * .5f;
+  float radius = 0.f;
+  for (const Vertex& vertex : vertices) {
+    radius = std::max(radius, glm::length(vertex.pos - center));
+  }
+
+  return glm::vec4(center, radius);
+}
+
+std::vector<InstanceData> createInstanceGrid(uint32_t count) {
+  uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(count)));
+  float scale = 1.f / static_cast<float>(side);
+
+  std::vector<InstanceData> instances(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t row = i / side;
+    uint32_t column = i % side;
+    glm::vec3 position{-1.f + scale * (2.f * column + 1.f),
+                       -1.f + scale * (2.f * row + 1.f), 0.f};
+
+    instances[i].model = glm::scale(glm::translate(glm::mat4(1.f), position),
+                                    glm::vec3(scale));
+    instances[i].materialId = (row + column) % instanceMaterialCount;
+  }
+
+  return instances;
+}
+
+}  // namespace vkr
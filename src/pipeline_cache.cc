@@ -0,0 +1,140 @@
+/**
+ * @file pipeline_cache.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "pipeline_cache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+
+namespace vkr {
+
+PipelineCache::PipelineCache(VkDevice device, VkPhysicalDevice physicalDevice,
+                             const std::string& path)
+    : device_(device), physicalDevice_(physicalDevice), path_(path) {
+  std::vector<char> data{};
+  std::ifstream file(path_, std::ios::binary);
+  if (file.is_open()) {
+    data.assign(std::istreambuf_iterator<char>(file),
+                std::istreambuf_iterator<char>());
+  }
+
+  if (data.empty()) {
+    status_ = "cold, no cache file";
+  } else if (validateHeader(data)) {
+    warm_ = true;
+    status_ = "warm, " + std::to_string(data.size() / 1024) + " KiB";
+  } else {
+    data.clear();
+  }
+
+  VkPipelineCacheCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  createInfo.initialDataSize = data.size();
+  createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+  VkResult result =
+      vkCreatePipelineCache(device_, &createInfo, nullptr, &pipelineCache_);
+  if (VK_SUCCESS != result && warm_) {
+    // Headers can match while the payload is still unusable
+    warm_ = false;
+    status_ = "cold, rejected by the driver";
+    createInfo.initialDataSize = 0;
+    createInfo.pInitialData = nullptr;
+    result =
+        vkCreatePipelineCache(device_, &createInfo, nullptr, &pipelineCache_);
+  }
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to create pipeline cache!");
+  }
+}
+
+PipelineCache::~PipelineCache() {
+  vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
+}
+
+VkPipelineCache PipelineCache::get() const { return this->pipelineCache_; }
+
+bool PipelineCache::isWarm() const { return this->warm_; }
+
+const std::string& PipelineCache::getStatus() const { return this->status_; }
+
+bool PipelineCache::save() const {
+  size_t size = 0;
+  VkResult result =
+      vkGetPipelineCacheData(device_, pipelineCache_, &size, nullptr);
+  if (VK_SUCCESS != result || 0 == size) {
+    return false;
+  }
+
+  std::vector<char> data(size);
+  result = vkGetPipelineCacheData(device_, pipelineCache_, &size, data.data());
+  if (VK_SUCCESS != result) {
+    return false;
+  }
+
+  std::string tempPath = path_ + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(size));
+    file.close();
+    if (!file) {
+      std::error_code error{};
+      std::filesystem::remove(tempPath, error);
+      return false;
+    }
+  }
+
+  // Replaces the old file in one step on every platform
+  std::error_code error{};
+  std::filesystem::rename(tempPath, path_, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+
+  return true;
+}
+
+bool PipelineCache::validateHeader(const std::vector<char>& data) {
+  VkPipelineCacheHeaderVersionOne header{};
+  if (data.size() < sizeof(header)) {
+    status_ = "cold, truncated cache file";
+    return false;
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
+
+  if (header.headerSize < sizeof(header) || header.headerSize > data.size() ||
+      VK_PIPELINE_CACHE_HEADER_VERSION_ONE != header.headerVersion) {
+    status_ = "cold, unknown header";
+    return false;
+  }
+  if (header.vendorID != properties.vendorID ||
+      header.deviceID != properties.deviceID) {
+    status_ = "cold, cache from another device";
+    return false;
+  }
+  if (0 != std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+                       VK_UUID_SIZE)) {
+    status_ = "cold, cache from another driver";
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace vkr
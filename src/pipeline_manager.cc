@@ -0,0 +1,719 @@
+/**
+ * @file pipeline_manager.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "pipeline_manager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "embedded_shaders.h"
+
+namespace vkr {
+
+namespace {
+
+// FNV-1a, fed field by field so struct padding never reaches the hash
+class Hasher {
+ public:
+  template <typename T>
+  void add(const T& value) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+    for (size_t i = 0; i < sizeof(T); ++i) {
+      hash_ = (hash_ ^ bytes[i]) * 1099511628211ull;
+    }
+  }
+
+  void add(const std::string& value) {
+    add(value.size());
+    for (char c : value) {
+      add(c);
+    }
+  }
+
+  uint64_t get() const { return hash_; }
+
+ private:
+  uint64_t hash_ = 14695981039346656037ull;
+};
+
+void addCompatibility(Hasher& hasher, const PipelineState& state) {
+  for (const auto& binding : state.vertexBindings) {
+    hasher.add(binding.binding);
+    hasher.add(binding.stride);
+    hasher.add(binding.inputRate);
+  }
+  for (const auto& attribute : state.vertexAttributes) {
+    hasher.add(attribute.location);
+    hasher.add(attribute.binding);
+    hasher.add(attribute.format);
+    hasher.add(attribute.offset);
+  }
+  // A depth pre-pass leaves nothing for a fallback with another depth test
+  hasher.add(state.depthWrite);
+  hasher.add(state.depthCompareOp);
+  hasher.add(state.samples);
+  hasher.add(state.colorFormat);
+  hasher.add(state.depthFormat);
+  hasher.add(state.renderPass);
+  hasher.add(state.layout);
+}
+
+// Same fields as addCompatibility()
+bool isCompatible(const PipelineState& lhs, const PipelineState& rhs) {
+  return std::equal(lhs.vertexBindings.begin(), lhs.vertexBindings.end(),
+                    rhs.vertexBindings.begin(), rhs.vertexBindings.end(),
+                    [](const VkVertexInputBindingDescription& a,
+                       const VkVertexInputBindingDescription& b) {
+                      return a.binding == b.binding && a.stride == b.stride &&
+                             a.inputRate == b.inputRate;
+                    }) &&
+         std::equal(lhs.vertexAttributes.begin(), lhs.vertexAttributes.end(),
+                    rhs.vertexAttributes.begin(), rhs.vertexAttributes.end(),
+                    [](const VkVertexInputAttributeDescription& a,
+                       const VkVertexInputAttributeDescription& b) {
+                      return a.location == b.location &&
+                             a.binding == b.binding && a.format == b.format &&
+                             a.offset == b.offset;
+                    }) &&
+         lhs.depthWrite == rhs.depthWrite &&
+         lhs.depthCompareOp == rhs.depthCompareOp &&
+         lhs.samples == rhs.samples && lhs.colorFormat == rhs.colorFormat &&
+         lhs.depthFormat == rhs.depthFormat &&
+         lhs.renderPass == rhs.renderPass && lhs.layout == rhs.layout;
+}
+
+// Same fields as PipelineManager::hash()
+bool isSameState(const PipelineState& lhs, const PipelineState& rhs) {
+  return isCompatible(lhs, rhs) && lhs.vertexShader == rhs.vertexShader &&
+         lhs.fragmentShader == rhs.fragmentShader &&
+         lhs.specialization == rhs.specialization &&
+         lhs.topology == rhs.topology && lhs.cullMode == rhs.cullMode &&
+         lhs.frontFace == rhs.frontFace && lhs.depthTest == rhs.depthTest &&
+         lhs.depthBiasConstant == rhs.depthBiasConstant &&
+         lhs.depthBiasSlope == rhs.depthBiasSlope &&
+         lhs.blendEnable == rhs.blendEnable &&
+         lhs.srcColorBlendFactor == rhs.srcColorBlendFactor &&
+         lhs.dstColorBlendFactor == rhs.dstColorBlendFactor &&
+         lhs.colorBlendOp == rhs.colorBlendOp &&
+         lhs.srcAlphaBlendFactor == rhs.srcAlphaBlendFactor &&
+         lhs.dstAlphaBlendFactor == rhs.dstAlphaBlendFactor &&
+         lhs.alphaBlendOp == rhs.alphaBlendOp &&
+         lhs.colorWriteMask == rhs.colorWriteMask &&
+         lhs.sampleShading == rhs.sampleShading &&
+         lhs.minSampleShading == rhs.minSampleShading;
+}
+
+bool isSameInterface(const PipelineLayoutInfo& lhs,
+                     const PipelineLayoutInfo& rhs) {
+  return lhs.setLayouts == rhs.setLayouts &&
+         std::equal(lhs.pushConstantRanges.begin(),
+                    lhs.pushConstantRanges.end(),
+                    rhs.pushConstantRanges.begin(),
+                    rhs.pushConstantRanges.end(),
+                    [](const VkPushConstantRange& a,
+                       const VkPushConstantRange& b) {
+                      return a.stageFlags == b.stageFlags &&
+                             a.offset == b.offset && a.size == b.size;
+                    });
+}
+
+std::vector<char> readShader(const std::string& path) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Failed to open file: " + path + "!");
+  }
+
+  size_t fileSize = static_cast<size_t>(file.tellg());
+  std::vector<char> buffer(fileSize);
+  file.seekg(0);
+  file.read(buffer.data(), fileSize);
+
+  return buffer;
+}
+
+}  // namespace
+
+PipelineManager::PipelineManager(VkDevice device,
+                                 VkPipelineCache pipelineCache,
+                                 DescriptorLayoutCache& descriptorLayouts,
+                                 JobSystem& jobSystem, Profiler& profiler)
+    : device_(device),
+      pipelineCache_(pipelineCache),
+      descriptorLayouts_(descriptorLayouts),
+      jobSystem_(jobSystem),
+      profiler_(profiler) {}
+
+PipelineManager::~PipelineManager() {
+  for (auto& entry : this->entries_) {
+    jobSystem_.wait(*entry.second.counter);
+  }
+
+  for (auto& entry : this->entries_) {
+    vkDestroyPipeline(device_, entry.second.pipeline, nullptr);
+  }
+
+  for (auto& pipeline : this->computePipelines_) {
+    vkDestroyPipeline(device_, pipeline.second, nullptr);
+  }
+
+  for (auto& bucket : this->pipelineLayouts_) {
+    for (const PipelineLayoutInfo& info : bucket.second) {
+      vkDestroyPipelineLayout(device_, info.layout, nullptr);
+    }
+  }
+
+  for (auto& shader : this->shaders_) {
+    vkDestroyShaderModule(device_, shader.second.module, nullptr);
+  }
+}
+
+uint64_t PipelineManager::build(const PipelineState& state) {
+  uint64_t key = 0;
+  JobCounter* counter = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    key = findKey(state);
+    auto it = this->entries_.find(key);
+    if (this->entries_.end() == it) {
+      Entry& entry = addEntry(key, state);
+      // Queued under the lock, so a concurrent build() never sees the entry
+      // Pending with nothing counted on it
+      jobSystem_.run(
+          [this, key, &state] {
+            try {
+              finish(key, compile(state), nullptr);
+            } catch (...) {
+              finish(key, VK_NULL_HANDLE, std::current_exception());
+            }
+          },
+          entry.counter.get());
+      counter = entry.counter.get();
+    } else if (Pending == it->second.status) {
+      // Already compiling, so wait for this entry alone
+      counter = it->second.counter.get();
+    } else if (Failed == it->second.status) {
+      std::rethrow_exception(it->second.error);
+    } else {
+      return key;
+    }
+  }
+
+  // Helps with other jobs while waiting, the compile usually runs right here
+  jobSystem_.wait(*counter);
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  const Entry& entry = this->entries_.at(key);
+  if (Failed == entry.status) {
+    std::rethrow_exception(entry.error);
+  }
+
+  return key;
+}
+
+uint64_t PipelineManager::request(const PipelineState& state) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  uint64_t key = findKey(state);
+  if (this->entries_.count(key)) {
+    return key;
+  }
+
+  Entry& entry = addEntry(key, state);
+  jobSystem_.runBackground(
+      [this, key, state] {
+        try {
+          finish(key, compile(state), nullptr);
+        } catch (const std::exception& e) {
+          std::clog << "Pipeline " << state.name << ": " << e.what()
+                    << std::endl;
+          finish(key, VK_NULL_HANDLE, std::current_exception());
+        }
+      },
+      entry.counter.get());
+
+  return key;
+}
+
+VkPipeline PipelineManager::get(uint64_t key) const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  auto it = this->entries_.find(key);
+  if (this->entries_.end() == it) {
+    return VK_NULL_HANDLE;
+  }
+  if (Ready == it->second.status) {
+    return it->second.pipeline;
+  }
+
+  auto fallback = this->fallbacks_.find(it->second.compatibilityKey);
+  if (this->fallbacks_.end() == fallback) {
+    return VK_NULL_HANDLE;
+  }
+  const Entry& entry = this->entries_.at(fallback->second);
+  return isCompatible(entry.state, it->second.state) ? entry.pipeline
+                                                     : VK_NULL_HANDLE;
+}
+
+bool PipelineManager::isReady(uint64_t key) const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  auto it = this->entries_.find(key);
+  return this->entries_.end() != it && Ready == it->second.status;
+}
+
+const PipelineLayoutInfo& PipelineManager::getLayout(
+    const std::string& vertexShader, const std::string& fragmentShader) {
+  std::vector<ShaderReflection> stages{getShader(vertexShader).reflection};
+  if (!fragmentShader.empty()) {
+    stages.push_back(getShader(fragmentShader).reflection);
+  }
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  std::string key = vertexShader + "|" + fragmentShader;
+  auto it = this->layouts_.find(key);
+  if (this->layouts_.end() != it) {
+    return it->second;
+  }
+
+  return createLayout(key, stages);
+}
+
+const PipelineLayoutInfo& PipelineManager::getComputeLayout(
+    const std::string& computeShader) {
+  const Shader& compute = getShader(computeShader);
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  auto it = this->layouts_.find(computeShader);
+  if (this->layouts_.end() != it) {
+    return it->second;
+  }
+
+  return createLayout(computeShader, {compute.reflection});
+}
+
+VkPipeline PipelineManager::getCompute(const std::string& computeShader) {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    auto it = this->computePipelines_.find(computeShader);
+    if (this->computePipelines_.end() != it) {
+      return it->second;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  const Shader& compute = getShader(computeShader);
+  if (VK_SHADER_STAGE_COMPUTE_BIT != compute.reflection.stage) {
+    throw std::runtime_error(computeShader + " is not a compute shader!");
+  }
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = compute.module;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = getComputeLayout(computeShader).layout;
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkResult result = vkCreateComputePipelines(device_, pipelineCache_, 1,
+                                             &pipelineInfo, nullptr, &pipeline);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to create compute pipeline!");
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  profiler_.setTime("Pipeline " + computeShader,
+                    std::chrono::duration<double, std::milli>(end - start)
+                        .count());
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  auto inserted = this->computePipelines_.emplace(computeShader, pipeline);
+  if (!inserted.second) {
+    // Another thread built it first
+    vkDestroyPipeline(device_, pipeline, nullptr);
+  }
+
+  return inserted.first->second;
+}
+
+const PipelineLayoutInfo& PipelineManager::createLayout(
+    const std::string& key, const std::vector<ShaderReflection>& stages) {
+  PipelineLayoutDescription description = mergeReflections(stages);
+
+  PipelineLayoutInfo info{};
+  info.pushConstantRanges = description.pushConstantRanges;
+  for (const auto& bindings : description.sets) {
+    info.setLayouts.push_back(descriptorLayouts_.get(bindings));
+  }
+
+  // Shader pairs with the same interface share one layout, which keeps
+  // their pipelines compatible for descriptor binding
+  Hasher hasher{};
+  for (VkDescriptorSetLayout setLayout : info.setLayouts) {
+    hasher.add(setLayout);
+  }
+  for (const auto& range : info.pushConstantRanges) {
+    hasher.add(range.stageFlags);
+    hasher.add(range.offset);
+    hasher.add(range.size);
+  }
+  uint64_t layoutKey = hasher.get();
+
+  std::vector<PipelineLayoutInfo>& bucket = this->pipelineLayouts_[layoutKey];
+  auto layout = std::find_if(bucket.begin(), bucket.end(),
+                             [&info](const PipelineLayoutInfo& other) {
+                               return isSameInterface(info, other);
+                             });
+  if (bucket.end() != layout) {
+    info.layout = layout->layout;
+  } else {
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount =
+        static_cast<uint32_t>(info.setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = info.setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount =
+        static_cast<uint32_t>(info.pushConstantRanges.size());
+    pipelineLayoutInfo.pPushConstantRanges = info.pushConstantRanges.data();
+
+    VkResult result = vkCreatePipelineLayout(device_, &pipelineLayoutInfo,
+                                             nullptr, &info.layout);
+    if (VK_SUCCESS != result) {
+      throw std::runtime_error("Failed to create pipeline layout!");
+    }
+    bucket.push_back(info);
+  }
+
+  return this->layouts_.emplace(key, std::move(info)).first->second;
+}
+
+uint64_t PipelineManager::getVersion() const { return this->version_; }
+
+uint32_t PipelineManager::getPipelineCount() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  uint32_t count = 0;
+  for (const auto& entry : this->entries_) {
+    count += Ready == entry.second.status ? 1 : 0;
+  }
+
+  return count;
+}
+
+uint32_t PipelineManager::getPendingCount() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  uint32_t count = 0;
+  for (const auto& entry : this->entries_) {
+    count += Pending == entry.second.status ? 1 : 0;
+  }
+
+  return count;
+}
+
+uint64_t PipelineManager::hash(const PipelineState& state) {
+  Hasher hasher{};
+  addCompatibility(hasher, state);
+  hasher.add(state.vertexShader);
+  hasher.add(state.fragmentShader);
+  hasher.add(state.specialization.size());
+  for (uint32_t value : state.specialization) {
+    hasher.add(value);
+  }
+  hasher.add(state.topology);
+  hasher.add(state.cullMode);
+  hasher.add(state.frontFace);
+  hasher.add(state.depthTest);
+  hasher.add(state.depthBiasConstant);
+  hasher.add(state.depthBiasSlope);
+  hasher.add(state.blendEnable);
+  hasher.add(state.srcColorBlendFactor);
+  hasher.add(state.dstColorBlendFactor);
+  hasher.add(state.colorBlendOp);
+  hasher.add(state.srcAlphaBlendFactor);
+  hasher.add(state.dstAlphaBlendFactor);
+  hasher.add(state.alphaBlendOp);
+  hasher.add(state.colorWriteMask);
+  hasher.add(state.sampleShading);
+  hasher.add(state.minSampleShading);
+
+  return hasher.get();
+}
+
+uint64_t PipelineManager::hashCompatibility(const PipelineState& state) {
+  Hasher hasher{};
+  addCompatibility(hasher, state);
+
+  return hasher.get();
+}
+
+VkPipeline PipelineManager::compile(const PipelineState& state) {
+  auto start = std::chrono::steady_clock::now();
+
+  // Constants a stage does not declare are ignored by the driver
+  std::vector<VkSpecializationMapEntry> mapEntries(state.specialization.size());
+  for (uint32_t i = 0; i < mapEntries.size(); ++i) {
+    mapEntries[i].constantID = i;
+    mapEntries[i].offset = i * sizeof(uint32_t);
+    mapEntries[i].size = sizeof(uint32_t);
+  }
+
+  VkSpecializationInfo specializationInfo{};
+  specializationInfo.mapEntryCount = static_cast<uint32_t>(mapEntries.size());
+  specializationInfo.pMapEntries = mapEntries.data();
+  specializationInfo.dataSize = state.specialization.size() * sizeof(uint32_t);
+  specializationInfo.pData = state.specialization.data();
+
+  const Shader& vertexShader = getShader(state.vertexShader);
+  validateVertexInputs(vertexShader.reflection, state.vertexAttributes,
+                       state.vertexShader);
+
+  VkPipelineLayout layout = state.layout;
+  if (VK_NULL_HANDLE == layout) {
+    layout = getLayout(state.vertexShader, state.fragmentShader).layout;
+  }
+
+  VkPipelineShaderStageCreateInfo shaderStages[2]{};
+  shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  shaderStages[0].module = vertexShader.module;
+  shaderStages[0].pName = "main";
+  uint32_t stageCount = 1;
+  if (!state.fragmentShader.empty()) {
+    shaderStages[1].sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = getShader(state.fragmentShader).module;
+    shaderStages[1].pName = "main";
+    stageCount = 2;
+  }
+  if (!mapEntries.empty()) {
+    shaderStages[0].pSpecializationInfo = &specializationInfo;
+    shaderStages[1].pSpecializationInfo = &specializationInfo;
+  }
+
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+  vertexInputInfo.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInputInfo.vertexBindingDescriptionCount =
+      static_cast<uint32_t>(state.vertexBindings.size());
+  vertexInputInfo.pVertexBindingDescriptions = state.vertexBindings.data();
+  vertexInputInfo.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(state.vertexAttributes.size());
+  vertexInputInfo.pVertexAttributeDescriptions = state.vertexAttributes.data();
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+  inputAssembly.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = state.topology;
+  inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer{};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.f;
+  rasterizer.cullMode = state.cullMode;
+  rasterizer.frontFace = state.frontFace;
+  rasterizer.depthBiasEnable =
+      0.f != state.depthBiasConstant || 0.f != state.depthBiasSlope;
+  rasterizer.depthBiasConstantFactor = state.depthBiasConstant;
+  rasterizer.depthBiasSlopeFactor = state.depthBiasSlope;
+
+  VkPipelineMultisampleStateCreateInfo multisampling{};
+  multisampling.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.rasterizationSamples = state.samples;
+  multisampling.sampleShadingEnable = state.sampleShading;
+  multisampling.minSampleShading = state.minSampleShading;
+  multisampling.pSampleMask = nullptr;
+  multisampling.alphaToCoverageEnable = VK_FALSE;
+  multisampling.alphaToOneEnable = VK_FALSE;
+
+  VkPipelineDepthStencilStateCreateInfo depthStencil{};
+  depthStencil.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencil.depthTestEnable = state.depthTest;
+  depthStencil.depthWriteEnable = state.depthWrite;
+  depthStencil.depthCompareOp = state.depthCompareOp;
+  depthStencil.depthBoundsTestEnable = VK_FALSE;
+  depthStencil.minDepthBounds = 0.f;
+  depthStencil.maxDepthBounds = 1.f;
+  depthStencil.stencilTestEnable = VK_FALSE;
+
+  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+  colorBlendAttachment.colorWriteMask = state.colorWriteMask;
+  colorBlendAttachment.blendEnable = state.blendEnable;
+  colorBlendAttachment.srcColorBlendFactor = state.srcColorBlendFactor;
+  colorBlendAttachment.dstColorBlendFactor = state.dstColorBlendFactor;
+  colorBlendAttachment.colorBlendOp = state.colorBlendOp;
+  colorBlendAttachment.srcAlphaBlendFactor = state.srcAlphaBlendFactor;
+  colorBlendAttachment.dstAlphaBlendFactor = state.dstAlphaBlendFactor;
+  colorBlendAttachment.alphaBlendOp = state.alphaBlendOp;
+
+  VkPipelineColorBlendStateCreateInfo colorBlending{};
+  colorBlending.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.logicOpEnable = VK_FALSE;
+  colorBlending.logicOp = VK_LOGIC_OP_COPY;
+  colorBlending.attachmentCount =
+      VK_FORMAT_UNDEFINED == state.colorFormat ? 0 : 1;
+  colorBlending.pAttachments = &colorBlendAttachment;
+
+  std::vector<VkDynamicState> dynamicStates{VK_DYNAMIC_STATE_VIEWPORT,
+                                            VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamicState{};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+  dynamicState.pDynamicStates = dynamicStates.data();
+
+  VkPipelineViewportStateCreateInfo viewportState{};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.scissorCount = 1;
+
+  VkPipelineRenderingCreateInfoKHR renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+  renderingInfo.colorAttachmentCount = colorBlending.attachmentCount;
+  renderingInfo.pColorAttachmentFormats = &state.colorFormat;
+  renderingInfo.depthAttachmentFormat = state.depthFormat;
+  renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+  VkGraphicsPipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  if (VK_NULL_HANDLE == state.renderPass) {
+    pipelineInfo.pNext = &renderingInfo;
+  }
+  pipelineInfo.stageCount = stageCount;
+  pipelineInfo.pStages = shaderStages;
+  pipelineInfo.pVertexInputState = &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pDepthStencilState = &depthStencil;
+  pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.layout = layout;
+  pipelineInfo.renderPass = state.renderPass;
+  pipelineInfo.subpass = 0;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+  pipelineInfo.basePipelineIndex = -1;
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkResult result = vkCreateGraphicsPipelines(
+      device_, pipelineCache_, 1, &pipelineInfo, nullptr, &pipeline);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to create graphics pipeline!");
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  profiler_.setTime("Pipeline " + state.name,
+                    std::chrono::duration<double, std::milli>(end - start)
+                        .count());
+
+  return pipeline;
+}
+
+uint64_t PipelineManager::findKey(const PipelineState& state) const {
+  uint64_t key = hash(state);
+  for (auto it = this->entries_.find(key);
+       this->entries_.end() != it && !isSameState(it->second.state, state);
+       it = this->entries_.find(key)) {
+    ++key;
+  }
+
+  return key;
+}
+
+PipelineManager::Entry& PipelineManager::addEntry(uint64_t key,
+                                                  const PipelineState& state) {
+  Entry& entry = this->entries_[key];
+  entry.state = state;
+  entry.compatibilityKey = hashCompatibility(state);
+  entry.status = Pending;
+  entry.pipeline = VK_NULL_HANDLE;
+  entry.counter = std::make_unique<JobCounter>();
+
+  return entry;
+}
+
+void PipelineManager::finish(uint64_t key, VkPipeline pipeline,
+                             std::exception_ptr error) {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    Entry& entry = this->entries_.at(key);
+    entry.status = VK_NULL_HANDLE == pipeline ? Failed : Ready;
+    entry.pipeline = pipeline;
+    entry.error = error;
+    if (pipeline) {
+      this->fallbacks_.emplace(entry.compatibilityKey, key);
+    }
+  }
+
+  ++this->version_;
+}
+
+const PipelineManager::Shader& PipelineManager::getShader(
+    const std::string& path) {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    auto it = this->shaders_.find(path);
+    if (this->shaders_.end() != it) {
+      return it->second;
+    }
+  }
+
+  // Loaded without the lock so background compiles do not queue behind
+  // file I/O and module creation
+  std::vector<uint32_t> words{};
+  if (const EmbeddedShader* embedded = findEmbeddedShader(path)) {
+    words.assign(embedded->code, embedded->code + embedded->wordCount);
+  } else {
+    std::vector<char> code = readShader(path);
+    if (code.empty() || 0 != code.size() % sizeof(uint32_t)) {
+      throw std::runtime_error("Invalid SPIR-V file: " + path + "!");
+    }
+
+    // Copied into words, the file buffer has no alignment guarantee
+    words.resize(code.size() / sizeof(uint32_t));
+    std::memcpy(words.data(), code.data(), code.size());
+  }
+
+  Shader shader{};
+  shader.reflection = reflectShader(words.data(), words.size());
+
+  VkShaderModuleCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = words.size() * sizeof(uint32_t);
+  createInfo.pCode = words.data();
+
+  VkResult result =
+      vkCreateShaderModule(device_, &createInfo, nullptr, &shader.module);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to create shader module!");
+  }
+
+  VkShaderModule module = shader.module;
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  auto inserted = this->shaders_.emplace(path, std::move(shader));
+  if (!inserted.second) {
+    // Another thread loaded it first
+    vkDestroyShaderModule(device_, module, nullptr);
+  }
+
+  return inserted.first->second;
+}
+
+}  // namespace vkr
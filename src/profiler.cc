@@ -0,0 +1,52 @@
+/**
+ * @file profiler.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "profiler.h"
+
+namespace vkr {
+
+void Profiler::setTime(const std::string& name, double milliseconds) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  ProfilerEntry& entry = findOrAdd(name, true);
+  entry.value = entry.value > 0.0
+                    ? 0.9 * entry.value + 0.1 * milliseconds
+                    : milliseconds;
+}
+
+void Profiler::setCounter(const std::string& name, uint64_t count) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  ProfilerEntry& entry = findOrAdd(name, false);
+  entry.value = static_cast<double>(count);
+}
+
+void Profiler::setText(const std::string& name, const std::string& text) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  ProfilerEntry& entry = findOrAdd(name, false);
+  entry.text = text;
+}
+
+std::vector<ProfilerEntry> Profiler::getEntries() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->entries_;
+}
+
+ProfilerEntry& Profiler::findOrAdd(const std::string& name, bool isTime) {
+  for (auto& entry : this->entries_) {
+    if (entry.name == name) {
+      return entry;
+    }
+  }
+
+  this->entries_.push_back({name, 0.0, isTime, {}});
+  return this->entries_.back();
+}
+
+}  // namespace vkr
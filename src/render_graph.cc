@@ -0,0 +1,1053 @@
+/**
+ * @file render_graph.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "render_graph.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace vkr {
+
+namespace {
+
+const uint32_t unusedPass = std::numeric_limits<uint32_t>::max();
+const uint32_t noBatch = std::numeric_limits<uint32_t>::max();
+
+struct UsageInfo {
+  VkPipelineStageFlags2 stage;
+  VkAccessFlags2 readAccess;
+  VkAccessFlags2 writeAccess;
+  VkImageLayout layout;
+  VkImageUsageFlags imageUsage;
+};
+
+UsageInfo getUsageInfo(RenderGraph::Usage usage) {
+  switch (usage) {
+    case RenderGraph::ColorAttachment:
+      return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+              VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT,
+              VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+    case RenderGraph::DepthAttachment:
+      return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                  VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+              VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+              VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+              VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+    case RenderGraph::DepthRead:
+      return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                  VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+              VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, 0,
+              VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+    case RenderGraph::SampledFragment:
+      return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+              VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, 0,
+              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+              VK_IMAGE_USAGE_SAMPLED_BIT};
+    case RenderGraph::SampledCompute:
+      return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+              VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, 0,
+              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+              VK_IMAGE_USAGE_SAMPLED_BIT};
+    case RenderGraph::StorageReadCompute:
+      return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+              VK_ACCESS_2_SHADER_STORAGE_READ_BIT, 0, VK_IMAGE_LAYOUT_GENERAL,
+              VK_IMAGE_USAGE_STORAGE_BIT};
+    case RenderGraph::StorageWriteCompute:
+      return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+              VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+              VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+              VK_IMAGE_USAGE_STORAGE_BIT};
+    case RenderGraph::StorageReadGraphics:
+      return {VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+                  VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+              VK_ACCESS_2_SHADER_STORAGE_READ_BIT, 0, VK_IMAGE_LAYOUT_GENERAL,
+              VK_IMAGE_USAGE_STORAGE_BIT};
+    case RenderGraph::TransferSrc:
+      return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+              VK_ACCESS_2_TRANSFER_READ_BIT, 0,
+              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+              VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+    case RenderGraph::TransferDst:
+      return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, 0,
+              VK_ACCESS_2_TRANSFER_WRITE_BIT,
+              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+              VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+    case RenderGraph::IndirectRead:
+      return {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+              VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, 0,
+              VK_IMAGE_LAYOUT_UNDEFINED, 0};
+  }
+
+  throw std::invalid_argument("Unknown render graph usage!");
+}
+
+const char* getLayoutName(VkImageLayout layout) {
+  switch (layout) {
+    case VK_IMAGE_LAYOUT_UNDEFINED:
+      return "UNDEFINED";
+    case VK_IMAGE_LAYOUT_GENERAL:
+      return "GENERAL";
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+      return "COLOR_ATTACHMENT";
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+      return "DEPTH_STENCIL_ATTACHMENT";
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+      return "DEPTH_STENCIL_READ_ONLY";
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+      return "SHADER_READ_ONLY";
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+      return "TRANSFER_SRC";
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+      return "TRANSFER_DST";
+    case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+      return "PRESENT_SRC";
+    default:
+      return "OTHER";
+  }
+}
+
+std::string getStageNames(VkPipelineStageFlags2 stages) {
+  static const std::pair<VkPipelineStageFlags2, const char*> names[] = {
+      {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, "DRAW_INDIRECT"},
+      {VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, "VERTEX_SHADER"},
+      {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT, "EARLY_FRAGMENT_TESTS"},
+      {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, "FRAGMENT_SHADER"},
+      {VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, "LATE_FRAGMENT_TESTS"},
+      {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+       "COLOR_ATTACHMENT_OUTPUT"},
+      {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, "COMPUTE_SHADER"},
+      {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, "TRANSFER"},
+  };
+
+  std::string result{};
+  for (const auto& name : names) {
+    if (stages & name.first) {
+      result += result.empty() ? "" : "|";
+      result += name.second;
+      stages &= ~name.first;
+    }
+  }
+  if (stages) {
+    result += result.empty() ? "OTHER" : "|OTHER";
+  }
+
+  return result.empty() ? "NONE" : result;
+}
+
+}  // namespace
+
+bool RenderGraph::Barriers::empty() const {
+  return images.empty() && buffers.empty() && 0 == srcStage && 0 == dstStage;
+}
+
+RenderGraph::RenderGraph(VkDevice device, VkPhysicalDevice physicalDevice,
+                         PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2)
+    : device_(device),
+      physicalDevice_(physicalDevice),
+      cmdPipelineBarrier2_(cmdPipelineBarrier2) {}
+
+RenderGraph::~RenderGraph() {
+  for (auto& resource : this->resources_) {
+    if (TransientImage == resource.type) {
+      vkDestroyImageView(device_, resource.imageView, nullptr);
+      vkDestroyImage(device_, resource.image, nullptr);
+    }
+  }
+
+  for (auto& block : this->blocks_) {
+    vkFreeMemory(device_, block.memory, nullptr);
+  }
+}
+
+void RenderGraph::setQueueFamilies(uint32_t graphicsFamily,
+                                   uint32_t computeFamily) {
+  this->queueFamilies_[GraphicsQueue] = graphicsFamily;
+  this->queueFamilies_[AsyncComputeQueue] = computeFamily;
+}
+
+uint32_t RenderGraph::importImage(const std::string& name,
+                                  VkImageAspectFlags aspect,
+                                  VkImageLayout initialLayout,
+                                  VkPipelineStageFlags2 initialStage,
+                                  VkImageLayout finalLayout, Queue queue) {
+  Resource resource{};
+  resource.name = name;
+  resource.type = ImportedImage;
+  resource.info.aspect = aspect;
+  resource.initialLayout = initialLayout;
+  resource.finalLayout = finalLayout;
+  resource.initialStage = initialStage;
+  resource.queue = queue;
+  this->resources_.push_back(resource);
+
+  return static_cast<uint32_t>(this->resources_.size() - 1);
+}
+
+uint32_t RenderGraph::importBuffer(const std::string& name,
+                                   VkPipelineStageFlags2 initialStage,
+                                   VkAccessFlags2 initialAccess,
+                                   Queue queue) {
+  Resource resource{};
+  resource.name = name;
+  resource.type = ImportedBuffer;
+  resource.initialStage = initialStage;
+  resource.initialAccess = initialAccess;
+  resource.queue = queue;
+  this->resources_.push_back(resource);
+
+  return static_cast<uint32_t>(this->resources_.size() - 1);
+}
+
+uint32_t RenderGraph::createImage(const std::string& name,
+                                  const RenderGraphImageInfo& info) {
+  Resource resource{};
+  resource.name = name;
+  resource.type = TransientImage;
+  resource.info = info;
+  this->resources_.push_back(resource);
+
+  return static_cast<uint32_t>(this->resources_.size() - 1);
+}
+
+void RenderGraph::setImportedImage(uint32_t resource, VkImage image,
+                                   VkImageView imageView) {
+  this->resources_.at(resource).image = image;
+  this->resources_.at(resource).imageView = imageView;
+}
+
+void RenderGraph::setImportedBuffer(uint32_t resource, VkBuffer buffer) {
+  this->resources_.at(resource).buffer = buffer;
+}
+
+void RenderGraph::markOutput(uint32_t resource) {
+  this->resources_.at(resource).output = true;
+}
+
+uint32_t RenderGraph::addPass(const std::string& name, Record record,
+                              Queue queue) {
+  Pass pass{};
+  pass.name = name;
+  pass.record = std::move(record);
+  pass.queue = queue;
+  this->passes_.push_back(std::move(pass));
+
+  return static_cast<uint32_t>(this->passes_.size() - 1);
+}
+
+void RenderGraph::read(uint32_t pass, uint32_t resource, Usage usage) {
+  addAccess(pass, resource, usage, false);
+}
+
+void RenderGraph::write(uint32_t pass, uint32_t resource, Usage usage) {
+  addAccess(pass, resource, usage, true);
+}
+
+void RenderGraph::addAccess(uint32_t pass, uint32_t resource, Usage usage,
+                            bool write) {
+  if (this->compiled_) {
+    throw std::logic_error("Render graph is already compiled!");
+  }
+
+  UsageInfo info = getUsageInfo(usage);
+  if ((write && !info.writeAccess) || (!write && !info.readAccess)) {
+    throw std::invalid_argument("Unsupported render graph access!");
+  }
+
+  Access access{};
+  access.resource = resource;
+  access.stage = info.stage;
+  access.readAccess = info.readAccess;
+  access.writeAccess = write ? info.writeAccess : 0;
+  access.layout = ImportedBuffer == this->resources_.at(resource).type
+                      ? VK_IMAGE_LAYOUT_UNDEFINED
+                      : info.layout;
+  access.imageUsage = info.imageUsage;
+
+  // One access per resource and pass, so barriers never split a pass
+  for (auto& existing : this->passes_.at(pass).accesses) {
+    if (existing.resource == resource) {
+      if (existing.layout != access.layout) {
+        throw std::invalid_argument("Conflicting layouts in render pass " +
+                                    this->passes_[pass].name + "!");
+      }
+      existing.stage |= access.stage;
+      existing.readAccess |= access.readAccess;
+      existing.writeAccess |= access.writeAccess;
+      existing.imageUsage |= access.imageUsage;
+      return;
+    }
+  }
+
+  this->passes_[pass].accesses.push_back(access);
+}
+
+void RenderGraph::compile() {
+  // Without a family of its own the async queue is the graphics queue, and
+  // the whole graph is one batch
+  uint32_t computeFamily = this->queueFamilies_[AsyncComputeQueue];
+  if (VK_QUEUE_FAMILY_IGNORED == computeFamily ||
+      this->queueFamilies_[GraphicsQueue] == computeFamily) {
+    for (auto& pass : this->passes_) {
+      pass.queue = GraphicsQueue;
+    }
+    for (auto& resource : this->resources_) {
+      resource.queue = GraphicsQueue;
+    }
+  }
+
+  cullPasses();
+  computeLifetimes();
+  allocateTransientImages();
+  buildBarriers();
+
+  this->compiled_ = true;
+}
+
+void RenderGraph::cullPasses() {
+  // Walk backwards: a pass survives if it writes something a surviving pass
+  // or an output needs, and then everything it touches is needed too
+  std::vector<bool> needed(this->resources_.size(), false);
+  for (size_t i = 0; i < this->resources_.size(); ++i) {
+    needed[i] = this->resources_[i].output;
+  }
+
+  for (size_t i = this->passes_.size(); i-- > 0;) {
+    Pass& pass = this->passes_[i];
+    pass.culled = true;
+    for (const auto& access : pass.accesses) {
+      if (access.writeAccess && needed[access.resource]) {
+        pass.culled = false;
+      }
+    }
+
+    if (!pass.culled) {
+      for (const auto& access : pass.accesses) {
+        needed[access.resource] = true;
+      }
+    }
+  }
+}
+
+void RenderGraph::computeLifetimes() {
+  for (auto& resource : this->resources_) {
+    resource.firstPass = unusedPass;
+    resource.lastPass = 0;
+  }
+
+  for (uint32_t i = 0; i < this->passes_.size(); ++i) {
+    if (this->passes_[i].culled) {
+      continue;
+    }
+
+    for (const auto& access : this->passes_[i].accesses) {
+      Resource& resource = this->resources_[access.resource];
+      resource.firstPass = std::min(resource.firstPass, i);
+      resource.lastPass = std::max(resource.lastPass, i);
+      resource.info.usage |= access.imageUsage;
+    }
+  }
+}
+
+void RenderGraph::allocateTransientImages() {
+  const VkImageUsageFlags attachmentUsage =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+      VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+  std::vector<uint32_t> transients{};
+  std::vector<VkMemoryRequirements> requirements(this->resources_.size());
+  for (uint32_t i = 0; i < this->resources_.size(); ++i) {
+    Resource& resource = this->resources_[i];
+    if (TransientImage != resource.type || unusedPass == resource.firstPass) {
+      continue;
+    }
+
+    VkImageUsageFlags usage = resource.info.usage;
+    if (!(usage & ~attachmentUsage)) {
+      usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    }
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = resource.info.extent.width;
+    imageInfo.extent.height = resource.info.extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = resource.info.mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = resource.info.format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.samples = resource.info.samples;
+
+    VkResult result =
+        vkCreateImage(device_, &imageInfo, nullptr, &resource.image);
+    if (VK_SUCCESS != result) {
+      throw std::runtime_error("Failed to create render graph image!");
+    }
+
+    vkGetImageMemoryRequirements(device_, resource.image, &requirements[i]);
+    resource.size = requirements[i].size;
+    transients.push_back(i);
+  }
+
+  // Largest first, each into the first block whose users are all dead by
+  // the time it is born. Every image sits at offset 0 of its block
+  std::stable_sort(transients.begin(), transients.end(),
+                   [this](uint32_t a, uint32_t b) {
+                     return this->resources_[a].size > this->resources_[b].size;
+                   });
+
+  for (uint32_t index : transients) {
+    Resource& resource = this->resources_[index];
+
+    uint32_t blockIndex = 0;
+    for (; blockIndex < this->blocks_.size(); ++blockIndex) {
+      MemoryBlock& block = this->blocks_[blockIndex];
+      if (!(block.memoryTypeBits & requirements[index].memoryTypeBits)) {
+        continue;
+      }
+
+      bool overlaps = false;
+      for (uint32_t other : block.resources) {
+        const Resource& otherResource = this->resources_[other];
+        overlaps |= resource.firstPass <= otherResource.lastPass &&
+                    otherResource.firstPass <= resource.lastPass;
+      }
+      if (!overlaps) {
+        break;
+      }
+    }
+
+    if (blockIndex == this->blocks_.size()) {
+      this->blocks_.push_back(
+          {VK_NULL_HANDLE, 0, requirements[index].memoryTypeBits, {}});
+    }
+
+    MemoryBlock& block = this->blocks_[blockIndex];
+    block.size = std::max(block.size, requirements[index].size);
+    block.memoryTypeBits &= requirements[index].memoryTypeBits;
+    block.resources.push_back(index);
+    resource.block = blockIndex;
+  }
+
+  for (auto& block : this->blocks_) {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = block.size;
+    allocInfo.memoryTypeIndex = findMemoryType(block.memoryTypeBits);
+
+    VkResult result =
+        vkAllocateMemory(device_, &allocInfo, nullptr, &block.memory);
+    if (VK_SUCCESS != result) {
+      throw std::runtime_error("Failed to allocate render graph memory!");
+    }
+
+    for (uint32_t index : block.resources) {
+      Resource& resource = this->resources_[index];
+      vkBindImageMemory(device_, resource.image, block.memory, 0);
+
+      VkImageViewCreateInfo viewInfo{};
+      viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      viewInfo.image = resource.image;
+      viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      viewInfo.format = resource.info.format;
+      viewInfo.subresourceRange.aspectMask = resource.info.aspect;
+      viewInfo.subresourceRange.baseMipLevel = 0;
+      viewInfo.subresourceRange.levelCount = resource.info.mipLevels;
+      viewInfo.subresourceRange.baseArrayLayer = 0;
+      viewInfo.subresourceRange.layerCount = 1;
+
+      result =
+          vkCreateImageView(device_, &viewInfo, nullptr, &resource.imageView);
+      if (VK_SUCCESS != result) {
+        throw std::runtime_error("Failed to create render graph image view!");
+      }
+    }
+  }
+}
+
+void RenderGraph::buildBarriers() {
+  struct State {
+    VkImageLayout layout;
+    VkPipelineStageFlags2 writeStage;  // last write or layout transition
+    VkAccessFlags2 writeAccess;
+    VkPipelineStageFlags2 readStage;     // reads since then
+    VkPipelineStageFlags2 visibleStage;  // reads that already waited on it
+    Queue queue;                         // owner
+    uint32_t batch;                      // last one touching it this frame
+  };
+
+  // Aliased images inherit the hazards of every image in their block on the
+  // same queue. This also covers the previous frame, which used the same
+  // memory. The other queue's are covered by semaphores
+  using PerQueue = std::array<uint32_t, 2>;
+  using StagesPerQueue = std::array<VkPipelineStageFlags2, 2>;
+  std::vector<StagesPerQueue> blockStages(this->blocks_.size(),
+                                          StagesPerQueue{});
+  std::vector<StagesPerQueue> blockAccesses(this->blocks_.size(),
+                                            StagesPerQueue{});
+  std::vector<PerQueue> blockBatches(this->blocks_.size(),
+                                     PerQueue{noBatch, noBatch});
+  for (const auto& pass : this->passes_) {
+    for (const auto& access : pass.accesses) {
+      const Resource& resource = this->resources_[access.resource];
+      if (!pass.culled && TransientImage == resource.type) {
+        blockStages[resource.block][pass.queue] |= access.stage;
+        blockAccesses[resource.block][pass.queue] |= access.writeAccess;
+      }
+    }
+  }
+
+  std::vector<State> states(this->resources_.size());
+  for (size_t i = 0; i < this->resources_.size(); ++i) {
+    const Resource& resource = this->resources_[i];
+    if (TransientImage == resource.type) {
+      // Filled in by the first pass using it
+      states[i] = {VK_IMAGE_LAYOUT_UNDEFINED, 0, 0, 0, 0, GraphicsQueue,
+                   noBatch};
+    } else {
+      states[i] = {resource.initialLayout,
+                   resource.initialStage,
+                   resource.initialAccess,
+                   0,
+                   0,
+                   resource.queue,
+                   noBatch};
+    }
+  }
+
+  // Whether an imported resource comes into the frame with contents to keep
+  auto keepsContents = [](const Resource& resource) {
+    return ImportedImage == resource.type
+               ? VK_IMAGE_LAYOUT_UNDEFINED != resource.initialLayout
+               : 0 != resource.initialAccess;
+  };
+
+  // A queue has waited for every batch of the other one before its mark
+  PerQueue openBatches{noBatch, noBatch};
+  PerQueue waitedBatches{0, 0};
+  auto openBatch = [this, &openBatches](Queue queue) {
+    if (noBatch == openBatches[queue]) {
+      openBatches[queue] = static_cast<uint32_t>(this->batches_.size());
+      this->batches_.push_back({queue, {}, {}, false, {}});
+    }
+    return openBatches[queue];
+  };
+
+  for (uint32_t i = 0; i < this->passes_.size(); ++i) {
+    Pass& pass = this->passes_[i];
+    if (pass.culled) {
+      continue;
+    }
+
+    // Find the other queue's batches this pass depends on, and the ones
+    // that have to release a resource to it
+    Queue other = GraphicsQueue == pass.queue ? AsyncComputeQueue
+                                              : GraphicsQueue;
+    std::vector<uint32_t> releases(pass.accesses.size(), noBatch);
+    uint32_t dependency = noBatch;
+    auto dependOn = [&dependency](uint32_t batch) {
+      if (noBatch == dependency || (noBatch != batch && batch > dependency)) {
+        dependency = batch;
+      }
+    };
+
+    for (size_t j = 0; j < pass.accesses.size(); ++j) {
+      const Resource& resource = this->resources_[pass.accesses[j].resource];
+      const State& state = states[pass.accesses[j].resource];
+      if (TransientImage == resource.type) {
+        dependOn(blockBatches[resource.block][other]);
+        // The previous frame's graphics work may still use the memory
+        if (AsyncComputeQueue == pass.queue &&
+            noBatch == blockBatches[resource.block][pass.queue] &&
+            blockStages[resource.block][GraphicsQueue]) {
+          dependOn(openBatch(GraphicsQueue));
+        }
+        if (noBatch != state.batch && other == state.queue) {
+          releases[j] = state.batch;
+        }
+      } else if (other == state.queue && noBatch != state.batch) {
+        dependOn(state.batch);
+        releases[j] = state.batch;
+      } else if (other == state.queue) {
+        if (keepsContents(resource) || resource.initialStage) {
+          dependOn(openBatch(other));
+        }
+        if (keepsContents(resource)) {
+          releases[j] = openBatch(other);
+        }
+      }
+    }
+
+    if (noBatch != dependency && dependency >= waitedBatches[pass.queue]) {
+      if (dependency == openBatches[other]) {
+        openBatches[other] = noBatch;
+      }
+      openBatches[pass.queue] = noBatch;
+      this->batches_[openBatch(pass.queue)].waits.push_back(dependency);
+      this->batches_[dependency].signaled = true;
+      waitedBatches[pass.queue] = dependency + 1;
+    }
+    pass.batch = openBatch(pass.queue);
+    this->batches_[pass.batch].passes.push_back(i);
+
+    Barriers& barriers = pass.barriers;
+    for (size_t j = 0; j < pass.accesses.size(); ++j) {
+      const Access& access = pass.accesses[j];
+      const Resource& resource = this->resources_[access.resource];
+      State& state = states[access.resource];
+      if (TransientImage == resource.type && noBatch == state.batch) {
+        state = {VK_IMAGE_LAYOUT_UNDEFINED,
+                 blockStages[resource.block][pass.queue],
+                 blockAccesses[resource.block][pass.queue],
+                 0,
+                 0,
+                 pass.queue,
+                 noBatch};
+      }
+
+      bool transition =
+          ImportedBuffer != resource.type && access.layout != state.layout;
+      VkAccessFlags2 dstAccess = access.readAccess | access.writeAccess;
+
+      if (noBatch != releases[j]) {
+        // The release waits for the old queue's work, the acquire makes the
+        // contents visible to this access
+        VkPipelineStageFlags2 srcStage = state.writeStage | state.readStage;
+        uint32_t srcFamily = this->queueFamilies_[state.queue];
+        uint32_t dstFamily = this->queueFamilies_[pass.queue];
+        Barriers& releaseBarriers = this->batches_[releases[j]].endBarriers;
+        if (ImportedBuffer == resource.type) {
+          releaseBarriers.buffers.push_back(
+              {access.resource, srcStage, state.writeAccess,
+               VK_PIPELINE_STAGE_2_NONE, 0, srcFamily, dstFamily});
+          barriers.buffers.push_back({access.resource,
+                                      VK_PIPELINE_STAGE_2_NONE, 0,
+                                      access.stage, dstAccess, srcFamily,
+                                      dstFamily});
+        } else {
+          releaseBarriers.images.push_back(
+              {access.resource, srcStage, state.writeAccess,
+               VK_PIPELINE_STAGE_2_NONE, 0, state.layout, access.layout,
+               srcFamily, dstFamily});
+          barriers.images.push_back({access.resource,
+                                     VK_PIPELINE_STAGE_2_NONE, 0,
+                                     access.stage, dstAccess, state.layout,
+                                     access.layout, srcFamily, dstFamily});
+        }
+
+        state.layout = access.layout;
+        state.writeStage = access.stage;
+        state.writeAccess = access.writeAccess;
+        state.readStage = access.writeAccess ? 0 : access.stage;
+        state.visibleStage = access.stage;
+      } else {
+        if (pass.queue != state.queue) {
+          // Taken over without its contents, after a semaphore wait
+          state = {state.layout, 0, 0, 0, 0, pass.queue, state.batch};
+        }
+
+        if (transition || access.writeAccess) {
+          // Writes and layout changes wait for everything before them
+          VkPipelineStageFlags2 srcStage = state.writeStage | state.readStage;
+          if (transition) {
+            barriers.images.push_back({access.resource, srcStage,
+                                       state.writeAccess, access.stage,
+                                       dstAccess, state.layout,
+                                       access.layout});
+          } else if (srcStage) {
+            barriers.srcStage |= srcStage;
+            barriers.srcAccess |= state.writeAccess;
+            barriers.dstStage |= access.stage;
+            barriers.dstAccess |= dstAccess;
+          }
+
+          state.layout = access.layout;
+          state.writeStage = access.stage;
+          state.writeAccess = access.writeAccess;
+          state.readStage = access.writeAccess ? 0 : access.stage;
+          state.visibleStage = access.writeAccess ? 0 : access.stage;
+        } else {
+          // Reads in the same layout only wait if their stages have not yet
+          if (state.writeStage && (access.stage & ~state.visibleStage)) {
+            barriers.srcStage |= state.writeStage;
+            barriers.srcAccess |= state.writeAccess;
+            barriers.dstStage |= access.stage;
+            barriers.dstAccess |= dstAccess;
+            state.visibleStage |= access.stage;
+          }
+          state.readStage |= access.stage;
+        }
+      }
+
+      state.queue = pass.queue;
+      state.batch = pass.batch;
+      if (TransientImage == resource.type) {
+        blockBatches[resource.block][pass.queue] = pass.batch;
+      }
+    }
+  }
+
+  // The last batch is on the graphics queue and waits for all async work
+  uint32_t lastAsync = noBatch;
+  for (uint32_t i = 0; i < this->batches_.size(); ++i) {
+    if (AsyncComputeQueue == this->batches_[i].queue) {
+      lastAsync = i;
+    }
+  }
+  if (noBatch != lastAsync && lastAsync >= waitedBatches[GraphicsQueue]) {
+    openBatches[GraphicsQueue] = noBatch;
+    this->batches_[openBatch(GraphicsQueue)].waits.push_back(lastAsync);
+    this->batches_[lastAsync].signaled = true;
+  }
+  openBatch(GraphicsQueue);
+
+  uint32_t graphicsFamily = this->queueFamilies_[GraphicsQueue];
+  uint32_t computeFamily = this->queueFamilies_[AsyncComputeQueue];
+  for (size_t i = 0; i < this->resources_.size(); ++i) {
+    const Resource& resource = this->resources_[i];
+    const State& state = states[i];
+    if (TransientImage == resource.type) {
+      continue;
+    }
+
+    uint32_t index = static_cast<uint32_t>(i);
+    VkImageLayout finalLayout =
+        VK_IMAGE_LAYOUT_UNDEFINED != resource.finalLayout
+            ? resource.finalLayout
+            : state.layout;
+    VkPipelineStageFlags2 srcStage = state.writeStage | state.readStage;
+    if (AsyncComputeQueue == resource.queue && GraphicsQueue == state.queue) {
+      throw std::logic_error("Render graph resource " + resource.name +
+                             " must end the frame on the async queue!");
+    } else if (GraphicsQueue == resource.queue &&
+               AsyncComputeQueue == state.queue) {
+      // Handed back for the next frame, where it is expected at initialStage
+      bool keep = ImportedImage == resource.type
+                      ? VK_IMAGE_LAYOUT_UNDEFINED != resource.finalLayout
+                      : 0 != resource.initialAccess;
+      if (!keep) {
+        continue;
+      }
+
+      Barriers& releaseBarriers = this->batches_[state.batch].endBarriers;
+      if (ImportedBuffer == resource.type) {
+        releaseBarriers.buffers.push_back(
+            {index, srcStage, state.writeAccess, VK_PIPELINE_STAGE_2_NONE, 0,
+             computeFamily, graphicsFamily});
+        this->finalBarriers_.buffers.push_back(
+            {index, VK_PIPELINE_STAGE_2_NONE, 0, resource.initialStage,
+             resource.initialAccess, computeFamily, graphicsFamily});
+      } else {
+        releaseBarriers.images.push_back(
+            {index, srcStage, state.writeAccess, VK_PIPELINE_STAGE_2_NONE, 0,
+             state.layout, finalLayout, computeFamily, graphicsFamily});
+        this->finalBarriers_.images.push_back(
+            {index, VK_PIPELINE_STAGE_2_NONE, 0, resource.initialStage,
+             resource.initialAccess, state.layout, finalLayout,
+             computeFamily, graphicsFamily});
+      }
+    } else if (ImportedImage == resource.type &&
+               state.layout != finalLayout) {
+      ImageBarrier barrier{index, srcStage, state.writeAccess,
+                           VK_PIPELINE_STAGE_2_NONE, 0, state.layout,
+                           finalLayout};
+      if (GraphicsQueue == state.queue) {
+        this->finalBarriers_.images.push_back(barrier);
+      } else if (noBatch != state.batch) {
+        this->batches_[state.batch].endBarriers.images.push_back(barrier);
+      } else {
+        throw std::logic_error("Render graph resource " + resource.name +
+                               " is never used on the async queue!");
+      }
+    }
+  }
+}
+
+void RenderGraph::execute(uint32_t batch,
+                          VkCommandBuffer commandBuffer) const {
+  const Batch& current = this->batches_.at(batch);
+  for (uint32_t index : current.passes) {
+    const Pass& pass = this->passes_[index];
+    recordBarriers(commandBuffer, pass.barriers);
+    pass.record(commandBuffer);
+  }
+
+  recordBarriers(commandBuffer, current.endBarriers);
+  if (batch + 1 == this->batches_.size()) {
+    recordBarriers(commandBuffer, this->finalBarriers_);
+  }
+}
+
+uint32_t RenderGraph::getBatchCount() const {
+  return static_cast<uint32_t>(this->batches_.size());
+}
+
+RenderGraph::Queue RenderGraph::getBatchQueue(uint32_t batch) const {
+  return this->batches_.at(batch).queue;
+}
+
+const std::vector<uint32_t>& RenderGraph::getBatchWaits(
+    uint32_t batch) const {
+  return this->batches_.at(batch).waits;
+}
+
+bool RenderGraph::isBatchSignaled(uint32_t batch) const {
+  return this->batches_.at(batch).signaled;
+}
+
+uint32_t RenderGraph::getFirstBatch(uint32_t resource) const {
+  uint32_t firstPass = this->resources_.at(resource).firstPass;
+  if (unusedPass == firstPass) {
+    throw std::invalid_argument("Render graph resource is never used!");
+  }
+
+  return this->passes_[firstPass].batch;
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer,
+                                 const Barriers& barriers) const {
+  if (barriers.empty()) {
+    return;
+  }
+
+  std::vector<VkImageMemoryBarrier2> imageBarriers(barriers.images.size());
+  for (size_t i = 0; i < barriers.images.size(); ++i) {
+    const ImageBarrier& barrier = barriers.images[i];
+    const Resource& resource = this->resources_[barrier.resource];
+
+    VkImageMemoryBarrier2& imageBarrier = imageBarriers[i];
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    imageBarrier.srcStageMask = barrier.srcStage;
+    imageBarrier.srcAccessMask = barrier.srcAccess;
+    imageBarrier.dstStageMask = barrier.dstStage;
+    imageBarrier.dstAccessMask = barrier.dstAccess;
+    imageBarrier.oldLayout = barrier.oldLayout;
+    imageBarrier.newLayout = barrier.newLayout;
+    imageBarrier.srcQueueFamilyIndex = barrier.srcQueueFamily;
+    imageBarrier.dstQueueFamilyIndex = barrier.dstQueueFamily;
+    imageBarrier.image = resource.image;
+    imageBarrier.subresourceRange.aspectMask = resource.info.aspect;
+    imageBarrier.subresourceRange.baseMipLevel = 0;
+    imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    imageBarrier.subresourceRange.baseArrayLayer = 0;
+    imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+  }
+
+  std::vector<VkBufferMemoryBarrier2> bufferBarriers(barriers.buffers.size());
+  for (size_t i = 0; i < barriers.buffers.size(); ++i) {
+    const BufferBarrier& barrier = barriers.buffers[i];
+
+    VkBufferMemoryBarrier2& bufferBarrier = bufferBarriers[i];
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+    bufferBarrier.srcStageMask = barrier.srcStage;
+    bufferBarrier.srcAccessMask = barrier.srcAccess;
+    bufferBarrier.dstStageMask = barrier.dstStage;
+    bufferBarrier.dstAccessMask = barrier.dstAccess;
+    bufferBarrier.srcQueueFamilyIndex = barrier.srcQueueFamily;
+    bufferBarrier.dstQueueFamilyIndex = barrier.dstQueueFamily;
+    bufferBarrier.buffer = this->resources_[barrier.resource].buffer;
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+  }
+
+  VkMemoryBarrier2 memoryBarrier{};
+  memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+  memoryBarrier.srcStageMask = barriers.srcStage;
+  memoryBarrier.srcAccessMask = barriers.srcAccess;
+  memoryBarrier.dstStageMask = barriers.dstStage;
+  memoryBarrier.dstAccessMask = barriers.dstAccess;
+
+  VkDependencyInfo dependencyInfo{};
+  dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+  if (barriers.srcStage || barriers.dstStage) {
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &memoryBarrier;
+  }
+  dependencyInfo.imageMemoryBarrierCount =
+      static_cast<uint32_t>(imageBarriers.size());
+  dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+  dependencyInfo.bufferMemoryBarrierCount =
+      static_cast<uint32_t>(bufferBarriers.size());
+  dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+
+  cmdPipelineBarrier2_(commandBuffer, &dependencyInfo);
+}
+
+void RenderGraph::dump(std::ostream& out) const {
+  out << "Render graph: " << getPassCount() << " passes ("
+      << getCulledPassCount() << " culled), " << getBarrierCount()
+      << " barriers, " << getTransientMemorySize() / 1024 << " KiB transient ("
+      << getUnaliasedMemorySize() / 1024 << " KiB without aliasing)"
+      << std::endl;
+
+  out << "Resources:" << std::endl;
+  for (size_t i = 0; i < this->resources_.size(); ++i) {
+    const Resource& resource = this->resources_[i];
+    out << "\t[" << i << "] " << resource.name;
+    if (ImportedImage == resource.type) {
+      out << " (imported image)";
+    } else if (ImportedBuffer == resource.type) {
+      out << " (imported buffer)";
+    } else if (unusedPass == resource.firstPass) {
+      out << " (unused)";
+    } else {
+      out << " " << resource.info.extent.width << "x"
+          << resource.info.extent.height << " x" << resource.info.samples
+          << ", " << resource.size / 1024 << " KiB, block " << resource.block
+          << ", passes " << resource.firstPass << "-" << resource.lastPass;
+    }
+    out << (resource.output ? ", output" : "") << std::endl;
+  }
+
+  out << "Passes:" << std::endl;
+  for (size_t i = 0; i < this->passes_.size(); ++i) {
+    const Pass& pass = this->passes_[i];
+    out << "\t[" << i << "] " << pass.name;
+    if (pass.culled) {
+      out << " (culled)" << std::endl;
+      continue;
+    }
+
+    out << ", batch " << pass.batch << std::endl;
+    dumpBarriers(out, pass.barriers);
+  }
+
+  out << "Batches:" << std::endl;
+  for (size_t i = 0; i < this->batches_.size(); ++i) {
+    const Batch& batch = this->batches_[i];
+    out << "\t[" << i << "] "
+        << (GraphicsQueue == batch.queue ? "graphics" : "async compute")
+        << ", " << batch.passes.size() << " passes";
+    for (uint32_t wait : batch.waits) {
+      out << ", waits on " << wait;
+    }
+    out << (batch.signaled ? ", signaled" : "") << std::endl;
+    dumpBarriers(out, batch.endBarriers);
+  }
+
+  out << "Final:" << std::endl;
+  dumpBarriers(out, this->finalBarriers_);
+}
+
+void RenderGraph::dumpBarriers(std::ostream& out,
+                               const Barriers& barriers) const {
+  for (const auto& barrier : barriers.images) {
+    out << "\t\timage " << this->resources_[barrier.resource].name << ": "
+        << getLayoutName(barrier.oldLayout) << " -> "
+        << getLayoutName(barrier.newLayout) << ", "
+        << getStageNames(barrier.srcStage) << " -> "
+        << getStageNames(barrier.dstStage);
+    if (barrier.srcQueueFamily != barrier.dstQueueFamily) {
+      out << ", family " << barrier.srcQueueFamily << " -> "
+          << barrier.dstQueueFamily;
+    }
+    out << std::endl;
+  }
+
+  for (const auto& barrier : barriers.buffers) {
+    out << "\t\tbuffer " << this->resources_[barrier.resource].name << ": "
+        << getStageNames(barrier.srcStage) << " -> "
+        << getStageNames(barrier.dstStage) << ", family "
+        << barrier.srcQueueFamily << " -> " << barrier.dstQueueFamily
+        << std::endl;
+  }
+
+  if (barriers.srcStage || barriers.dstStage) {
+    out << "\t\tmemory: " << getStageNames(barriers.srcStage) << " -> "
+        << getStageNames(barriers.dstStage) << std::endl;
+  }
+}
+
+VkImage RenderGraph::getImage(uint32_t resource) const {
+  return this->resources_.at(resource).image;
+}
+
+VkImageView RenderGraph::getImageView(uint32_t resource) const {
+  return this->resources_.at(resource).imageView;
+}
+
+VkBuffer RenderGraph::getBuffer(uint32_t resource) const {
+  return this->resources_.at(resource).buffer;
+}
+
+uint32_t RenderGraph::getPassCount() const {
+  return static_cast<uint32_t>(this->passes_.size());
+}
+
+uint32_t RenderGraph::getCulledPassCount() const {
+  return static_cast<uint32_t>(
+      std::count_if(this->passes_.begin(), this->passes_.end(),
+                    [](const Pass& pass) { return pass.culled; }));
+}
+
+uint32_t RenderGraph::getBarrierCount() const {
+  auto countBarriers = [](const Barriers& barriers) {
+    return static_cast<uint32_t>(barriers.images.size() +
+                                 barriers.buffers.size()) +
+           (barriers.srcStage || barriers.dstStage ? 1 : 0);
+  };
+
+  uint32_t count = countBarriers(this->finalBarriers_);
+  for (const auto& pass : this->passes_) {
+    count += pass.culled ? 0 : countBarriers(pass.barriers);
+  }
+  for (const auto& batch : this->batches_) {
+    count += countBarriers(batch.endBarriers);
+  }
+
+  return count;
+}
+
+VkDeviceSize RenderGraph::getTransientMemorySize() const {
+  VkDeviceSize size = 0;
+  for (const auto& block : this->blocks_) {
+    size += block.size;
+  }
+
+  return size;
+}
+
+VkDeviceSize RenderGraph::getUnaliasedMemorySize() const {
+  VkDeviceSize size = 0;
+  for (const auto& resource : this->resources_) {
+    if (TransientImage == resource.type) {
+      size += resource.size;
+    }
+  }
+
+  return size;
+}
+
+uint32_t RenderGraph::findMemoryType(uint32_t typeBits) const {
+  VkPhysicalDeviceMemoryProperties memProperties{};
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice_, &memProperties);
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+    if (typeBits & (1 << i) && (memProperties.memoryTypes[i].propertyFlags &
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+}  // namespace vkr
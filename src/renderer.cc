@@ -14,48 +14,33 @@
 #include <vulkan/vulkan.h>
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
-#include <fstream>
+#include <cstring>
 #include <iostream>
 #include <limits>
 #include <map>
 #include <optional>
 #include <set>
 #include <stdexcept>
-#include <unordered_map>
+#include <thread>
 #include <vector>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-
 #include "config.h"
 #include "gui.h"
+#include "transform.h"
 #include "window.h"
 
-namespace std {
-
-template <>
-struct hash<vkr::Vertex> {
-  size_t operator()(vkr::Vertex const& vertex) const {
-    return ((hash<glm::vec3>()(vertex.pos) ^
-             (hash<glm::vec3>()(vertex.color) << 1)) >>
-            1) ^
-           (hash<glm::vec2>()(vertex.texCoord) << 1);
-  }
-};
-
-}  // namespace std
-
 namespace vkr {
 
 #ifdef __APPLE__
@@ -76,45 +61,89 @@ const bool enableValidationLayers = true;
 
 const std::vector<const char*> validationLayers{"VK_LAYER_KHRONOS_validation"};
 
-VkVertexInputBindingDescription Vertex::getBindingDescription() {
-  VkVertexInputBindingDescription bindingDescription{};
-  bindingDescription.binding = 0;
-  bindingDescription.stride = sizeof(Vertex);
-  bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-  return bindingDescription;
-}
-
-std::array<VkVertexInputAttributeDescription, 3>
-Vertex::getAttributeDescriptions() {
-  std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-  attributeDescriptions[0].binding = 0;
-  attributeDescriptions[0].location = 0;
-  attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-  attributeDescriptions[1].binding = 0;
-  attributeDescriptions[1].location = 1;
-  attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-  attributeDescriptions[2].binding = 0;
-  attributeDescriptions[2].location = 2;
-  attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-  attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-  return attributeDescriptions;
+const std::vector<const char*> presentWaitExtensions{
+    VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME};
+
+// Bounded so a hidden or occluded window cannot stall the render thread
+const uint64_t presentWaitTimeout = 100000000;
+
+const std::string sceneVertexShader = "shader.vert";
+const std::string sceneFragmentShader = "shader.frag";
+const std::string depthVertexShader = "depth.vert";
+const std::string upscaleVertexShader = "upscale.vert";
+const std::string upscaleFragmentShader = "upscale.frag";
+const std::string cullingShader = "cull.comp";
+const std::string occlusionCullingShader = "cull_occlusion.comp";
+const std::string hizShader = "hiz.comp";
+const std::string hizMultisampledShader = "hiz_ms.comp";
+const std::string fxaaShader = "fxaa.comp";
+const std::string taaShader = "taa.comp";
+const std::string lightBinningShader = "light_binning.comp";
+const uint32_t hizGroupSize = 8;
+const uint32_t cullingGroupSize = 64;
+const uint32_t antiAliasingGroupSize = 8;
+const uint32_t lightBinningGroupSize = 64;
+// Start and end of the light binning pass, of every shadow cascade, then
+// of every render graph batch. Each is reset by the queue that writes it
+const uint32_t firstShadowTimestamp = 2;
+const uint32_t firstBatchTimestamp =
+    firstShadowTimestamp + 2 * shadowCascadeCount;
+// Submissions a frame may split into, each with its own queries
+const uint32_t maxFrameBatches = 8;
+const uint32_t timestampsPerFrame = firstBatchTimestamp + 2 * maxFrameBatches;
+// Depth bias of the shadow pass, against acne on surfaces facing the sun
+const float shadowDepthBias = 1.25f;
+const float shadowSlopeBias = 1.75f;
+
+// Halton (2, 3) points centered on the pixel, one per frame in turn
+const glm::vec2 taaJitter[] = {
+    {0.f, -1.f / 6.f},        {-1.f / 4.f, 1.f / 6.f},
+    {1.f / 4.f, -7.f / 18.f}, {-3.f / 8.f, -1.f / 18.f},
+    {1.f / 8.f, 5.f / 18.f},  {-1.f / 8.f, -5.f / 18.f},
+    {3.f / 8.f, 1.f / 18.f},  {-7.f / 16.f, 7.f / 18.f},
+};
+// Weight of the new frame, so the history averages about ten of them
+const float taaBlend = .1f;
+
+// Results come back in bit order: vertex, then fragment invocations
+const VkQueryPipelineStatisticFlags sceneStatistics =
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+// Sorted instance indices to runs of consecutive ones
+void buildInstanceRuns(const std::vector<uint32_t>& instances,
+                       std::vector<InstanceRun>& runs) {
+  runs.clear();
+  for (uint32_t instance : instances) {
+    if (!runs.empty() && runs.back().first + runs.back().count == instance) {
+      ++runs.back().count;
+    } else {
+      runs.push_back({instance, 1});
+    }
+  }
 }
 
-bool Vertex::operator==(const Vertex& other) const {
-  return pos == other.pos && color == other.color && texCoord == other.texCoord;
+// Towards the sun in scene space, whose up axis is z
+glm::vec3 getSunDirection(const RenderSettings& settings) {
+  float azimuth = glm::radians(settings.sunAzimuth);
+  float elevation = glm::radians(settings.sunElevation);
+  return glm::vec3(std::cos(elevation) * std::cos(azimuth),
+                   std::cos(elevation) * std::sin(azimuth),
+                   std::sin(elevation));
 }
 
 bool QueueFamilyIndices::isComplete() {
   return graphicsFamily.has_value() && presentFamily.has_value();
 }
 
-Renderer::Renderer() {
+Renderer::Renderer(const RendererConfig& config)
+    : dynamicRendering_(config.dynamicRendering),
+      dumpRenderGraph_(config.dumpRenderGraph),
+      instanceCount_(std::max(config.instanceCount, 1u)),
+      recordEveryFrame_(config.recordEveryFrame),
+      settings_(config.settings),
+      activeSettings_(config.settings),
+      lightBenchmarkRequested_(config.lightBenchmark) {
   WindowConfig windConfig{};
   windConfig.width = VK_RENDERER_WINDOW_WIDTH;
   windConfig.height = VK_RENDERER_WINDOW_HEIGHT;
@@ -122,6 +151,15 @@ Renderer::Renderer() {
   windConfig.user = this;
 
   this->window_ = std::make_unique<Window>(windConfig);
+  this->jobSystem_ = std::make_unique<JobSystem>(
+      config.workerCount ? config.workerCount - 1
+                         : JobSystem::getDefaultWorkerCount());
+
+  int width = 0;
+  int height = 0;
+  this->window_->getFramebufferSize(&width, &height);
+  setFramebufferSize(width, height);
+  this->framebufferResized_ = false;
 
   this->initVulkan();
 
@@ -133,19 +171,41 @@ Renderer::Renderer() {
   QueueFamilyIndices indices = this->findQueueFamilies(this->physicalDevice_);
   guiConfig.queueFamily = indices.graphicsFamily.value();
   guiConfig.queue = this->graphicsQueue_;
-  guiConfig.pipelineCache = VK_NULL_HANDLE;
-  guiConfig.descriptorPool = this->descriptorPool_;
+  guiConfig.pipelineCache = this->pipelineCache_->get();
+  guiConfig.descriptorPool = this->guiDescriptorPool_;
   guiConfig.renderPass = this->renderPass_;
   guiConfig.subpass = 0;
+  guiConfig.useDynamicRendering = this->dynamicRendering_;
+  // The render graph draws the GUI in a pass of its own, at native
+  // resolution and without MSAA
+  guiConfig.pipelineRenderingCreateInfo = this->guiRenderingInfo_;
   guiConfig.minImageCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
   guiConfig.imageCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-  guiConfig.msaaSamples = this->msaaSamples_;
+  guiConfig.msaaSamples =
+      this->dynamicRendering_ ? VK_SAMPLE_COUNT_1_BIT : this->msaaSamples_;
   guiConfig.allocator = nullptr;
   guiConfig.checkVkResultFn = checkVKResult;
+
+  // ImGui builds its pipeline during initialization, and times it alone
   this->gui_ = std::make_unique<GUI>(guiConfig);
+  double guiTime = this->gui_->getPipelineTime();
+  profiler_.setTime("GUI pipeline creation", guiTime);
+  std::clog << "GUI pipeline creation: " << guiTime << " ms ("
+            << (pipelineCache_->isWarm() ? "warm" : "cold") << ")"
+            << std::endl;
+
+  if (config.lightBenchmark) {
+    lightBenchmark_ = std::make_unique<LightBenchmark>(
+        std::to_string(clusterGridX) + "x" + std::to_string(clusterGridY) +
+        "x" + std::to_string(clusterGridZ) + " clusters, " +
+        std::to_string(swapChainExtent_.width) + "x" +
+        std::to_string(swapChainExtent_.height));
+  }
 };
 
 Renderer::~Renderer() {
+  deletionQueue_.flush(std::numeric_limits<uint64_t>::max());
+  renderGraph_.reset();
   cleanupSwapChain();
 
   vkDestroySampler(device_, textureSampler_, nullptr);
@@ -153,32 +213,97 @@ Renderer::~Renderer() {
   vkDestroyImage(device_, textureImage_, nullptr);
   vkFreeMemory(device_, textureImageMemory_, nullptr);
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-    vkDestroyBuffer(device_, uniformBuffers_[i], nullptr);
-    vkFreeMemory(device_, uniformBuffersMemory_[i], nullptr);
+  vkDestroyDescriptorPool(device_, guiDescriptorPool_, nullptr);
+  materialUpdate_.reset();
+  frameDescriptors_.clear();
+  descriptors_.reset();
+
+  vkDestroySampler(device_, upscaleSampler_, nullptr);
+  upscaleUpdate_.reset();
+  fxaaUpdate_.reset();
+  taaUpdate_.reset();
+
+  lightBinningUpdate_.reset();
+  lightingUpdate_.reset();
+  for (size_t i = 0; i < lightingBuffers_.size(); ++i) {
+    vkDestroyBuffer(device_, lightingBuffers_[i], nullptr);
+    vkFreeMemory(device_, lightingBufferMemory_[i], nullptr);
+    vkDestroyBuffer(device_, clusterBuffers_[i], nullptr);
+    vkFreeMemory(device_, clusterBufferMemory_[i], nullptr);
+  }
+
+  vkDestroySampler(device_, shadowSampler_, nullptr);
+  for (VkImageView layerView : shadowLayerViews_) {
+    vkDestroyImageView(device_, layerView, nullptr);
   }
+  vkDestroyImageView(device_, shadowImageView_, nullptr);
+  vkDestroyImage(device_, shadowImage_, nullptr);
+  vkFreeMemory(device_, shadowImageMemory_, nullptr);
+
+  vkDestroySampler(device_, hizSampler_, nullptr);
+  hizUpdate_.reset();
+  occlusionUpdate_.reset();
+  vkDestroyBuffer(device_, visibilityBuffer_, nullptr);
+  vkFreeMemory(device_, visibilityBufferMemory_, nullptr);
+
+  cullingUpdate_.reset();
+  for (size_t i = 0; i < indirectBuffers_.size(); ++i) {
+    vkDestroyBuffer(device_, indirectBuffers_[i], nullptr);
+    vkFreeMemory(device_, indirectBufferMemory_[i], nullptr);
+    vkDestroyBuffer(device_, drawCountBuffers_[i], nullptr);
+    vkFreeMemory(device_, drawCountBufferMemory_[i], nullptr);
+  }
+  vkDestroyBuffer(device_, drawRecordBuffer_, nullptr);
+  vkFreeMemory(device_, drawRecordBufferMemory_, nullptr);
+  vkDestroyBuffer(device_, boundsBuffer_, nullptr);
+  vkFreeMemory(device_, boundsBufferMemory_, nullptr);
 
-  vkDestroyDescriptorPool(device_, descriptorPool_, nullptr);
-  vkDestroyDescriptorSetLayout(device_, descriptorSetLayout_, nullptr);
+  vkDestroyBuffer(device_, instanceBuffer_, nullptr);
+  vkFreeMemory(device_, instanceBufferMemory_, nullptr);
 
   vkDestroyBuffer(device_, indexBuffer_, nullptr);
   vkFreeMemory(device_, indexBufferMemory_, nullptr);
 
+  vkDestroyBuffer(device_, positionBuffer_, nullptr);
+  vkFreeMemory(device_, positionBufferMemory_, nullptr);
+
   vkDestroyBuffer(device_, vertexBuffer_, nullptr);
   vkFreeMemory(device_, vertexBufferMemory_, nullptr);
 
+  vkDestroyQueryPool(device_, statisticsQueryPool_, nullptr);
+  vkDestroyQueryPool(device_, timestampQueryPool_, nullptr);
+
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
     vkDestroySemaphore(device_, imageAvailableSemaphores_[i], nullptr);
     vkDestroySemaphore(device_, renderFinishiedSemephores_[i], nullptr);
     vkDestroyFence(device_, inFlightFences_[i], nullptr);
+    for (VkSemaphore semaphore : batchSemaphores_[i]) {
+      vkDestroySemaphore(device_, semaphore, nullptr);
+    }
+  }
+
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    for (VkCommandPool commandPool : sceneCommandPools_[i]) {
+      vkDestroyCommandPool(device_, commandPool, nullptr);
+    }
+    vkDestroyCommandPool(device_, frameCommandPools_[i], nullptr);
+    if (asyncComputeSupported_) {
+      vkDestroyCommandPool(device_, computeCommandPools_[i], nullptr);
+    }
   }
 
   vkDestroyCommandPool(device_, commandPool_, nullptr);
 
   vkDestroyRenderPass(device_, renderPass_, nullptr);
 
-  vkDestroyPipeline(device_, graphicsPipeline_, nullptr);
-  vkDestroyPipelineLayout(device_, pipelineLayout_, nullptr);
+  pipelines_.reset();
+  descriptorLayouts_.reset();
+
+  if (!pipelineCache_->save()) {
+    std::clog << "Failed to save pipeline cache to "
+              << VK_RENDERER_PIPELINE_CACHE_PATH << std::endl;
+  }
+  pipelineCache_.reset();
 
   vkDestroyDevice(device_, nullptr);
 
@@ -191,51 +316,273 @@ Renderer::~Renderer() {
   vkDestroyInstance(instance_, nullptr);
 }
 
-void Renderer::setFramebufferResized(bool resized) {
-  this->framebufferResized_ = resized;
+void Renderer::setFramebufferSize(int width, int height) {
+  // Called by GLFW on the main thread, read by the render thread
+  this->framebufferSize_ = static_cast<uint64_t>(width) << 32 |
+                           static_cast<uint32_t>(height);
+  this->framebufferResized_ = true;
 }
 
 void Renderer::run() {
-  while (!this->window_->shouldClose()) {
-    glfwPollEvents();
-    drawFrame();
+  this->renderThread_ = std::thread(&Renderer::renderLoop, this);
+
+  while (!this->window_->shouldClose() && !this->stopRendering_) {
+    if (this->snapshots_.isConsumed()) {
+      FrameSnapshot& snapshot = this->snapshots_.getWriteBuffer();
+      updateSimulation(snapshot);
+      this->gui_->buildFrame(snapshot.gui, profiler_, settings_);
+      snapshot.settings = settings_;
+      this->snapshots_.publish();
+    }
+
+    // The render thread posts an empty event after every frame
+    glfwWaitEvents();
   }
 
+  this->stopRendering_ = true;
+  this->renderThread_.join();
+
   vkDeviceWaitIdle(device_);
+
+  if (this->renderException_) {
+    std::rethrow_exception(this->renderException_);
+  }
+}
+
+void Renderer::renderLoop() {
+  try {
+    bool hasSnapshot = false;
+    while (!this->stopRendering_) {
+      // Pace before picking up the snapshot so it carries the latest input
+      if (hasSnapshot) {
+        frameLimiter_.setFrameRate(
+            this->snapshots_.getReadBuffer().settings.frameRateLimit);
+        profiler_.setTime("Frame limiter wait", frameLimiter_.wait());
+      }
+
+      hasSnapshot = this->snapshots_.update() || hasSnapshot;
+      if (!hasSnapshot) {
+        std::this_thread::yield();
+        continue;
+      }
+
+      auto frameStart = std::chrono::steady_clock::now();
+      drawFrame(this->snapshots_.getReadBuffer());
+      auto frameEnd = std::chrono::steady_clock::now();
+      profiler_.setTime(
+          "Render thread frame",
+          std::chrono::duration<double, std::milli>(frameEnd - frameStart)
+              .count());
+
+      glfwPostEmptyEvent();
+    }
+  } catch (...) {
+    this->renderException_ = std::current_exception();
+    this->stopRendering_ = true;
+    glfwPostEmptyEvent();
+  }
+}
+
+void Renderer::updateSimulation(FrameSnapshot& snapshot) {
+  snapshot.model = glm::mat4(1.f);
+  snapshot.view = glm::lookAt(glm::vec3(2.f, 2.f, 2.f),
+                              glm::vec3(0.f, 0.f, 0.f),
+                              glm::vec3(0.f, 0.f, 1.f));
 }
 
 void Renderer::initVulkan() {
+  // Decode assets on the job system while the device is being set up
+  JobCounter assetCounter{};
+  jobSystem_->run([this] { loadModel(); }, &assetCounter);
+  jobSystem_->run([this] { loadTexture(); }, &assetCounter);
+
   createInstance();
   setupDebugMessenger();
   createSurface();
   pickPhysicalDevice();
   createLogicalDevice();
-  createSwapChain();
+  createPipelineCache();
+  createSwapChain(VK_NULL_HANDLE);
   createImageViews();
-  createRenderPass();
-  createDescriptorSetLayout();
+  if (dynamicRendering_) {
+    createRenderingInfo();
+  } else {
+    createRenderPass();
+  }
   createGraphicsPipeline();
   createCommandPool();
-  createColorResources();
-  createDepthResources();
+  if (dynamicRendering_) {
+    createRenderGraph();
+  } else {
+    createColorResources();
+    createDepthResources();
+  }
   createFramebuffers();
-  loadModel();
+  jobSystem_->wait(assetCounter);
   createVertexBuffer();
   createIndexBufffer();
-  createUniformBuffers();
+  createInstanceBuffer();
   createTextureImage();
   createTextureImageView();
   createTextureSampler();
   createDescriptorPool();
+  createUpscaleResources();
+  createAntiAliasingResources();
   createDescriptorSets();
+  createShadowResources();
+  createLightingResources();
+  createCullingResources();
   createCommandBuffers();
   createSyncObjects();
+  createQueryPools();
 }
 
-void Renderer::drawFrame() {
+void Renderer::drawFrame(const FrameSnapshot& snapshot) {
+  applySettings(snapshot.settings);
+  waitForPresent();
+
   vkWaitForFences(device_, 1, &inFlightFences_[currentFrame_], VK_TRUE,
                   UINT64_MAX);
 
+  deletionQueue_.flush(getCompletedFrames());
+  profiler_.setCounter("Deferred deletions", deletionQueue_.size());
+
+  // Every set this frame slot handed out is released in one go
+  frameDescriptors_[currentFrame_]->reset();
+
+  // Covers the passes of this slot's last frame, which has completed
+  double gpuTime = 0.0;
+  double binningTime = 0.0;
+  uint32_t batchCount = frameBatchCounts_[currentFrame_];
+  uint32_t asyncBatches = frameAsyncBatches_[currentFrame_];
+  if (queriesRecorded_[currentFrame_] &&
+      VK_NULL_HANDLE != statisticsQueryPool_) {
+    // One query per graphics batch, the async ones draw nothing
+    uint64_t totals[2]{};
+    VkResult result = VK_SUCCESS;
+    for (uint32_t i = 0; i < batchCount && VK_SUCCESS == result; ++i) {
+      if (asyncBatches & (1u << i)) {
+        continue;
+      }
+
+      uint64_t statistics[2]{};
+      result = vkGetQueryPoolResults(
+          device_, statisticsQueryPool_, currentFrame_ * maxFrameBatches + i,
+          1, sizeof(statistics), statistics, sizeof(statistics),
+          VK_QUERY_RESULT_64_BIT);
+      totals[0] += statistics[0];
+      totals[1] += statistics[1];
+    }
+    if (VK_SUCCESS == result) {
+      profiler_.setCounter("Vertex shader invocations", totals[0]);
+      profiler_.setCounter("Fragment shader invocations", totals[1]);
+    }
+  }
+  if (queriesRecorded_[currentFrame_] &&
+      VK_NULL_HANDLE != timestampQueryPool_) {
+    // Only ranges that were written are read. The shadow queries are only
+    // written while the shadow pass runs, and it always renders the near
+    // cascades
+    uint32_t firstQuery = currentFrame_ * timestampsPerFrame;
+    uint64_t timestamps[timestampsPerFrame]{};
+    auto readTimestamps = [&](uint32_t first, uint32_t count) {
+      return VK_SUCCESS ==
+             vkGetQueryPoolResults(device_, timestampQueryPool_,
+                                   firstQuery + first, count,
+                                   sizeof(timestamps[0]) * count,
+                                   timestamps + first, sizeof(timestamps[0]),
+                                   VK_QUERY_RESULT_64_BIT);
+    };
+    uint32_t cascades = frameShadowCascades_[currentFrame_];
+    if (readTimestamps(0, firstShadowTimestamp) &&
+        (!cascades ||
+         readTimestamps(firstShadowTimestamp, 2 * shadowCascadeCount)) &&
+        readTimestamps(firstBatchTimestamp, 2 * batchCount)) {
+      auto getTime = [this](uint64_t start, uint64_t end) {
+        return ((end - start) & timestampMask_) * timestampPeriod_ / 1e6;
+      };
+
+      // Both queues count the same device clock, so the batches line up on
+      // one timeline that starts with the earliest of them
+      const uint64_t* batches = timestamps + firstBatchTimestamp;
+      uint64_t frameStart = batches[0];
+      for (uint32_t i = 1; i < batchCount; ++i) {
+        frameStart = std::min(frameStart, batches[2 * i]);
+      }
+      double starts[maxFrameBatches]{};
+      double ends[maxFrameBatches]{};
+      double asyncTime = 0.0;
+      for (uint32_t i = 0; i < batchCount; ++i) {
+        starts[i] = getTime(frameStart, batches[2 * i]);
+        ends[i] = getTime(frameStart, batches[2 * i + 1]);
+        gpuTime = std::max(gpuTime, ends[i]);
+        if (asyncBatches & (1u << i)) {
+          asyncTime += ends[i] - starts[i];
+        }
+      }
+
+      // Time the async batches ran while graphics work did too
+      double overlap = 0.0;
+      for (uint32_t i = 0; i < batchCount; ++i) {
+        for (uint32_t j = 0; j < batchCount; ++j) {
+          if ((asyncBatches & (1u << i)) && !(asyncBatches & (1u << j))) {
+            overlap += std::max(std::min(ends[i], ends[j]) -
+                                    std::max(starts[i], starts[j]),
+                                0.0);
+          }
+        }
+      }
+
+      profiler_.setTime("GPU frame", gpuTime);
+      // Kept per mode, so switching modes leaves their costs side by side
+      profiler_.setTime("GPU frame, " + frameAntiAliasing_[currentFrame_],
+                        gpuTime);
+      profiler_.setTime("GPU async compute", asyncTime);
+      profiler_.setTime("GPU async overlap", overlap);
+      profiler_.setCounter(
+          "Async compute overlap (%)",
+          0.0 < asyncTime
+              ? static_cast<uint64_t>(overlap / asyncTime * 100.0 + .5)
+              : 0);
+      binningTime = getTime(timestamps[0], timestamps[1]);
+      profiler_.setTime("GPU light binning", binningTime);
+
+      // Cached cascades keep the time of the last frame that rendered them
+      for (uint32_t i = 0; i < shadowCascadeCount; ++i) {
+        if (cascades & (1u << i)) {
+          const uint64_t* cascade = timestamps + firstShadowTimestamp + 2 * i;
+          profiler_.setTime("GPU shadow cascade " + std::to_string(i),
+                            getTime(cascade[0], cascade[1]));
+        }
+      }
+    }
+  }
+  updateRenderExtent(gpuTime);
+  if (lightBenchmark_ && 0.0 < gpuTime &&
+      lightBenchmark_->addFrame(gpuTime, binningTime)) {
+    stopRendering_ = true;
+  }
+
+  // Written by this slot's last culling pass, which has completed. The
+  // layout depends on the pass, and a slot recorded before the culling mode
+  // changed still holds the counts of the old one
+  if (cullingGraph_ && frameGPUCulling_[currentFrame_]) {
+    profiler_.setCounter("GPU culled draws",
+                         drawCounts_[currentFrame_]->drawCount);
+  } else if (occlusionGraph_ && frameOcclusionCulling_[currentFrame_]) {
+    // Every instance is either drawn by one of the phases, rejected by the
+    // pyramid, or outside the frustum
+    const CullingCounts& counts = *drawCounts_[currentFrame_];
+    uint64_t drawn = counts.drawnInstances[0] + counts.drawnInstances[1];
+    uint64_t culled = instances_.size() - drawn;
+    profiler_.setCounter("GPU culled draws", drawn * drawCommands_.size());
+    profiler_.setCounter("Instances drawn early", counts.drawnInstances[0]);
+    profiler_.setCounter("Instances drawn late", counts.drawnInstances[1]);
+    profiler_.setCounter("Instances occluded", counts.occludedInstances);
+    profiler_.setCounter("Instances outside frustum",
+                         culled - counts.occludedInstances);
+  }
+
   uint32_t imageIndex = 0;
   VkResult result = vkAcquireNextImageKHR(
       device_, swapChain_, UINT64_MAX, imageAvailableSemaphores_[currentFrame_],
@@ -249,38 +596,83 @@ void Renderer::drawFrame() {
 
   vkResetFences(device_, 1, &inFlightFences_[currentFrame_]);
 
-  updateUniformBuffer(currentFrame_);
-
-  vkResetCommandBuffer(commandBuffers_[currentFrame_], 0);
-  recordCommandBuffer(commandBuffers_[currentFrame_], imageIndex);
-
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores_[currentFrame_]};
-  VkPipelineStageFlags waitStages[] = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
+  updateTransforms(snapshot);
+  updateShadows(snapshot);
+  updateLighting(snapshot);
 
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffers_[currentFrame_];
+  vkResetCommandPool(device_, frameCommandPools_[currentFrame_], 0);
+  if (asyncComputeSupported_) {
+    vkResetCommandPool(device_, computeCommandPools_[currentFrame_], 0);
+  }
 
-  VkSemaphore signalSemaphores[] = {renderFinishiedSemephores_[currentFrame_]};
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = signalSemaphores;
+  auto recordStart = std::chrono::steady_clock::now();
+  recordCommandBuffers(imageIndex, snapshot);
+  auto recordEnd = std::chrono::steady_clock::now();
+  profiler_.setTime(
+      "Command recording",
+      std::chrono::duration<double, std::milli>(recordEnd - recordStart)
+          .count());
+
+  // One submission per render graph batch, in order, each to its queue.
+  // The acquired image is waited on by the batch that first draws to it,
+  // and the last batch, which waits for all async work, signals the fence
+  batchCount = frameBatchCounts_[currentFrame_];
+  asyncBatches = frameAsyncBatches_[currentFrame_];
+  uint32_t acquireBatch =
+      dynamicRendering_ ? renderGraph_->getFirstBatch(swapChainResource_) : 0;
+  VkSemaphore renderFinishedSemaphore =
+      renderFinishiedSemephores_[currentFrame_];
+  for (uint32_t i = 0; i < batchCount; ++i) {
+    bool async = asyncBatches & (1u << i);
+    bool last = i + 1 == batchCount;
+
+    std::vector<VkSemaphore> waitSemaphores{};
+    std::vector<VkPipelineStageFlags> waitStages{};
+    std::vector<VkSemaphore> signalSemaphores{};
+    if (acquireBatch == i) {
+      waitSemaphores.push_back(imageAvailableSemaphores_[currentFrame_]);
+      waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    }
+    if (dynamicRendering_) {
+      for (uint32_t wait : renderGraph_->getBatchWaits(i)) {
+        waitSemaphores.push_back(getBatchSemaphore(wait));
+        waitStages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+      }
+      if (renderGraph_->isBatchSignaled(i)) {
+        signalSemaphores.push_back(getBatchSemaphore(i));
+      }
+    }
+    if (last) {
+      signalSemaphores.push_back(renderFinishedSemaphore);
+    }
 
-  result = vkQueueSubmit(graphicsQueue_, 1, &submitInfo,
-                         inFlightFences_[currentFrame_]);
-  if (VK_SUCCESS != result) {
-    throw std::runtime_error("Failed to submit draw command buffer!");
+    VkCommandBuffer commandBuffer = getBatchCommandBuffer(i, async);
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount =
+        static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount =
+        static_cast<uint32_t>(signalSemaphores.size());
+    submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+    result = vkQueueSubmit(async ? computeQueue_ : graphicsQueue_, 1,
+                           &submitInfo,
+                           last ? inFlightFences_[currentFrame_]
+                                : VK_NULL_HANDLE);
+    if (VK_SUCCESS != result) {
+      throw std::runtime_error("Failed to submit draw command buffer!");
+    }
   }
+  fenceFrames_[currentFrame_] = submittedFrames_++;
 
   VkPresentInfoKHR presentInfo{};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
   presentInfo.waitSemaphoreCount = 1;
-  presentInfo.pWaitSemaphores = signalSemaphores;
+  presentInfo.pWaitSemaphores = &renderFinishedSemaphore;
 
   VkSwapchainKHR swapChains[] = {swapChain_};
   presentInfo.swapchainCount = 1;
@@ -288,9 +680,20 @@ void Renderer::drawFrame() {
   presentInfo.pImageIndices = &imageIndex;
   presentInfo.pResults = nullptr;
 
+  // Tag every present while supported so pacing can be toggled at any time
+  VkPresentIdKHR presentId{};
+  if (presentWaitSupported_) {
+    ++presentId_;
+    presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    presentId.swapchainCount = 1;
+    presentId.pPresentIds = &presentId_;
+    presentInfo.pNext = &presentId;
+  }
+
   result = vkQueuePresentKHR(presentQueue_, &presentInfo);
+  bool framebufferResized = this->framebufferResized_.exchange(false);
   if (VK_ERROR_OUT_OF_DATE_KHR == result || VK_SUBOPTIMAL_KHR == result ||
-      this->framebufferResized_) {
+      framebufferResized) {
     recreateSwapchain();
   } else if (VK_SUCCESS != result) {
     throw std::runtime_error("Failed to present swap chain image!");
@@ -299,6 +702,254 @@ void Renderer::drawFrame() {
   currentFrame_ = (currentFrame_ + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
+void Renderer::updateRenderExtent(double gpuTime) {
+  if (!scaledGraph_) {
+    resolutionController_.reset();
+  } else {
+    resolutionController_.setTargetTime(activeSettings_.targetGpuTime);
+    if (0.0 < gpuTime) {
+      resolutionController_.update(gpuTime);
+    }
+  }
+
+  float scale = resolutionController_.getScale();
+  VkExtent2D extent{
+      std::max(static_cast<uint32_t>(swapChainExtent_.width * scale), 1u),
+      std::max(static_cast<uint32_t>(swapChainExtent_.height * scale), 1u)};
+  if (extent.width != renderExtent_.width ||
+      extent.height != renderExtent_.height) {
+    // The scene secondaries bake in the viewport, and the history no longer
+    // lines up with the new extent
+    renderExtent_ = extent;
+    invalidateSceneCommands();
+    historyValid_ = false;
+  }
+
+  profiler_.setCounter("Render scale (%)",
+                       static_cast<uint64_t>(scale * 100.f + .5f));
+  profiler_.setText("Render resolution",
+                    std::to_string(renderExtent_.width) + "x" +
+                        std::to_string(renderExtent_.height));
+  profiler_.setText("Resolution controller",
+                    resolutionController_.getStateName());
+}
+
+void Renderer::applySettings(const RenderSettings& settings) {
+  bool presentModeChanged =
+      settings.presentMode != activeSettings_.presentMode;
+  // Alpha-tested fragments would need the fragment shader in the pre-pass,
+  // so the pre-pass is left out while that feature is on
+  bool depthPrepass = settings.depthPrepass &&
+                      !(settings.shaderFeatures & ShaderFeature::AlphaTest);
+  bool depthPrepassChanged = depthPrepass != activeSettings_.depthPrepass;
+  // The post-process modes are render graph passes, and TAA samples the
+  // depth buffer. The legacy backend keeps the sample count it started with
+  AntiAliasing antiAliasing = settings.antiAliasing;
+  if (!dynamicRendering_ ||
+      (AntiAliasing::Taa == antiAliasing && !depthSamplingSupported_)) {
+    antiAliasing = AntiAliasing::Msaa;
+  }
+  VkSampleCountFlagBits samples = msaaSamples_;
+  if (dynamicRendering_) {
+    samples = AntiAliasing::Msaa == antiAliasing
+                  ? getUsableSampleCount(settings.msaaSamples)
+                  : VK_SAMPLE_COUNT_1_BIT;
+  }
+  bool samplesChanged = samples != msaaSamples_;
+  bool pipelineChanged =
+      settings.backfaceCulling != activeSettings_.backfaceCulling ||
+      settings.shaderFeatures != activeSettings_.shaderFeatures ||
+      depthPrepassChanged || samplesChanged;
+  bool drawModeChanged =
+      settings.instancing != activeSettings_.instancing ||
+      (settings.gpuCulling && gpuCullingSupported_) !=
+          activeSettings_.gpuCulling;
+  activeSettings_ = settings;
+  activeSettings_.presentWait = settings.presentWait && presentWaitSupported_;
+  activeSettings_.gpuCulling = settings.gpuCulling && gpuCullingSupported_;
+  activeSettings_.antiAliasing = antiAliasing;
+  activeSettings_.msaaSamples = samples;
+  // The pyramid is built by sampling every sample of the depth buffer
+  bool occlusionSamplesSupported = sampledDepthSampleCounts_ & samples;
+  activeSettings_.occlusionCulling =
+      activeSettings_.gpuCulling && settings.occlusionCulling &&
+      occlusionCullingSupported_ && occlusionSamplesSupported;
+  activeSettings_.depthPrepass = depthPrepass;
+  // The upscale pass is part of the render graph, and the scale follows
+  // the GPU timestamps
+  bool dynamicResolutionSupported =
+      dynamicRendering_ && VK_NULL_HANDLE != timestampQueryPool_;
+  activeSettings_.dynamicResolution =
+      settings.dynamicResolution && dynamicResolutionSupported;
+  // The benchmark sweeps the light count on its own
+  activeSettings_.lightCount =
+      std::min(lightBenchmark_ ? lightBenchmark_->getLightCount()
+                               : settings.lightCount,
+               maxLightCount);
+  activeSettings_.shadows = settings.shadows && shadowsSupported_;
+  activeSettings_.shadowUpdateBudget =
+      std::clamp(settings.shadowUpdateBudget, 1u,
+                 shadowCascadeCount - shadowNearCascadeCount);
+  activeSettings_.asyncCompute =
+      settings.asyncCompute && asyncComputeSupported_;
+
+  if (presentModeChanged) {
+    recreateSwapchain();
+  }
+
+  if (samplesChanged) {
+    msaaSamples_ = samples;
+    inheritanceRenderingInfo_.rasterizationSamples = samples;
+  }
+
+  if (pipelineChanged) {
+    PipelineState state = getScenePipelineState(activeSettings_.shaderFeatures);
+    PipelineState depthState = getDepthPipelineState();
+    // No pipeline with the other depth test or sample count can stand in
+    // while this one compiles, so those changes wait for it
+    if (depthPrepassChanged || samplesChanged) {
+      scenePipeline_ = pipelines_->build(state);
+      depthPipeline_ = pipelines_->build(depthState);
+    } else {
+      scenePipeline_ = pipelines_->request(state);
+      depthPipeline_ = pipelines_->request(depthState);
+    }
+    invalidateSceneCommands();
+  }
+
+  // The phases, the upscale and the anti-aliasing are passes of their own,
+  // the attachments depend on the sample count and the queues the passes
+  // run on decide the batches, so changing any of them rebuilds the graph
+  bool cullingGraph =
+      activeSettings_.gpuCulling && !activeSettings_.occlusionCulling;
+  if (dynamicRendering_ &&
+      (occlusionGraph_ != activeSettings_.occlusionCulling ||
+       cullingGraph_ != cullingGraph ||
+       asyncGraph_ != activeSettings_.asyncCompute ||
+       scaledGraph_ != activeSettings_.dynamicResolution ||
+       graphAntiAliasing_ != activeSettings_.antiAliasing ||
+       shadowGraph_ != activeSettings_.shadows || samplesChanged)) {
+    retireRenderGraph();
+    createRenderGraph();
+  }
+
+  // The lights only live in buffers, so nothing has to be re-recorded
+  if (activeSettings_.lightCount != lights_.size()) {
+    lights_ = createLights(activeSettings_.lightCount, modelBounds_);
+    ++lightsVersion_;
+  }
+  profiler_.setCounter("Lights", lights_.size());
+
+  if (drawModeChanged) {
+    // The CPU visible list is not kept up to date while the GPU culls
+    if (!activeSettings_.gpuCulling) {
+      cullInstances();
+    }
+    invalidateSceneCommands();
+  }
+
+  // Re-record once a background compile lands so draws stop falling back
+  uint64_t pipelineVersion = pipelines_->getVersion();
+  if (pipelineVersion != pipelineVersion_) {
+    pipelineVersion_ = pipelineVersion;
+    invalidateSceneCommands();
+  }
+  profiler_.setCounter("Pipelines", pipelines_->getPipelineCount());
+  profiler_.setCounter("Pipelines compiling", pipelines_->getPendingCount());
+
+  uint32_t descriptorPoolCount = descriptors_->getPoolCount();
+  for (const auto& frameDescriptors : frameDescriptors_) {
+    descriptorPoolCount += frameDescriptors->getPoolCount();
+  }
+  profiler_.setCounter("Descriptor pools", descriptorPoolCount);
+  profiler_.setCounter("Descriptor set layouts",
+                       descriptorLayouts_->getLayoutCount());
+
+  if (!gpuCullingSupported_) {
+    profiler_.setText("GPU culling", "unsupported");
+  } else {
+    profiler_.setText("GPU culling", activeSettings_.gpuCulling ? "on" : "off");
+  }
+
+  if (!occlusionCullingSupported_) {
+    profiler_.setText("Occlusion culling", "unsupported");
+  } else if (!occlusionSamplesSupported) {
+    profiler_.setText("Occlusion culling", "off (MSAA)");
+  } else {
+    profiler_.setText("Occlusion culling",
+                      activeSettings_.occlusionCulling ? "on" : "off");
+  }
+
+  if (!dynamicResolutionSupported) {
+    profiler_.setText("Dynamic resolution", "unsupported");
+  } else {
+    profiler_.setText("Dynamic resolution",
+                      activeSettings_.dynamicResolution ? "on" : "off");
+  }
+
+  if (AntiAliasing::Fxaa == antiAliasing) {
+    antiAliasingName_ = "FXAA";
+  } else if (AntiAliasing::Taa == antiAliasing) {
+    antiAliasingName_ = "TAA";
+  } else {
+    antiAliasingName_ = "MSAA " + std::to_string(samples) + "x";
+    if (VK_SAMPLE_COUNT_1_BIT != samples &&
+        (activeSettings_.shaderFeatures & ShaderFeature::SampleShading)) {
+      antiAliasingName_ += ", sample shading";
+    }
+  }
+  if (antiAliasing != settings.antiAliasing) {
+    profiler_.setText("Anti-aliasing",
+                      antiAliasingName_ + " (" +
+                          getAntiAliasingName(settings.antiAliasing) +
+                          " unsupported)");
+  } else {
+    profiler_.setText("Anti-aliasing", antiAliasingName_);
+  }
+
+  if (!shadowsSupported_) {
+    profiler_.setText("Shadows", "unsupported");
+  } else {
+    profiler_.setText("Shadows", activeSettings_.shadows ? "on" : "off");
+  }
+
+  if (activeSettings_.depthPrepass) {
+    profiler_.setText("Depth pre-pass", "on");
+  } else if (settings.depthPrepass) {
+    profiler_.setText("Depth pre-pass", "off (alpha test)");
+  } else {
+    profiler_.setText("Depth pre-pass", "off");
+  }
+
+  if (!presentWaitSupported_) {
+    profiler_.setText("Present wait", "unsupported");
+  } else {
+    profiler_.setText("Present wait",
+                      activeSettings_.presentWait ? "on" : "off");
+  }
+}
+
+void Renderer::waitForPresent() {
+  // Let at most one presented frame queue up ahead of the display, so the
+  // CPU starts the next frame as late as possible without starving the GPU
+  if (!activeSettings_.presentWait || presentId_ < 2) {
+    return;
+  }
+
+  auto waitStart = std::chrono::steady_clock::now();
+  VkResult result = vkWaitForPresentKHR_(device_, swapChain_, presentId_ - 1,
+                                         presentWaitTimeout);
+  auto waitEnd = std::chrono::steady_clock::now();
+  profiler_.setTime(
+      "Present wait",
+      std::chrono::duration<double, std::milli>(waitEnd - waitStart).count());
+
+  // Out of date swapchains are recreated by acquire/present
+  if (VK_ERROR_DEVICE_LOST == result) {
+    throw std::runtime_error("Failed to wait for present!");
+  }
+}
+
 void Renderer::createInstance() {
   if (enableValidationLayers && !checkValidationLayerSupport()) {
     throw std::runtime_error("Validation layers requested, but not available!");
@@ -314,7 +965,7 @@ void Renderer::createInstance() {
   appInfo.engineVersion =
       VK_MAKE_VERSION(VK_RENDERER_VERSION_MAJOR, VK_RENDERER_VERSION_MINOR,
                       VK_RENDERER_VERSION_PATCH);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  appInfo.apiVersion = VK_API_VERSION_1_3;
 
   uint32_t availableExtensionCount = 0;
   vkEnumerateInstanceExtensionProperties(nullptr, &availableExtensionCount,
@@ -394,7 +1045,10 @@ void Renderer::pickPhysicalDevice() {
   for (const auto& device : devices) {
     if (isDeviceSuitable(device)) {
       physicalDevice_ = device;
-      msaaSamples_ = getMaxUsableSampleCount();
+      presentWaitSupported_ = checkPresentWaitSupport(device);
+      gpuCullingSupported_ = checkGPUCullingSupport(device);
+      pipelineStatisticsSupported_ = checkPipelineStatisticsSupport(device);
+      timestampsSupported_ = checkTimestampSupport(device);
       break;
     }
   }
@@ -403,6 +1057,34 @@ void Renderer::pickPhysicalDevice() {
     throw std::runtime_error("Failed to find a suitable GPU!");
   }
 
+  // Checked before the device and its resources are created
+  if (lightBenchmarkRequested_ && !timestampsSupported_) {
+    throw std::runtime_error("Light benchmark needs GPU timestamps!");
+  }
+
+  if (dynamicRendering_ && !checkDynamicRenderingSupport(physicalDevice_)) {
+    std::clog << "Dynamic rendering or synchronization2 is not supported, "
+                 "using render passes"
+              << std::endl;
+    dynamicRendering_ = false;
+  }
+  profiler_.setText("Render path",
+                    dynamicRendering_ ? "render graph" : "render pass");
+
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
+  framebufferSampleCounts_ = properties.limits.framebufferColorSampleCounts &
+                             properties.limits.framebufferDepthSampleCounts;
+  sampledDepthSampleCounts_ = properties.limits.sampledImageDepthSampleCounts;
+
+  // Without the render graph there are no post-process passes, and the
+  // render pass fixes the sample count from here on
+  bool postAntiAliasing = dynamicRendering_ &&
+                          AntiAliasing::Msaa != activeSettings_.antiAliasing;
+  msaaSamples_ = postAntiAliasing
+                     ? VK_SAMPLE_COUNT_1_BIT
+                     : getUsableSampleCount(activeSettings_.msaaSamples);
+
   // std::multimap<int, VkPhysicalDevice> candidates;
 
   // for (const auto& device : devices) {
@@ -422,6 +1104,14 @@ void Renderer::createLogicalDevice() {
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos{};
   std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(),
                                             indices.presentFamily.value()};
+  // The async passes are scheduled by the render graph
+  asyncComputeSupported_ = indices.computeFamily.has_value() &&
+                           dynamicRendering_;
+  if (asyncComputeSupported_) {
+    uniqueQueueFamilies.insert(indices.computeFamily.value());
+  } else {
+    profiler_.setText("Async compute", "unsupported (graphics queue)");
+  }
   float queuePriority = 1.f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
     VkDeviceQueueCreateInfo queueCreateInfo{};
@@ -435,16 +1125,84 @@ void Renderer::createLogicalDevice() {
   VkPhysicalDeviceFeatures deviceFeatures{};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+  std::vector<const char*> extensions(deviceExtensions);
+
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+  presentIdFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  presentIdFeatures.presentId = VK_TRUE;
+
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+  presentWaitFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  presentWaitFeatures.pNext = &presentIdFeatures;
+  presentWaitFeatures.presentWait = VK_TRUE;
+
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+  dynamicRenderingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+
+  VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+  synchronization2Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+  synchronization2Features.pNext = &dynamicRenderingFeatures;
+  synchronization2Features.synchronization2 = VK_TRUE;
+
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
+  bool dynamicRenderingCore = properties.apiVersion >= VK_API_VERSION_1_3;
+
+  // Optional features are chained in front of each other
+  void* featureChain = nullptr;
+  if (presentWaitSupported_) {
+    extensions.insert(extensions.end(), presentWaitExtensions.begin(),
+                      presentWaitExtensions.end());
+    presentIdFeatures.pNext = featureChain;
+    featureChain = &presentWaitFeatures;
+  }
+  if (dynamicRendering_) {
+    if (!dynamicRenderingCore) {
+      extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+      extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    }
+    dynamicRenderingFeatures.pNext = featureChain;
+    featureChain = &synchronization2Features;
+  }
+
+  // Draw counts written by the culling pass, firstInstance picks the instance
+  VkPhysicalDeviceVulkan12Features vulkan12Features{};
+  vulkan12Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vulkan12Features.drawIndirectCount = VK_TRUE;
+  bool drawIndirectCountCore = properties.apiVersion >= VK_API_VERSION_1_2;
+  if (gpuCullingSupported_) {
+    deviceFeatures.multiDrawIndirect = VK_TRUE;
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+    if (drawIndirectCountCore) {
+      vulkan12Features.pNext = featureChain;
+      featureChain = &vulkan12Features;
+    } else {
+      extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+  }
+
+  // Scene secondaries run inside the statistics query of the primary
+  if (pipelineStatisticsSupported_) {
+    deviceFeatures.pipelineStatisticsQuery = VK_TRUE;
+    deviceFeatures.inheritedQueries = VK_TRUE;
+  }
+
   VkDeviceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = featureChain;
   deviceFeatures.sampleRateShading = VK_TRUE;
   createInfo.queueCreateInfoCount =
       static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount =
-      static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
 
   if (enableValidationLayers) {
     createInfo.enabledLayerCount =
@@ -462,9 +1220,63 @@ void Renderer::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily.value(), 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily.value(), 0, &presentQueue_);
+  if (asyncComputeSupported_) {
+    vkGetDeviceQueue(device_, indices.computeFamily.value(), 0,
+                     &computeQueue_);
+  }
+
+  if (presentWaitSupported_) {
+    vkWaitForPresentKHR_ = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(
+        device_, "vkWaitForPresentKHR");
+    presentWaitSupported_ = nullptr != vkWaitForPresentKHR_;
+  }
+
+  if (dynamicRendering_) {
+    const char* beginName =
+        dynamicRenderingCore ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR";
+    const char* endName =
+        dynamicRenderingCore ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR";
+    vkCmdBeginRenderingKHR_ = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(
+        device_, beginName);
+    vkCmdEndRenderingKHR_ =
+        (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device_, endName);
+    const char* barrierName = dynamicRenderingCore ? "vkCmdPipelineBarrier2"
+                                                   : "vkCmdPipelineBarrier2KHR";
+    vkCmdPipelineBarrier2KHR_ =
+        (PFN_vkCmdPipelineBarrier2KHR)vkGetDeviceProcAddr(device_,
+                                                          barrierName);
+    if (!vkCmdBeginRenderingKHR_ || !vkCmdEndRenderingKHR_ ||
+        !vkCmdPipelineBarrier2KHR_) {
+      throw std::runtime_error("Failed to load dynamic rendering functions!");
+    }
+  }
+
+  if (gpuCullingSupported_) {
+    const char* drawName = drawIndirectCountCore
+                               ? "vkCmdDrawIndexedIndirectCount"
+                               : "vkCmdDrawIndexedIndirectCountKHR";
+    vkCmdDrawIndexedIndirectCountKHR_ =
+        (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(device_,
+                                                                  drawName);
+    gpuCullingSupported_ = nullptr != vkCmdDrawIndexedIndirectCountKHR_;
+  }
+
+  // The two phases are render graph passes
+  depthSamplingSupported_ = checkDepthSamplingSupport();
+  occlusionCullingSupported_ =
+      gpuCullingSupported_ && dynamicRendering_ && depthSamplingSupported_;
+  // So is the shadow pass
+  shadowsSupported_ = dynamicRendering_;
+}
+
+void Renderer::createPipelineCache() {
+  pipelineCache_ = std::make_unique<PipelineCache>(
+      device_, physicalDevice_, VK_RENDERER_PIPELINE_CACHE_PATH);
+  profiler_.setText("Pipeline cache", pipelineCache_->getStatus());
+  std::clog << "Pipeline cache: " << pipelineCache_->getStatus() << std::endl;
 }
 
-void Renderer::createSwapChain() {
+void Renderer::createSwapChain(VkSwapchainKHR oldSwapChain) {
   SwapChainSupportDetails swapChainSupport =
       querySwapChainSupprt(physicalDevice_);
 
@@ -507,7 +1319,8 @@ void Renderer::createSwapChain() {
   createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
   createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  // Lets the driver hand over images and keep presenting while we switch
+  createInfo.oldSwapchain = oldSwapChain;
 
   VkResult result =
       vkCreateSwapchainKHR(device_, &createInfo, nullptr, &swapChain_);
@@ -515,12 +1328,17 @@ void Renderer::createSwapChain() {
     throw std::runtime_error("Failed to create swap chain!");
   }
 
+  // Present IDs are per swapchain
+  presentId_ = 0;
+
   vkGetSwapchainImagesKHR(device_, swapChain_, &imageCount, nullptr);
   swapChainImages_.resize(imageCount);
   vkGetSwapchainImagesKHR(device_, swapChain_, &imageCount,
                           swapChainImages_.data());
   swapChainImageFormat_ = surfaceFormat.format;
   swapChainExtent_ = extent;
+  // Scaled down again by the next frame's updateRenderExtent
+  renderExtent_ = extent;
 }
 
 void Renderer::createImageViews() {
@@ -613,190 +1431,489 @@ void Renderer::createRenderPass() {
   }
 }
 
-void Renderer::createDescriptorSetLayout() {
-  VkDescriptorSetLayoutBinding uboLayoutBinding{};
-  uboLayoutBinding.binding = 0;
-  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  uboLayoutBinding.descriptorCount = 1;
-  uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-  uboLayoutBinding.pImmutableSamplers = nullptr;
+void Renderer::createRenderingInfo() {
+  // Without render pass objects only the attachment formats are baked into
+  // pipelines and secondary command buffers
+  pipelineRenderingInfo_.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+  pipelineRenderingInfo_.pNext = nullptr;
+  pipelineRenderingInfo_.colorAttachmentCount = 1;
+  pipelineRenderingInfo_.pColorAttachmentFormats = &swapChainImageFormat_;
+  pipelineRenderingInfo_.depthAttachmentFormat = findDepthFormat();
+  pipelineRenderingInfo_.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+  inheritanceRenderingInfo_.sType =
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+  inheritanceRenderingInfo_.colorAttachmentCount = 1;
+  inheritanceRenderingInfo_.pColorAttachmentFormats = &swapChainImageFormat_;
+  inheritanceRenderingInfo_.depthAttachmentFormat =
+      pipelineRenderingInfo_.depthAttachmentFormat;
+  inheritanceRenderingInfo_.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+  inheritanceRenderingInfo_.rasterizationSamples = msaaSamples_;
+
+  guiRenderingInfo_ = pipelineRenderingInfo_;
+  guiRenderingInfo_.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+  guiInheritanceRenderingInfo_ = inheritanceRenderingInfo_;
+  guiInheritanceRenderingInfo_.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+  guiInheritanceRenderingInfo_.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+}
 
-  VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-  samplerLayoutBinding.binding = 1;
-  samplerLayoutBinding.descriptorCount = 1;
-  samplerLayoutBinding.descriptorType =
-      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  samplerLayoutBinding.pImmutableSamplers = nullptr;
-  samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+void Renderer::createRenderGraph() {
+  auto renderGraph = std::make_unique<RenderGraph>(device_, physicalDevice_,
+                                                   vkCmdPipelineBarrier2KHR_);
+
+  // Culling, the pyramid, light binning and the post-process passes ask for
+  // the async queue, and run on the graphics queue when it is off
+  asyncGraph_ = activeSettings_.asyncCompute && asyncComputeSupported_;
+  QueueFamilyIndices indices = findQueueFamilies(physicalDevice_);
+  renderGraph->setQueueFamilies(indices.graphicsFamily.value(),
+                                asyncGraph_ ? indices.computeFamily.value()
+                                            : VK_QUEUE_FAMILY_IGNORED);
+  if (asyncComputeSupported_) {
+    profiler_.setText(
+        "Async compute",
+        asyncGraph_
+            ? "on (family " + std::to_string(indices.computeFamily.value()) +
+                  ")"
+            : "off");
+  }
+  const RenderGraph::Queue computeQueue = RenderGraph::AsyncComputeQueue;
+
+  // Acquire hands the image over at the semaphore wait stage, and its old
+  // contents are cleared anyway
+  swapChainResource_ = renderGraph->importImage(
+      "swapchain", VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+      VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+  renderGraph->markOutput(swapChainResource_);
+
+  RenderGraphImageInfo depthInfo{};
+  depthInfo.format = pipelineRenderingInfo_.depthAttachmentFormat;
+  depthInfo.extent = swapChainExtent_;
+  depthInfo.samples = msaaSamples_;
+  depthInfo.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (hasStencilComponent(depthInfo.format)) {
+    depthInfo.aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
+  depthResource_ = renderGraph->createImage("depth", depthInfo);
+
+  bool multisampled = VK_SAMPLE_COUNT_1_BIT != msaaSamples_;
+  if (multisampled) {
+    RenderGraphImageInfo colorInfo{};
+    colorInfo.format = swapChainImageFormat_;
+    colorInfo.extent = swapChainExtent_;
+    colorInfo.samples = msaaSamples_;
+    colorResource_ = renderGraph->createImage("color", colorInfo);
+  }
+
+  // With dynamic resolution the scene covers the top-left renderExtent_ of
+  // full-size attachments, so changing the scale reallocates nothing. The
+  // upscale pass then filters it onto the swapchain, which it also does for
+  // the output of the post-process anti-aliasing
+  scaledGraph_ = activeSettings_.dynamicResolution;
+  graphAntiAliasing_ = activeSettings_.antiAliasing;
+  bool upscaled = scaledGraph_ || AntiAliasing::Msaa != graphAntiAliasing_;
+  sceneTargetResource_ = swapChainResource_;
+  if (upscaled) {
+    RenderGraphImageInfo sceneInfo{};
+    sceneInfo.format = swapChainImageFormat_;
+    sceneInfo.extent = swapChainExtent_;
+    sceneColorResource_ = renderGraph->createImage("scene color", sceneInfo);
+    sceneTargetResource_ = sceneColorResource_;
+  }
+  uint32_t targetResource = sceneTargetResource_;
+
+  // Per frame in flight and waited on with its fence, like the draw buffers
+  clusterResource_ = renderGraph->importBuffer(
+      "light clusters", VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+  uint32_t lightBinningPass = renderGraph->addPass(
+      "light binning",
+      [this](VkCommandBuffer commandBuffer) {
+        recordLightBinning(commandBuffer);
+      },
+      computeQueue);
+  renderGraph->write(lightBinningPass, clusterResource_,
+                     RenderGraph::StorageWriteCompute);
+
+  // Draw buffers are per frame in flight and waited on with its fence
+  occlusionGraph_ = activeSettings_.gpuCulling &&
+                    activeSettings_.occlusionCulling &&
+                    occlusionCullingSupported_ &&
+                    (sampledDepthSampleCounts_ & msaaSamples_);
+  cullingGraph_ =
+      activeSettings_.gpuCulling && gpuCullingSupported_ && !occlusionGraph_;
+  if (cullingGraph_ || occlusionGraph_) {
+    indirectResource_ = renderGraph->importBuffer(
+        "indirect draws", VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+    drawCountResource_ = renderGraph->importBuffer(
+        "draw counts", VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+  }
+  if (cullingGraph_) {
+    uint32_t cullPass = renderGraph->addPass(
+        "cull",
+        [this](VkCommandBuffer commandBuffer) { recordCulling(commandBuffer); },
+        computeQueue);
+    renderGraph->write(cullPass, indirectResource_,
+                       RenderGraph::StorageWriteCompute);
+    renderGraph->write(cullPass, drawCountResource_, RenderGraph::TransferDst);
+    renderGraph->write(cullPass, drawCountResource_,
+                       RenderGraph::StorageWriteCompute);
+  }
+
+  // The cached cascades live on from frame to frame, so the map is imported
+  // and kept in the layout the scene samples it in
+  shadowGraph_ = activeSettings_.shadows;
+  if (shadowGraph_) {
+    shadowResource_ = renderGraph->importImage(
+        "shadow map", VK_IMAGE_ASPECT_DEPTH_BIT,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t shadowPass = renderGraph->addPass(
+        "shadows", [this](VkCommandBuffer commandBuffer) {
+          recordShadows(commandBuffer);
+        });
+    renderGraph->write(shadowPass, shadowResource_,
+                       RenderGraph::DepthAttachment);
+  }
 
-  std::array<VkDescriptorSetLayoutBinding, 2> bindings{uboLayoutBinding,
-                                                       samplerLayoutBinding};
+  // Two-phase occlusion culling splits the main pass around a Hi-Z build:
+  // last frame's visible set is drawn first, its depth is reduced into the
+  // pyramid, and whatever passes against that is drawn by the main pass
+  if (occlusionGraph_) {
+    createHiZResources();
+
+    // Rebuilt from scratch every frame, and sampled by the last one's cull.
+    // The visibility was last written by the previous frame. Both stay with
+    // the queue that culls; when that changes the new one takes them over
+    // without their contents, and a frame of stale visibility only moves
+    // draws between the phases
+    hizResource_ = renderGraph->importImage(
+        "hi-z", VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+        computeQueue);
+    renderGraph->setImportedImage(hizResource_, hizImage_, hizImageView_);
+    visibilityResource_ = renderGraph->importBuffer(
+        "visibility", VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, computeQueue);
+
+    // The pyramid is bound in both phases but only sampled in the second
+    uint32_t earlyCullPass = renderGraph->addPass(
+        "cull early",
+        [this](VkCommandBuffer commandBuffer) {
+          recordOcclusionCulling(commandBuffer, 0);
+        },
+        computeQueue);
+    renderGraph->read(earlyCullPass, visibilityResource_,
+                      RenderGraph::StorageReadCompute);
+    renderGraph->read(earlyCullPass, hizResource_,
+                      RenderGraph::SampledCompute);
+    renderGraph->write(earlyCullPass, indirectResource_,
+                       RenderGraph::StorageWriteCompute);
+    renderGraph->write(earlyCullPass, drawCountResource_,
+                       RenderGraph::TransferDst);
+    renderGraph->write(earlyCullPass, drawCountResource_,
+                       RenderGraph::StorageWriteCompute);
+
+    uint32_t earlyPass = renderGraph->addPass(
+        "main early", [this](VkCommandBuffer commandBuffer) {
+          recordMainPass(commandBuffer, true, false);
+        });
+    renderGraph->read(earlyPass, indirectResource_, RenderGraph::IndirectRead);
+    renderGraph->read(earlyPass, drawCountResource_,
+                      RenderGraph::IndirectRead);
+    renderGraph->write(earlyPass,
+                       multisampled ? colorResource_ : targetResource,
+                       RenderGraph::ColorAttachment);
+    renderGraph->write(earlyPass, depthResource_,
+                       RenderGraph::DepthAttachment);
+    renderGraph->read(earlyPass, clusterResource_,
+                      RenderGraph::StorageReadGraphics);
+    if (shadowGraph_) {
+      renderGraph->read(earlyPass, shadowResource_,
+                        RenderGraph::SampledFragment);
+    }
 
-  VkDescriptorSetLayoutCreateInfo layoutInfo{};
-  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-  layoutInfo.pBindings = bindings.data();
+    uint32_t hizPass = renderGraph->addPass(
+        "hi-z",
+        [this](VkCommandBuffer commandBuffer) { recordHiZ(commandBuffer); },
+        computeQueue);
+    renderGraph->read(hizPass, depthResource_, RenderGraph::SampledCompute);
+    renderGraph->write(hizPass, hizResource_,
+                       RenderGraph::StorageWriteCompute);
+
+    uint32_t lateCullPass = renderGraph->addPass(
+        "cull late",
+        [this](VkCommandBuffer commandBuffer) {
+          recordOcclusionCulling(commandBuffer, 1);
+        },
+        computeQueue);
+    renderGraph->read(lateCullPass, hizResource_, RenderGraph::SampledCompute);
+    renderGraph->write(lateCullPass, visibilityResource_,
+                       RenderGraph::StorageWriteCompute);
+    renderGraph->write(lateCullPass, indirectResource_,
+                       RenderGraph::StorageWriteCompute);
+    renderGraph->write(lateCullPass, drawCountResource_,
+                       RenderGraph::TransferDst);
+    renderGraph->write(lateCullPass, drawCountResource_,
+                       RenderGraph::StorageWriteCompute);
+  }
 
-  VkResult result = vkCreateDescriptorSetLayout(device_, &layoutInfo, nullptr,
-                                                &descriptorSetLayout_);
-  if (VK_SUCCESS != result) {
-    throw std::runtime_error("Failed to create descriptor set layout!");
+  uint32_t mainPass = renderGraph->addPass(
+      "main", [this](VkCommandBuffer commandBuffer) {
+        recordMainPass(commandBuffer, !occlusionGraph_, true);
+      });
+  renderGraph->write(mainPass, targetResource, RenderGraph::ColorAttachment);
+  renderGraph->write(mainPass, depthResource_, RenderGraph::DepthAttachment);
+  renderGraph->read(mainPass, clusterResource_,
+                    RenderGraph::StorageReadGraphics);
+  if (shadowGraph_) {
+    renderGraph->read(mainPass, shadowResource_, RenderGraph::SampledFragment);
   }
+  if (multisampled) {
+    renderGraph->write(mainPass, colorResource_, RenderGraph::ColorAttachment);
+  }
+  if (cullingGraph_ || occlusionGraph_) {
+    renderGraph->read(mainPass, indirectResource_, RenderGraph::IndirectRead);
+    renderGraph->read(mainPass, drawCountResource_, RenderGraph::IndirectRead);
+  }
+
+  upscaleSourceResource_ = sceneColorResource_;
+  if (AntiAliasing::Fxaa == graphAntiAliasing_) {
+    RenderGraphImageInfo antiAliasedInfo{};
+    antiAliasedInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    antiAliasedInfo.extent = swapChainExtent_;
+    antiAliasedResource_ =
+        renderGraph->createImage("anti-aliased", antiAliasedInfo);
+
+    uint32_t fxaaPass = renderGraph->addPass(
+        "fxaa",
+        [this](VkCommandBuffer commandBuffer) { recordFxaa(commandBuffer); },
+        computeQueue);
+    renderGraph->read(fxaaPass, sceneColorResource_,
+                      RenderGraph::SampledCompute);
+    renderGraph->write(fxaaPass, antiAliasedResource_,
+                       RenderGraph::StorageWriteCompute);
+    upscaleSourceResource_ = antiAliasedResource_;
+  } else if (AntiAliasing::Taa == graphAntiAliasing_) {
+    createHistoryResources();
+
+    // Last frame's result, and the image this frame's result replaces. The
+    // images are swapped before every frame
+    historyResource_ = renderGraph->importImage(
+        "history", VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    antiAliasedResource_ = renderGraph->importImage(
+        "anti-aliased", VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+            VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    uint32_t taaPass = renderGraph->addPass(
+        "taa",
+        [this](VkCommandBuffer commandBuffer) { recordTaa(commandBuffer); },
+        computeQueue);
+    renderGraph->read(taaPass, sceneColorResource_,
+                      RenderGraph::SampledCompute);
+    renderGraph->read(taaPass, depthResource_, RenderGraph::SampledCompute);
+    renderGraph->read(taaPass, historyResource_, RenderGraph::SampledCompute);
+    renderGraph->write(taaPass, antiAliasedResource_,
+                       RenderGraph::StorageWriteCompute);
+    upscaleSourceResource_ = antiAliasedResource_;
+  }
+
+  if (upscaled) {
+    uint32_t upscalePass =
+        renderGraph->addPass("upscale", [this](VkCommandBuffer commandBuffer) {
+          recordUpscale(commandBuffer);
+        });
+    renderGraph->read(upscalePass, upscaleSourceResource_,
+                      RenderGraph::SampledFragment);
+    renderGraph->write(upscalePass, swapChainResource_,
+                       RenderGraph::ColorAttachment);
+  }
+
+  uint32_t guiPass = renderGraph->addPass(
+      "gui",
+      [this](VkCommandBuffer commandBuffer) { recordGUIPass(commandBuffer); });
+  renderGraph->write(guiPass, swapChainResource_,
+                     RenderGraph::ColorAttachment);
+
+  renderGraph->compile();
+  if (dumpRenderGraph_) {
+    renderGraph->dump(std::clog);
+  }
+  if (maxFrameBatches < renderGraph->getBatchCount()) {
+    throw std::runtime_error("Render graph needs too many submissions!");
+  }
+
+  profiler_.setCounter(
+      "Render graph passes",
+      renderGraph->getPassCount() - renderGraph->getCulledPassCount());
+  profiler_.setCounter("Render graph barriers", renderGraph->getBarrierCount());
+  profiler_.setCounter("Render graph submissions",
+                       renderGraph->getBatchCount());
+  profiler_.setCounter("Transient memory (KiB)",
+                       renderGraph->getTransientMemorySize() / 1024);
+
+  renderGraph_ = std::move(renderGraph);
 }
 
 void Renderer::createGraphicsPipeline() {
-  auto vertShaderCode = readFile("shaders/vert.spv");
-  auto fragShaderCode = readFile("shaders/frag.spv");
-
-  VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-  VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-  vertShaderStageInfo.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = vertShaderModule;
-  vertShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-  fragShaderStageInfo.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module = fragShaderModule;
-  fragShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo,
-                                                    fragShaderStageInfo};
-
-  VkPipelineVertexInputStateCreateInfo vertextInputInfo{};
-  vertextInputInfo.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  auto bindingDescription = Vertex::getBindingDescription();
-  vertextInputInfo.vertexBindingDescriptionCount = 1;
-  vertextInputInfo.pVertexBindingDescriptions = &bindingDescription;
+  descriptorLayouts_ = std::make_unique<DescriptorLayoutCache>(device_);
+  pipelines_ = std::make_unique<PipelineManager>(
+      device_, pipelineCache_->get(), *descriptorLayouts_, *jobSystem_,
+      profiler_);
+
+  // Set 0 holds the texture, set 1 the lights and their clusters,
+  // transforms are push constants
+  const PipelineLayoutInfo& layout =
+      pipelines_->getLayout(sceneVertexShader, sceneFragmentShader);
+  if (layout.setLayouts.size() < 2 || layout.pushConstantRanges.empty()) {
+    throw std::runtime_error("Scene shaders do not match the renderer!");
+  }
+  pipelineLayout_ = layout.layout;
+  descriptorSetLayout_ = layout.setLayouts[0];
+  lightingSetLayout_ = layout.setLayouts[1];
+
+  // The first pipeline is built up front so every later variant has a
+  // compatible fallback while it compiles
+  auto pipelineStart = std::chrono::steady_clock::now();
+  scenePipeline_ =
+      pipelines_->build(getScenePipelineState(activeSettings_.shaderFeatures));
+  auto pipelineEnd = std::chrono::steady_clock::now();
+  double pipelineTime =
+      std::chrono::duration<double, std::milli>(pipelineEnd - pipelineStart)
+          .count();
+  std::clog << "Scene pipeline creation: " << pipelineTime << " ms ("
+            << (pipelineCache_->isWarm() ? "warm" : "cold") << ")"
+            << std::endl;
+  depthPipeline_ = pipelines_->build(getDepthPipelineState());
+
+  // Every other variant compiles in the background, which also reports the
+  // creation time of each feature combination
+  for (uint32_t features = 0; features < (1u << shaderFeatureCount);
+       ++features) {
+    pipelines_->request(getScenePipelineState(features));
+  }
+
+  invalidateSceneCommands();
+}
+
+PipelineState Renderer::getScenePipelineState(uint32_t features) {
   auto attributeDescriptions = Vertex::getAttributeDescriptions();
-  vertextInputInfo.vertexAttributeDescriptionCount =
-      static_cast<uint32_t>(attributeDescriptions.size());
-  vertextInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-  inputAssembly.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-  VkPipelineRasterizationStateCreateInfo rasterizer{};
-  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterizer.depthClampEnable = VK_FALSE;
-  rasterizer.rasterizerDiscardEnable = VK_FALSE;
-  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-  rasterizer.lineWidth = 1.f;
-  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-  rasterizer.depthBiasEnable = VK_FALSE;
-  rasterizer.depthBiasConstantFactor = 0.f;
-  rasterizer.depthBiasClamp = 0.f;
-  rasterizer.depthBiasSlopeFactor = 0.f;
-
-  VkPipelineMultisampleStateCreateInfo multisampling{};
-  multisampling.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = msaaSamples_;
-  multisampling.sampleShadingEnable = VK_TRUE;
-  multisampling.minSampleShading = .2f;
-  multisampling.pSampleMask = nullptr;
-  multisampling.alphaToCoverageEnable = VK_FALSE;
-  multisampling.alphaToOneEnable = VK_FALSE;
-
-  VkPipelineDepthStencilStateCreateInfo depthStencil{};
-  depthStencil.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-  depthStencil.depthTestEnable = VK_TRUE;
-  depthStencil.depthWriteEnable = VK_TRUE;
-  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-  depthStencil.depthBoundsTestEnable = VK_FALSE;
-  depthStencil.minDepthBounds = 0.f;
-  depthStencil.maxDepthBounds = 1.f;
-  depthStencil.stencilTestEnable = VK_FALSE;
-  depthStencil.front = {};
-  depthStencil.back = {};
-
-  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-  colorBlendAttachment.colorWriteMask =
-      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  colorBlendAttachment.blendEnable = VK_FALSE;
-  colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-  colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-  colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-  colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-  colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-  colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-  VkPipelineColorBlendStateCreateInfo colorBlending{};
-  colorBlending.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  colorBlending.logicOpEnable = VK_FALSE;
-  colorBlending.logicOp = VK_LOGIC_OP_COPY;
-  colorBlending.attachmentCount = 1;
-  colorBlending.pAttachments = &colorBlendAttachment;
-  colorBlending.blendConstants[0] = 0.f;
-  colorBlending.blendConstants[1] = 0.f;
-  colorBlending.blendConstants[2] = 0.f;
-  colorBlending.blendConstants[3] = 0.f;
-
-  std::vector<VkDynamicState> dynamicStates{VK_DYNAMIC_STATE_VIEWPORT,
-                                            VK_DYNAMIC_STATE_SCISSOR};
-  VkPipelineDynamicStateCreateInfo dynamicState{};
-  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-  dynamicState.pDynamicStates = dynamicStates.data();
-
-  VkPipelineViewportStateCreateInfo viewportState{};
-  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewportState.viewportCount = 1;
-  viewportState.scissorCount = 1;
-
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 1;
-  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout_;
-  pipelineLayoutInfo.pushConstantRangeCount = 0;
-  pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-  VkResult result = vkCreatePipelineLayout(device_, &pipelineLayoutInfo,
-                                           nullptr, &pipelineLayout_);
-  if (VK_SUCCESS != result) {
-    throw std::runtime_error("Failed to create pipeline layout!");
-  }
-
-  VkGraphicsPipelineCreateInfo pipelineInfo{};
-  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount = 2;
-  pipelineInfo.pStages = shaderStages;
-  pipelineInfo.pVertexInputState = &vertextInputInfo;
-  pipelineInfo.pInputAssemblyState = &inputAssembly;
-  pipelineInfo.pViewportState = &viewportState;
-  pipelineInfo.pRasterizationState = &rasterizer;
-  pipelineInfo.pMultisampleState = &multisampling;
-  pipelineInfo.pDepthStencilState = &depthStencil;
-  pipelineInfo.pColorBlendState = &colorBlending;
-  pipelineInfo.pDynamicState = &dynamicState;
-  pipelineInfo.layout = pipelineLayout_;
-  pipelineInfo.renderPass = renderPass_;
-  pipelineInfo.subpass = 0;
-  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-  pipelineInfo.basePipelineIndex = -1;
-
-  result = vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &pipelineInfo,
-                                     nullptr, &graphicsPipeline_);
-  if (VK_SUCCESS != result) {
-    throw std::runtime_error("Failed to create graphics pipeline!");
+  auto instanceAttributeDescriptions = InstanceData::getAttributeDescriptions();
+
+  float alphaCutoff = .5f;
+  uint32_t alphaCutoffBits = 0;
+  std::memcpy(&alphaCutoffBits, &alphaCutoff, sizeof(alphaCutoff));
+
+  PipelineState state{};
+  state.name = "scene " + getShaderVariantName(features);
+  state.vertexShader = sceneVertexShader;
+  state.fragmentShader = sceneFragmentShader;
+  // constant_id order of shader.vert and shader.frag
+  state.specialization = {
+      features & ShaderFeature::VertexColor ? VK_TRUE : VK_FALSE,
+      features & ShaderFeature::Texturing ? VK_TRUE : VK_FALSE,
+      features & ShaderFeature::AlphaTest ? VK_TRUE : VK_FALSE,
+      alphaCutoffBits,
+  };
+  state.vertexBindings = {Vertex::getBindingDescription(),
+                          InstanceData::getBindingDescription()};
+  state.vertexAttributes.assign(attributeDescriptions.begin(),
+                                attributeDescriptions.end());
+  state.vertexAttributes.insert(state.vertexAttributes.end(),
+                                instanceAttributeDescriptions.begin(),
+                                instanceAttributeDescriptions.end());
+  state.cullMode = activeSettings_.backfaceCulling ? VK_CULL_MODE_BACK_BIT
+                                                   : VK_CULL_MODE_NONE;
+  // Only the fragments that won the pre-pass are shaded
+  if (activeSettings_.depthPrepass) {
+    state.depthWrite = false;
+    state.depthCompareOp = VK_COMPARE_OP_EQUAL;
   }
+  state.samples = msaaSamples_;
+  state.sampleShading = features & ShaderFeature::SampleShading;
+  // Every sample when on, a lower fraction rounds down to one sample per
+  // pixel at common sample counts
+  state.minSampleShading = 1.f;
+  state.colorFormat = swapChainImageFormat_;
+  state.depthFormat = findDepthFormat();
+  state.renderPass = renderPass_;
+
+  return state;
+}
+
+PipelineState Renderer::getDepthPipelineState() {
+  auto instanceAttributeDescriptions = InstanceData::getAttributeDescriptions();
+
+  VkVertexInputBindingDescription positionBinding{};
+  positionBinding.binding = 0;
+  positionBinding.stride = sizeof(glm::vec3);
+  positionBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+  VkVertexInputAttributeDescription positionAttribute{};
+  positionAttribute.binding = 0;
+  positionAttribute.location = 0;
+  positionAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+  positionAttribute.offset = 0;
+
+  PipelineState state{};
+  state.name = "depth pre-pass";
+  state.vertexShader = depthVertexShader;
+  state.vertexBindings = {positionBinding,
+                          InstanceData::getBindingDescription()};
+  state.vertexAttributes = {positionAttribute};
+  state.vertexAttributes.insert(state.vertexAttributes.end(),
+                                instanceAttributeDescriptions.begin(),
+                                instanceAttributeDescriptions.end());
+  state.cullMode = activeSettings_.backfaceCulling ? VK_CULL_MODE_BACK_BIT
+                                                   : VK_CULL_MODE_NONE;
+  state.colorWriteMask = 0;
+  state.samples = msaaSamples_;
+  state.colorFormat = swapChainImageFormat_;
+  state.depthFormat = findDepthFormat();
+  state.renderPass = renderPass_;
+  // The scene layout, so push constants carry over between the passes
+  state.layout = pipelineLayout_;
+
+  return state;
+}
+
+PipelineState Renderer::getShadowPipelineState() {
+  PipelineState state = getDepthPipelineState();
+  state.name = "shadow map";
+  // Both faces cast, the bias keeps lit surfaces from shadowing themselves
+  state.cullMode = VK_CULL_MODE_NONE;
+  state.depthBiasConstant = shadowDepthBias;
+  state.depthBiasSlope = shadowSlopeBias;
+  state.samples = VK_SAMPLE_COUNT_1_BIT;
+  state.colorFormat = VK_FORMAT_UNDEFINED;
+  state.depthFormat = shadowFormat_;
+  state.renderPass = VK_NULL_HANDLE;
+
+  return state;
+}
 
-  vkDestroyShaderModule(device_, vertShaderModule, nullptr);
-  vkDestroyShaderModule(device_, fragShaderModule, nullptr);
+PipelineState Renderer::getUpscalePipelineState(bool sharpen) {
+  PipelineState state{};
+  state.name = sharpen ? "sharpening upscale" : "bilinear upscale";
+  state.vertexShader = upscaleVertexShader;
+  state.fragmentShader = upscaleFragmentShader;
+  state.specialization = {sharpen ? 1u : 0u};
+  state.cullMode = VK_CULL_MODE_NONE;
+  state.depthTest = false;
+  state.depthWrite = false;
+  state.samples = VK_SAMPLE_COUNT_1_BIT;
+  state.colorFormat = swapChainImageFormat_;
+  state.depthFormat = VK_FORMAT_UNDEFINED;
+  state.layout = upscalePipelineLayout_;
+
+  return state;
 }
 
 void Renderer::createColorResources() {
@@ -820,13 +1937,17 @@ void Renderer::createDepthResources() {
               VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage_,
               depthImageMemory_);
+  // The render pass transitions depth from UNDEFINED, so there is no
+  // layout change to submit and wait for here
   depthImageView_ =
       createImageView(depthImage_, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
-  transitionImageLayout(depthImage_, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED,
-                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
 }
 
 void Renderer::createFramebuffers() {
+  if (dynamicRendering_) {
+    return;
+  }
+
   swapChainFrameBuffers_.resize(swapChainImageViews_.size());
 
   for (size_t i = 0; i < swapChainImageViews_.size(); ++i) {
@@ -854,91 +1975,319 @@ void Renderer::createFramebuffers() {
 }
 
 void Renderer::loadModel() {
-  tinyobj::attrib_t attrib{};
-  std::vector<tinyobj::shape_t> shapes{};
-  std::vector<tinyobj::material_t> materials{};
-  std::string warn{};
-  std::string err{};
-  std::string path{VK_RENDERER_MODEL_PATH};
-
-  bool result =
-      tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str());
-  if (!result) {
-    throw std::runtime_error(warn + err);
-  }
-
-  std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-  for (const auto& shape : shapes) {
-    for (const auto& index : shape.mesh.indices) {
-      Vertex vertex{};
-      vertex.pos = {attrib.vertices[3 * index.vertex_index + 0],
-                    attrib.vertices[3 * index.vertex_index + 1],
-                    attrib.vertices[3 * index.vertex_index + 2]};
-      vertex.texCoord = {attrib.texcoords[2 * index.texcoord_index + 0],
-                         1.f - attrib.texcoords[2 * index.texcoord_index + 1]};
-      vertex.color = {1.f, 1.f, 1.f};
-
-      if (0 == uniqueVertices.count(vertex)) {
-        uniqueVertices[vertex] = static_cast<uint32_t>(vertices_.size());
-        vertices_.push_back(vertex);
-      }
+  MeshData mesh = loadMesh(VK_RENDERER_MODEL_PATH, *jobSystem_);
+
+  vertices_ = std::move(mesh.vertices);
+  indices_ = std::move(mesh.indices);
+  drawCommands_ = std::move(mesh.drawCommands);
+
+  // Per-part transforms, OBJ shapes are authored in model space. Where each
+  // copy of the whole model goes is up to its instance
+  drawModels_.assign(drawCommands_.size(), glm::mat4(1.f));
+  instances_ = createInstanceGrid(instanceCount_);
+
+  // One sphere around the whole model, moved and scaled by each instance
+  glm::vec4 sphere = getBoundingSphere(vertices_);
+  modelBounds_ = sphere;
+  instanceBounds_.clear();
+  instanceBounds_.reserve(instances_.size());
+  for (const InstanceData& instance : instances_) {
+    const glm::mat4& model = instance.model;
+    float scale = std::max({glm::length(glm::vec3(model[0])),
+                            glm::length(glm::vec3(model[1])),
+                            glm::length(glm::vec3(model[2]))});
+    glm::vec4 center = model * glm::vec4(glm::vec3(sphere), 1.f);
+    instanceBounds_.push_back(glm::vec4(glm::vec3(center), sphere.w * scale));
+  }
 
-      indices_.push_back(uniqueVertices[vertex]);
-    }
+  // A sphere around the box of the instance spheres, loose but cheap
+  glm::vec3 boxMin(std::numeric_limits<float>::max());
+  glm::vec3 boxMax(std::numeric_limits<float>::lowest());
+  for (size_t i = 0; i < instanceBounds_.size(); ++i) {
+    glm::vec3 center(instanceBounds_.x[i], instanceBounds_.y[i],
+                     instanceBounds_.z[i]);
+    boxMin = glm::min(boxMin, center - instanceBounds_.radius[i]);
+    boxMax = glm::max(boxMax, center + instanceBounds_.radius[i]);
   }
+  if (!instanceBounds_.size()) {
+    boxMin = boxMax = glm::vec3(0.f);
+  }
+  sceneBounds_ = glm::vec4((boxMin + boxMax) * .5f,
+                           glm::length(boxMax - boxMin) * .5f);
 }
 
-void Renderer::createVertexBuffer() {
-  VkDeviceSize bufferSize = sizeof(vertices_[0]) * vertices_.size();
-
-  VkBuffer stagingBuffer{};
-  VkDeviceMemory stagingBufferMemory{};
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               stagingBuffer, stagingBufferMemory);
-
-  void* data = nullptr;
-  vkMapMemory(device_, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, vertices_.data(), static_cast<size_t>(bufferSize));
-  vkUnmapMemory(device_, stagingBufferMemory);
+void Renderer::loadTexture() {
+  int texChannels = 0;
+  stbi_uc* pixels = stbi_load(VK_RENDERER_TEXTURE_PATH, &textureWidth_,
+                              &textureHeight_, &texChannels, STBI_rgb_alpha);
+  if (!pixels) {
+    throw std::runtime_error("Failed to load texture image!");
+  }
 
-  createBuffer(
-      bufferSize,
-      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer_, vertexBufferMemory_);
+  texturePixels_.assign(pixels, pixels + textureWidth_ * textureHeight_ * 4);
 
-  copyBuffer(stagingBuffer, vertexBuffer_, bufferSize);
+  stbi_image_free(pixels);
+}
 
-  vkDestroyBuffer(device_, stagingBuffer, nullptr);
-  vkFreeMemory(device_, stagingBufferMemory, nullptr);
+void Renderer::createVertexBuffer() {
+  VkDeviceSize bufferSize = sizeof(vertices_[0]) * vertices_.size();
+  createDeviceLocalBuffer(vertices_.data(), bufferSize,
+                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer_,
+                          vertexBufferMemory_);
+
+  // The depth pre-pass fetches 12 of the 32 bytes of each vertex
+  std::vector<glm::vec3> positions(vertices_.size());
+  for (size_t i = 0; i < vertices_.size(); ++i) {
+    positions[i] = vertices_[i].pos;
+  }
+  createDeviceLocalBuffer(positions.data(),
+                          sizeof(positions[0]) * positions.size(),
+                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, positionBuffer_,
+                          positionBufferMemory_);
 }
 
 void Renderer::createIndexBufffer() {
   VkDeviceSize bufferSize = sizeof(indices_[0]) * indices_.size();
+  createDeviceLocalBuffer(indices_.data(), bufferSize,
+                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer_,
+                          indexBufferMemory_);
+}
 
-  VkBuffer stagingBuffer{};
-  VkDeviceMemory stagingBufferMemory{};
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               stagingBuffer, stagingBufferMemory);
+void Renderer::createInstanceBuffer() {
+  VkDeviceSize bufferSize = sizeof(instances_[0]) * instances_.size();
+  createDeviceLocalBuffer(instances_.data(), bufferSize,
+                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, instanceBuffer_,
+                          instanceBufferMemory_);
+}
 
-  void* data = nullptr;
-  vkMapMemory(device_, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, indices_.data(), static_cast<size_t>(bufferSize));
-  vkUnmapMemory(device_, stagingBufferMemory);
+void Renderer::createCullingResources() {
+  if (!gpuCullingSupported_) {
+    return;
+  }
 
-  createBuffer(
-      bufferSize,
-      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer_, indexBufferMemory_);
+  cullingPipeline_ = pipelines_->getCompute(cullingShader);
+  const PipelineLayoutInfo& layout =
+      pipelines_->getComputeLayout(cullingShader);
+  if (layout.setLayouts.empty()) {
+    throw std::runtime_error("Culling shader does not match the renderer!");
+  }
+  cullingPipelineLayout_ = layout.layout;
+
+  // Bounds and draw records are static, laid out as cull.comp reads them.
+  // Both queues may cull
+  std::vector<glm::vec4> spheres(instanceBounds_.size());
+  for (size_t i = 0; i < spheres.size(); ++i) {
+    spheres[i] = glm::vec4(instanceBounds_.x[i], instanceBounds_.y[i],
+                           instanceBounds_.z[i], instanceBounds_.radius[i]);
+  }
+  createDeviceLocalBuffer(spheres.data(), sizeof(spheres[0]) * spheres.size(),
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, boundsBuffer_,
+                          boundsBufferMemory_, true);
+  createDeviceLocalBuffer(
+      drawCommands_.data(), sizeof(drawCommands_[0]) * drawCommands_.size(),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, drawRecordBuffer_,
+      drawRecordBufferMemory_, true);
+
+  // Bindings 0 to 3 of cull.comp, in the order of CullingDescriptors
+  const size_t offsets[] = {offsetof(CullingDescriptors, bounds),
+                            offsetof(CullingDescriptors, records),
+                            offsetof(CullingDescriptors, commands),
+                            offsetof(CullingDescriptors, drawCount)};
+  std::vector<VkDescriptorUpdateTemplateEntry> entries{};
+  for (uint32_t binding = 0; binding < 4; ++binding) {
+    VkDescriptorUpdateTemplateEntry entry{};
+    entry.dstBinding = binding;
+    entry.dstArrayElement = 0;
+    entry.descriptorCount = 1;
+    entry.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    entry.offset = offsets[binding];
+    entry.stride = sizeof(VkDescriptorBufferInfo);
+    entries.push_back(entry);
+  }
+  cullingUpdate_ = std::make_unique<DescriptorUpdateTemplate>(
+      device_, physicalDevice_, layout.setLayouts[0], entries);
+
+  // Every visible instance may add one draw per mesh part. The outputs are
+  // per frame in flight, so a frame culls while the last one still draws
+  maxIndirectDraws_ =
+      static_cast<uint32_t>(instances_.size() * drawCommands_.size());
+  VkDeviceSize indirectSize =
+      sizeof(VkDrawIndexedIndirectCommand) * maxIndirectDraws_;
+
+  indirectBuffers_.resize(MAX_FRAMES_IN_FLIGHT);
+  indirectBufferMemory_.resize(MAX_FRAMES_IN_FLIGHT);
+  drawCountBuffers_.resize(MAX_FRAMES_IN_FLIGHT);
+  drawCountBufferMemory_.resize(MAX_FRAMES_IN_FLIGHT);
+  drawCounts_.resize(MAX_FRAMES_IN_FLIGHT);
+  cullingDescriptorSets_.resize(MAX_FRAMES_IN_FLIGHT);
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    createBuffer(indirectSize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                     VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indirectBuffers_[i],
+                 indirectBufferMemory_[i]);
+
+    // Host visible, so the profiler can read how many draws survived
+    createBuffer(sizeof(CullingCounts),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                     VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 drawCountBuffers_[i], drawCountBufferMemory_[i]);
+    void* drawCount = nullptr;
+    vkMapMemory(device_, drawCountBufferMemory_[i], 0, sizeof(CullingCounts),
+                0, &drawCount);
+    *static_cast<CullingCounts*>(drawCount) = CullingCounts{};
+    drawCounts_[i] = static_cast<const CullingCounts*>(drawCount);
+
+    cullingDescriptorSets_[i] = descriptors_->allocate(layout.setLayouts[0]);
+
+    CullingDescriptors descriptors{};
+    descriptors.bounds = {boundsBuffer_, 0, VK_WHOLE_SIZE};
+    descriptors.records = {drawRecordBuffer_, 0, VK_WHOLE_SIZE};
+    descriptors.commands = {indirectBuffers_[i], 0, VK_WHOLE_SIZE};
+    descriptors.drawCount = {drawCountBuffers_[i], 0, VK_WHOLE_SIZE};
+    cullingUpdate_->update(cullingDescriptorSets_[i], &descriptors);
+  }
 
-  copyBuffer(stagingBuffer, indexBuffer_, bufferSize);
+  if (occlusionCullingSupported_) {
+    createOcclusionResources();
+  }
+}
 
-  vkDestroyBuffer(device_, stagingBuffer, nullptr);
-  vkFreeMemory(device_, stagingBufferMemory, nullptr);
+void Renderer::createOcclusionResources() {
+  // Everything starts out hidden, so the first frame draws all of it in the
+  // second phase
+  std::vector<uint32_t> visibility(instances_.size(), 0);
+  createDeviceLocalBuffer(visibility.data(),
+                          sizeof(visibility[0]) * visibility.size(),
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, visibilityBuffer_,
+                          visibilityBufferMemory_);
+
+  auto getEntry = [](uint32_t binding, VkDescriptorType type, size_t offset,
+                     size_t stride) {
+    VkDescriptorUpdateTemplateEntry entry{};
+    entry.dstBinding = binding;
+    entry.dstArrayElement = 0;
+    entry.descriptorCount = 1;
+    entry.descriptorType = type;
+    entry.offset = offset;
+    entry.stride = stride;
+    return entry;
+  };
+
+  occlusionPipeline_ = pipelines_->getCompute(occlusionCullingShader);
+  const PipelineLayoutInfo& occlusionLayout =
+      pipelines_->getComputeLayout(occlusionCullingShader);
+  occlusionPipelineLayout_ = occlusionLayout.layout;
+  occlusionSetLayout_ = occlusionLayout.setLayouts.at(0);
+
+  const VkDescriptorType storageBuffer = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  const size_t bufferStride = sizeof(VkDescriptorBufferInfo);
+  std::vector<VkDescriptorUpdateTemplateEntry> occlusionEntries{
+      getEntry(0, storageBuffer, offsetof(OcclusionDescriptors, bounds),
+               bufferStride),
+      getEntry(1, storageBuffer, offsetof(OcclusionDescriptors, records),
+               bufferStride),
+      getEntry(2, storageBuffer, offsetof(OcclusionDescriptors, commands),
+               bufferStride),
+      getEntry(3, storageBuffer, offsetof(OcclusionDescriptors, drawCount),
+               bufferStride),
+      getEntry(4, storageBuffer, offsetof(OcclusionDescriptors, visibility),
+               bufferStride),
+      getEntry(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+               offsetof(OcclusionDescriptors, pyramid),
+               sizeof(VkDescriptorImageInfo)),
+  };
+  occlusionUpdate_ = std::make_unique<DescriptorUpdateTemplate>(
+      device_, physicalDevice_, occlusionSetLayout_, occlusionEntries);
+
+  // Level 0 reads the depth buffer, every sample of it with MSAA. Both
+  // variants reflect to the same layout
+  hizPipeline_ = pipelines_->getCompute(hizShader);
+  hizMultisampledPipeline_ = pipelines_->getCompute(hizMultisampledShader);
+  const PipelineLayoutInfo& hizLayout = pipelines_->getComputeLayout(hizShader);
+  hizPipelineLayout_ = hizLayout.layout;
+  hizSetLayout_ = hizLayout.setLayouts.at(0);
+
+  std::vector<VkDescriptorUpdateTemplateEntry> hizEntries{
+      getEntry(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+               offsetof(HiZDescriptors, source),
+               sizeof(VkDescriptorImageInfo)),
+      getEntry(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+               offsetof(HiZDescriptors, destination),
+               sizeof(VkDescriptorImageInfo)),
+  };
+  hizUpdate_ = std::make_unique<DescriptorUpdateTemplate>(
+      device_, physicalDevice_, hizSetLayout_, hizEntries);
+
+  // Texels are compared as they are, never blended with their neighbours
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.minLod = 0.f;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  VkResult result =
+      vkCreateSampler(device_, &samplerInfo, nullptr, &hizSampler_);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to create Hi-Z sampler!");
+  }
+}
+
+void Renderer::createHistoryResources() {
+  // Filtered output, blended in linear space at more than 8 bits
+  const VkFormat historyFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+  for (size_t i = 0; i < 2; ++i) {
+    createImage(swapChainExtent_.width, swapChainExtent_.height, 1,
+                VK_SAMPLE_COUNT_1_BIT, historyFormat, VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, historyImages_[i],
+                historyImageMemory_[i]);
+    historyImageViews_[i] = createImageView(historyImages_[i], historyFormat,
+                                            VK_IMAGE_ASPECT_COLOR_BIT, 1);
+  }
+
+  historyValid_ = false;
+  historyUndefined_ = true;
+}
+
+void Renderer::createHiZResources() {
+  // The largest power of two that fits, so every level halves the last
+  auto floorPowerOfTwo = [](uint32_t value) {
+    uint32_t power = 1;
+    while (power * 2 <= value) {
+      power *= 2;
+    }
+    return power;
+  };
+  hizExtent_.width = floorPowerOfTwo(swapChainExtent_.width);
+  hizExtent_.height = floorPowerOfTwo(swapChainExtent_.height);
+  uint32_t mipLevels =
+      static_cast<uint32_t>(std::floor(
+          std::log2(std::max(hizExtent_.width, hizExtent_.height)))) +
+      1;
+
+  createImage(hizExtent_.width, hizExtent_.height, mipLevels,
+              VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R32_SFLOAT,
+              VK_IMAGE_TILING_OPTIMAL,
+              VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, hizImage_, hizImageMemory_);
+  hizImageView_ = createImageView(hizImage_, VK_FORMAT_R32_SFLOAT,
+                                  VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+
+  // Storage image views address a single level
+  hizMipViews_.resize(mipLevels);
+  for (uint32_t level = 0; level < mipLevels; ++level) {
+    hizMipViews_[level] = createImageView(hizImage_, VK_FORMAT_R32_SFLOAT,
+                                          VK_IMAGE_ASPECT_COLOR_BIT, 1, level);
+  }
 }
 
 void Renderer::createCommandPool() {
@@ -946,7 +2295,7 @@ void Renderer::createCommandPool() {
 
   VkCommandPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
   poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
   VkResult result =
@@ -957,50 +2306,79 @@ void Renderer::createCommandPool() {
 }
 
 void Renderer::createCommandBuffers() {
-  commandBuffers_.resize(MAX_FRAMES_IN_FLIGHT);
-
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.commandPool = commandPool_;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers_.size());
+  // The render thread records alongside the workers while it waits
+  uint32_t sliceCount = std::min(jobSystem_->getWorkerCount() + 1,
+                                 static_cast<uint32_t>(MAX_RECORD_SLICES));
 
-  VkResult result =
-      vkAllocateCommandBuffers(device_, &allocInfo, commandBuffers_.data());
-  if (VK_SUCCESS != result) {
-    throw std::runtime_error("Failed to allocate command buffers!");
-  }
-}
+  QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice_);
 
-void Renderer::createUniformBuffers() {
-  VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
-  uniformBuffers_.resize(MAX_FRAMES_IN_FLIGHT);
-  uniformBuffersMemory_.resize(MAX_FRAMES_IN_FLIGHT);
-  uniformBuffersMapped_.resize(MAX_FRAMES_IN_FLIGHT);
+  // The primary buffers, one per render graph batch, are allocated lazily
+  // by getBatchCommandBuffer
+  frameCommandPools_.resize(MAX_FRAMES_IN_FLIGHT);
+  commandBuffers_.assign(MAX_FRAMES_IN_FLIGHT, {});
+  computeCommandBuffers_.assign(MAX_FRAMES_IN_FLIGHT, {});
+  guiCommandBuffers_.resize(MAX_FRAMES_IN_FLIGHT);
+  sceneCommandPools_.resize(MAX_FRAMES_IN_FLIGHT);
+  sceneCommandBuffers_.resize(MAX_FRAMES_IN_FLIGHT);
+  recordedSceneVersions_.assign(MAX_FRAMES_IN_FLIGHT, 0);
 
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-    createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 uniformBuffers_[i], uniformBuffersMemory_[i]);
+    VkResult result = vkCreateCommandPool(device_, &poolInfo, nullptr,
+                                          &frameCommandPools_[i]);
+    if (VK_SUCCESS != result) {
+      throw std::runtime_error("Failed to create command pool!");
+    }
 
-    vkMapMemory(device_, uniformBuffersMemory_[i], 0, bufferSize, 0,
-                &uniformBuffersMapped_[i]);
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = frameCommandPools_[i];
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandBufferCount = 1;
+
+    result =
+        vkAllocateCommandBuffers(device_, &allocInfo, &guiCommandBuffers_[i]);
+    if (VK_SUCCESS != result) {
+      throw std::runtime_error("Failed to allocate command buffers!");
+    }
+
+    // One pool per draw slice; each slice is recorded by exactly one job, so
+    // no pool is ever used by two threads at once. The scene buffers are
+    // allocated lazily by recordSceneCommands
+    sceneCommandPools_[i].resize(sliceCount);
+    sceneCommandBuffers_[i].resize(sliceCount);
+    for (uint32_t t = 0; t < sliceCount; ++t) {
+      result = vkCreateCommandPool(device_, &poolInfo, nullptr,
+                                   &sceneCommandPools_[i][t]);
+      if (VK_SUCCESS != result) {
+        throw std::runtime_error("Failed to create command pool!");
+      }
+    }
   }
-}
 
-void Renderer::createTextureImage() {
-  int texWidth = 0;
-  int texHeight = 0;
-  int texChannels = 0;
-  stbi_uc* pixels = stbi_load(VK_RENDERER_TEXTURE_PATH, &texWidth, &texHeight,
-                              &texChannels, STBI_rgb_alpha);
-  VkDeviceSize imageSize = texWidth * texHeight * 4;
+  if (!asyncComputeSupported_) {
+    return;
+  }
 
-  if (!pixels) {
-    throw std::runtime_error("Failed to load texture image!");
+  poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily.value();
+  computeCommandPools_.resize(MAX_FRAMES_IN_FLIGHT);
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    VkResult result = vkCreateCommandPool(device_, &poolInfo, nullptr,
+                                          &computeCommandPools_[i]);
+    if (VK_SUCCESS != result) {
+      throw std::runtime_error("Failed to create command pool!");
+    }
   }
+}
+
+void Renderer::createTextureImage() {
+  int texWidth = textureWidth_;
+  int texHeight = textureHeight_;
+  VkDeviceSize imageSize = texturePixels_.size();
 
   mipLevels_ = static_cast<uint32_t>(
                    std::floor(std::log2(std::max(texWidth, texHeight)))) +
@@ -1016,10 +2394,11 @@ void Renderer::createTextureImage() {
 
   void* data = nullptr;
   vkMapMemory(device_, stagingBufferMemory, 0, imageSize, 0, &data);
-  memcpy(data, pixels, static_cast<size_t>(imageSize));
+  memcpy(data, texturePixels_.data(), static_cast<size_t>(imageSize));
   vkUnmapMemory(device_, stagingBufferMemory);
 
-  stbi_image_free(pixels);
+  texturePixels_.clear();
+  texturePixels_.shrink_to_fit();
 
   createImage(texWidth, texHeight, mipLevels_, VK_SAMPLE_COUNT_1_BIT,
               VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
@@ -1079,179 +2458,1493 @@ void Renderer::createTextureSampler() {
   }
 }
 
-void Renderer::createDescriptorPool() {
-  std::array<VkDescriptorPoolSize, 2> poolSizes{};
-  poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-  poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  poolSizes[1].descriptorCount =
-      static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT + 1);
+void Renderer::createUpscaleResources() {
+  // Dynamic resolution is a render graph pass
+  if (!dynamicRendering_) {
+    return;
+  }
+
+  const PipelineLayoutInfo& upscaleLayout =
+      pipelines_->getLayout(upscaleVertexShader, upscaleFragmentShader);
+  upscalePipelineLayout_ = upscaleLayout.layout;
+  upscaleSetLayout_ = upscaleLayout.setLayouts.at(0);
+
+  VkDescriptorUpdateTemplateEntry sceneEntry{};
+  sceneEntry.dstBinding = 0;
+  sceneEntry.dstArrayElement = 0;
+  sceneEntry.descriptorCount = 1;
+  sceneEntry.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  sceneEntry.offset = offsetof(UpscaleDescriptors, scene);
+  sceneEntry.stride = sizeof(VkDescriptorImageInfo);
+  upscaleUpdate_ = std::make_unique<DescriptorUpdateTemplate>(
+      device_, physicalDevice_, upscaleSetLayout_,
+      std::vector<VkDescriptorUpdateTemplateEntry>{sceneEntry});
+
+  upscalePipelines_[0] = pipelines_->build(getUpscalePipelineState(false));
+  upscalePipelines_[1] = pipelines_->build(getUpscalePipelineState(true));
+
+  // Bilinear taps, clamped to the rendered region by the shader. The
+  // anti-aliasing passes sample with it too
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.minLod = 0.f;
+  samplerInfo.maxLod = 0.f;
+
+  VkResult result =
+      vkCreateSampler(device_, &samplerInfo, nullptr, &upscaleSampler_);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to create upscale sampler!");
+  }
+}
+
+void Renderer::createAntiAliasingResources() {
+  // The post-process modes are render graph passes
+  if (!dynamicRendering_) {
+    return;
+  }
+
+  auto getEntry = [](uint32_t binding, VkDescriptorType type, size_t offset) {
+    VkDescriptorUpdateTemplateEntry entry{};
+    entry.dstBinding = binding;
+    entry.dstArrayElement = 0;
+    entry.descriptorCount = 1;
+    entry.descriptorType = type;
+    entry.offset = offset;
+    entry.stride = sizeof(VkDescriptorImageInfo);
+    return entry;
+  };
+  const VkDescriptorType sampledImage =
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  const VkDescriptorType storageImage = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+  fxaaPipeline_ = pipelines_->getCompute(fxaaShader);
+  const PipelineLayoutInfo& fxaaLayout =
+      pipelines_->getComputeLayout(fxaaShader);
+  fxaaPipelineLayout_ = fxaaLayout.layout;
+  fxaaSetLayout_ = fxaaLayout.setLayouts.at(0);
+
+  std::vector<VkDescriptorUpdateTemplateEntry> fxaaEntries{
+      getEntry(0, sampledImage, offsetof(FxaaDescriptors, scene)),
+      getEntry(1, storageImage, offsetof(FxaaDescriptors, destination)),
+  };
+  fxaaUpdate_ = std::make_unique<DescriptorUpdateTemplate>(
+      device_, physicalDevice_, fxaaSetLayout_, fxaaEntries);
+
+  if (!depthSamplingSupported_) {
+    return;
+  }
+
+  taaPipeline_ = pipelines_->getCompute(taaShader);
+  const PipelineLayoutInfo& taaLayout = pipelines_->getComputeLayout(taaShader);
+  taaPipelineLayout_ = taaLayout.layout;
+  taaSetLayout_ = taaLayout.setLayouts.at(0);
+
+  std::vector<VkDescriptorUpdateTemplateEntry> taaEntries{
+      getEntry(0, sampledImage, offsetof(TaaDescriptors, scene)),
+      getEntry(1, sampledImage, offsetof(TaaDescriptors, depth)),
+      getEntry(2, sampledImage, offsetof(TaaDescriptors, history)),
+      getEntry(3, storageImage, offsetof(TaaDescriptors, destination)),
+  };
+  taaUpdate_ = std::make_unique<DescriptorUpdateTemplate>(
+      device_, physicalDevice_, taaSetLayout_, taaEntries);
+}
+
+void Renderer::createLightingResources() {
+  lightBinningPipeline_ = pipelines_->getCompute(lightBinningShader);
+  const PipelineLayoutInfo& binningLayout =
+      pipelines_->getComputeLayout(lightBinningShader);
+  if (binningLayout.setLayouts.empty()) {
+    throw std::runtime_error(
+        "Light binning shader does not match the renderer!");
+  }
+  lightBinningPipelineLayout_ = binningLayout.layout;
+
+  // Binding 0 and 1 of both light_binning.comp and set 1 of shader.frag,
+  // which also samples the shadow map at binding 2
+  auto getEntries = [](uint32_t bindingCount) {
+    const size_t offsets[] = {offsetof(LightingDescriptors, lighting),
+                              offsetof(LightingDescriptors, clusters),
+                              offsetof(LightingDescriptors, shadowMap)};
+    std::vector<VkDescriptorUpdateTemplateEntry> entries{};
+    for (uint32_t binding = 0; binding < bindingCount; ++binding) {
+      bool image = 2 == binding;
+      VkDescriptorUpdateTemplateEntry entry{};
+      entry.dstBinding = binding;
+      entry.dstArrayElement = 0;
+      entry.descriptorCount = 1;
+      entry.descriptorType = image ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                   : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      entry.offset = offsets[binding];
+      entry.stride = image ? sizeof(VkDescriptorImageInfo)
+                           : sizeof(VkDescriptorBufferInfo);
+      entries.push_back(entry);
+    }
+    return entries;
+  };
+  lightingUpdate_ = std::make_unique<DescriptorUpdateTemplate>(
+      device_, physicalDevice_, lightingSetLayout_, getEntries(3));
+  lightBinningUpdate_ = std::make_unique<DescriptorUpdateTemplate>(
+      device_, physicalDevice_, binningLayout.setLayouts[0], getEntries(2));
+
+  // The header and lights are written by the host every frame, the
+  // clusters only by the binning pass
+  VkDeviceSize lightingSize =
+      sizeof(LightingHeader) + sizeof(PointLight) * maxLightCount;
+  VkDeviceSize clusterSize =
+      sizeof(uint32_t) * clusterCount * (1 + maxLightsPerCluster);
+
+  lightingBuffers_.resize(MAX_FRAMES_IN_FLIGHT);
+  lightingBufferMemory_.resize(MAX_FRAMES_IN_FLIGHT);
+  lightingData_.resize(MAX_FRAMES_IN_FLIGHT);
+  clusterBuffers_.resize(MAX_FRAMES_IN_FLIGHT);
+  clusterBufferMemory_.resize(MAX_FRAMES_IN_FLIGHT);
+  lightingDescriptorSets_.resize(MAX_FRAMES_IN_FLIGHT);
+  lightBinningDescriptorSets_.resize(MAX_FRAMES_IN_FLIGHT);
+  uploadedLightVersions_.assign(MAX_FRAMES_IN_FLIGHT, 0);
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    // Binned on one queue and shaded on the other
+    createBuffer(lightingSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 lightingBuffers_[i], lightingBufferMemory_[i], true);
+    void* lightingData = nullptr;
+    vkMapMemory(device_, lightingBufferMemory_[i], 0, lightingSize, 0,
+                &lightingData);
+    lightingData_[i] = static_cast<LightingHeader*>(lightingData);
+    *lightingData_[i] = LightingHeader{};
+
+    createBuffer(clusterSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, clusterBuffers_[i],
+                 clusterBufferMemory_[i]);
+
+    LightingDescriptors descriptors{};
+    descriptors.lighting = {lightingBuffers_[i], 0, VK_WHOLE_SIZE};
+    descriptors.clusters = {clusterBuffers_[i], 0, VK_WHOLE_SIZE};
+    descriptors.shadowMap = {shadowSampler_, shadowImageView_,
+                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+    lightingDescriptorSets_[i] = descriptors_->allocate(lightingSetLayout_);
+    lightingUpdate_->update(lightingDescriptorSets_[i], &descriptors);
+    lightBinningDescriptorSets_[i] =
+        descriptors_->allocate(binningLayout.setLayouts[0]);
+    lightBinningUpdate_->update(lightBinningDescriptorSets_[i], &descriptors);
+  }
+}
+
+void Renderer::createShadowResources() {
+  // Compared with linear filtering, so every lookup is a 2x2 PCF
+  shadowFormat_ = findSupportedFormat(
+      {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM}, VK_IMAGE_TILING_OPTIMAL,
+      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT |
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+  createImage(shadowMapSize, shadowMapSize, 1, VK_SAMPLE_COUNT_1_BIT,
+              shadowFormat_, VK_IMAGE_TILING_OPTIMAL,
+              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                  VK_IMAGE_USAGE_SAMPLED_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shadowImage_,
+              shadowImageMemory_, shadowCascadeCount);
+
+  // The scene samples the whole array, each cascade renders to its layer
+  auto createView = [this](VkImageViewType viewType, uint32_t firstLayer,
+                           uint32_t layerCount) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = shadowImage_;
+    viewInfo.viewType = viewType;
+    viewInfo.format = shadowFormat_;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = firstLayer;
+    viewInfo.subresourceRange.layerCount = layerCount;
+
+    VkImageView imageView = VK_NULL_HANDLE;
+    VkResult result =
+        vkCreateImageView(device_, &viewInfo, nullptr, &imageView);
+    if (VK_SUCCESS != result) {
+      throw std::runtime_error("Failed to create shadow map image view!");
+    }
+    return imageView;
+  };
+  shadowImageView_ =
+      createView(VK_IMAGE_VIEW_TYPE_2D_ARRAY, 0, shadowCascadeCount);
+  shadowLayerViews_.resize(shadowCascadeCount);
+  for (uint32_t i = 0; i < shadowCascadeCount; ++i) {
+    shadowLayerViews_[i] = createView(VK_IMAGE_VIEW_TYPE_2D, i, 1);
+  }
+
+  // The lighting sets bind the map whether or not shadows are on, and the
+  // render graph expects it in this layout between frames
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = shadowImage_;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = shadowCascadeCount;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                       0, nullptr, 1, &barrier);
+  endSingleTimeCommands(commandBuffer);
+
+  // Outside every cascade reads as lit
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+  samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+  samplerInfo.compareEnable = VK_TRUE;
+  samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  samplerInfo.minLod = 0.f;
+  samplerInfo.maxLod = 0.f;
+
+  VkResult result =
+      vkCreateSampler(device_, &samplerInfo, nullptr, &shadowSampler_);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to create shadow map sampler!");
+  }
+
+  if (shadowsSupported_) {
+    shadowPipeline_ = pipelines_->build(getShadowPipelineState());
+  }
+  shadowCascades_.invalidate();
+}
+
+void Renderer::createDescriptorPool() {
+  // ImGui frees its own sets, so it keeps a small pool of its own
+  std::array<VkDescriptorPoolSize, 1> poolSizes{};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = 16;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags |= VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = 16;
+
+  VkResult result = vkCreateDescriptorPool(device_, &poolInfo, nullptr,
+                                           &guiDescriptorPool_);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to create descriptor pool!");
+  }
+
+  // Long-lived sets, and sets that only live for one frame in flight
+  std::vector<DescriptorPoolRatio> ratios{
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.f},
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.f},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.f},
+      {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.f},
+  };
+  descriptors_ = std::make_unique<DescriptorAllocator>(device_, 16, ratios);
+  frameDescriptors_.clear();
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    frameDescriptors_.push_back(
+        std::make_unique<DescriptorAllocator>(device_, 64, ratios));
+  }
+}
+
+void Renderer::createDescriptorSets() {
+  VkDescriptorUpdateTemplateEntry textureEntry{};
+  textureEntry.dstBinding = 1;
+  textureEntry.dstArrayElement = 0;
+  textureEntry.descriptorCount = 1;
+  textureEntry.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  textureEntry.offset = offsetof(MaterialDescriptors, texture);
+  textureEntry.stride = sizeof(VkDescriptorImageInfo);
+
+  materialUpdate_ = std::make_unique<DescriptorUpdateTemplate>(
+      device_, physicalDevice_, descriptorSetLayout_,
+      std::vector<VkDescriptorUpdateTemplateEntry>{textureEntry});
+
+  // The texture never changes, so every frame in flight shares one set
+  descriptorSet_ = descriptors_->allocate(descriptorSetLayout_);
+
+  MaterialDescriptors material{};
+  material.texture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  material.texture.imageView = textureImageView_;
+  material.texture.sampler = textureSampler_;
+  materialUpdate_->update(descriptorSet_, &material);
+}
+
+void Renderer::createSyncObjects() {
+  imageAvailableSemaphores_.resize(MAX_FRAMES_IN_FLIGHT);
+  renderFinishiedSemephores_.resize(MAX_FRAMES_IN_FLIGHT);
+  inFlightFences_.resize(MAX_FRAMES_IN_FLIGHT);
+  // Created on first use, like the batches' command buffers
+  batchSemaphores_.assign(MAX_FRAMES_IN_FLIGHT, {});
+  fenceFrames_.assign(MAX_FRAMES_IN_FLIGHT, 0);
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    VkResult result = vkCreateSemaphore(device_, &semaphoreInfo, nullptr,
+                                        &imageAvailableSemaphores_[i]);
+    if (VK_SUCCESS != result) {
+      std::runtime_error("Failed to create semaphore!");
+    }
+
+    result = vkCreateSemaphore(device_, &semaphoreInfo, nullptr,
+                               &renderFinishiedSemephores_[i]);
+    if (VK_SUCCESS != result) {
+      std::runtime_error("Failed to create semaphore!");
+    }
+
+    result = vkCreateFence(device_, &fenceInfo, nullptr, &inFlightFences_[i]);
+    if (VK_SUCCESS != result) {
+      std::runtime_error("Failed to create fence!");
+    }
+  }
+}
+
+void Renderer::createQueryPools() {
+  queriesRecorded_.assign(MAX_FRAMES_IN_FLIGHT, false);
+  frameAntiAliasing_.assign(MAX_FRAMES_IN_FLIGHT, std::string{});
+  frameShadowCascades_.assign(MAX_FRAMES_IN_FLIGHT, 0);
+  frameBatchCounts_.assign(MAX_FRAMES_IN_FLIGHT, 0);
+  frameAsyncBatches_.assign(MAX_FRAMES_IN_FLIGHT, 0);
+  frameGPUCulling_.assign(MAX_FRAMES_IN_FLIGHT, false);
+  frameOcclusionCulling_.assign(MAX_FRAMES_IN_FLIGHT, false);
+
+  // Timestamps around the light binning, every shadow cascade and every
+  // submitted batch, per frame slot. The compute family counts as many bits
+  if (!timestampsSupported_) {
+    profiler_.setText("GPU timestamps", "unsupported");
+  } else {
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice_,
+                                             &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        physicalDevice_, &queueFamilyCount, queueFamilies.data());
+    uint32_t validBits =
+        queueFamilies[findQueueFamilies(physicalDevice_)
+                          .graphicsFamily.value()]
+            .timestampValidBits;
+    timestampPeriod_ = properties.limits.timestampPeriod;
+    timestampMask_ = 64 == validBits ? UINT64_MAX : (1ull << validBits) - 1;
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * timestampsPerFrame;
+
+    VkResult result = vkCreateQueryPool(device_, &queryPoolInfo, nullptr,
+                                        &timestampQueryPool_);
+    if (VK_SUCCESS != result) {
+      throw std::runtime_error("Failed to create query pool!");
+    }
+  }
+
+  if (!pipelineStatisticsSupported_) {
+    profiler_.setText("Pipeline statistics", "unsupported");
+    return;
+  }
+
+  // One query per batch of a frame slot, read back once its fence has
+  // signaled
+  VkQueryPoolCreateInfo queryPoolInfo{};
+  queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+  queryPoolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * maxFrameBatches;
+  queryPoolInfo.pipelineStatistics = sceneStatistics;
+
+  VkResult result = vkCreateQueryPool(device_, &queryPoolInfo, nullptr,
+                                      &statisticsQueryPool_);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to create query pool!");
+  }
+}
+
+void Renderer::recordCommandBuffers(uint32_t imageIndex,
+                                    const FrameSnapshot& snapshot) {
+  VkCommandBufferInheritanceInfo inheritanceInfo =
+      getGUIInheritanceInfo(imageIndex);
+  frameShadowCascades_[currentFrame_] = 0;
+
+  // Timing every frame's re-record shows how recording scales with the
+  // worker count
+  if (recordEveryFrame_) {
+    invalidateSceneCommands();
+  }
+
+  JobCounter sceneCounter{};
+  bool sceneChanged = recordedSceneVersions_[currentFrame_] != sceneVersion_;
+  auto sceneStart = std::chrono::steady_clock::now();
+  if (sceneChanged) {
+    uint32_t sliceCount =
+        static_cast<uint32_t>(sceneCommandPools_[currentFrame_].size());
+    for (uint32_t i = 0; i < sliceCount; ++i) {
+      jobSystem_->run([this, i] { recordSceneCommands(i); }, &sceneCounter);
+    }
+  }
+
+  try {
+    recordGUI(guiCommandBuffers_[currentFrame_], inheritanceInfo,
+              snapshot.gui);
+  } catch (...) {
+    jobSystem_->wait(sceneCounter);
+    throw;
+  }
+
+  jobSystem_->wait(sceneCounter);
+  if (sceneChanged) {
+    recordedSceneVersions_[currentFrame_] = sceneVersion_;
+    ++sceneRecordCount_;
+    // Includes the GUI, which the render thread records meanwhile
+    auto sceneEnd = std::chrono::steady_clock::now();
+    profiler_.setTime(
+        "Scene recording",
+        std::chrono::duration<double, std::milli>(sceneEnd - sceneStart)
+            .count());
+  }
+
+  // Dynamic rendering scene buffers do not depend on the swapchain image.
+  // Every slice lays down its depth before any slice shades
+  size_t sceneIndex = dynamicRendering_ ? 0 : imageIndex;
+  size_t framebufferCount =
+      dynamicRendering_ ? 1 : swapChainFrameBuffers_.size();
+  mainPassCommandBuffers_.clear();
+  if (activeSettings_.depthPrepass) {
+    for (const auto& threadCommandBuffers :
+         sceneCommandBuffers_[currentFrame_]) {
+      size_t prepassIndex = framebufferCount + sceneIndex;
+      if (prepassIndex < threadCommandBuffers.size() &&
+          VK_NULL_HANDLE != threadCommandBuffers[prepassIndex]) {
+        mainPassCommandBuffers_.push_back(threadCommandBuffers[prepassIndex]);
+      }
+    }
+  }
+  for (const auto& threadCommandBuffers : sceneCommandBuffers_[currentFrame_]) {
+    if (VK_NULL_HANDLE != threadCommandBuffers[sceneIndex]) {
+      mainPassCommandBuffers_.push_back(threadCommandBuffers[sceneIndex]);
+    }
+  }
+  // The render graph has a GUI pass of its own
+  if (!dynamicRendering_) {
+    mainPassCommandBuffers_.push_back(guiCommandBuffers_[currentFrame_]);
+  }
+
+  uint32_t batchCount = 1;
+  if (dynamicRendering_) {
+    // The graph emits every layout transition around the main pass
+    renderGraph_->setImportedImage(swapChainResource_,
+                                   swapChainImages_[imageIndex],
+                                   swapChainImageViews_[imageIndex]);
+    renderGraph_->setImportedBuffer(clusterResource_,
+                                    clusterBuffers_[currentFrame_]);
+    if (shadowGraph_) {
+      renderGraph_->setImportedImage(shadowResource_, shadowImage_,
+                                     shadowImageView_);
+    }
+    if (cullingGraph_ || occlusionGraph_) {
+      renderGraph_->setImportedBuffer(indirectResource_,
+                                      indirectBuffers_[currentFrame_]);
+      renderGraph_->setImportedBuffer(drawCountResource_,
+                                      drawCountBuffers_[currentFrame_]);
+    }
+    if (occlusionGraph_) {
+      renderGraph_->setImportedBuffer(visibilityResource_, visibilityBuffer_);
+    }
+    if (AntiAliasing::Taa == graphAntiAliasing_) {
+      swapHistory();
+    }
+    batchCount = renderGraph_->getBatchCount();
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = nullptr;
+
+  // Every batch is bracketed on its own queue and read back once the fence
+  // signals. Statistics only count the graphics batches, the others draw
+  // nothing
+  bool timestamps = VK_NULL_HANDLE != timestampQueryPool_;
+  bool statistics = VK_NULL_HANDLE != statisticsQueryPool_;
+  uint32_t asyncBatches = 0;
+  for (uint32_t i = 0; i < batchCount; ++i) {
+    bool async = dynamicRendering_ && RenderGraph::AsyncComputeQueue ==
+                                          renderGraph_->getBatchQueue(i);
+    VkCommandBuffer commandBuffer = getBatchCommandBuffer(i, async);
+
+    VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    if (VK_SUCCESS != result) {
+      throw std::runtime_error("Failed to begin recording command buffer!");
+    }
+
+    uint32_t timestampQuery =
+        currentFrame_ * timestampsPerFrame + firstBatchTimestamp + 2 * i;
+    if (timestamps) {
+      vkCmdResetQueryPool(commandBuffer, timestampQueryPool_, timestampQuery,
+                          2);
+      vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                          timestampQueryPool_, timestampQuery);
+    }
+    uint32_t statisticsQuery = currentFrame_ * maxFrameBatches + i;
+    if (statistics && !async) {
+      vkCmdResetQueryPool(commandBuffer, statisticsQueryPool_,
+                          statisticsQuery, 1);
+      vkCmdBeginQuery(commandBuffer, statisticsQueryPool_, statisticsQuery,
+                      0);
+    }
+
+    if (dynamicRendering_) {
+      if (!async && AntiAliasing::Taa == graphAntiAliasing_) {
+        recordHistoryInit(commandBuffer);
+      }
+      renderGraph_->execute(i, commandBuffer);
+    } else {
+      // The indirect draws recorded in the scene buffers read what this
+      // writes
+      if (activeSettings_.gpuCulling) {
+        recordCulling(commandBuffer);
+      }
+      recordLightBinning(commandBuffer);
+
+      VkBufferMemoryBarrier clusterBarrier{};
+      clusterBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      clusterBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+      clusterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      clusterBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      clusterBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      clusterBarrier.buffer = clusterBuffers_[currentFrame_];
+      clusterBarrier.offset = 0;
+      clusterBarrier.size = VK_WHOLE_SIZE;
+      vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+                           nullptr, 1, &clusterBarrier, 0, nullptr);
+
+      std::array<VkClearValue, 2> clearValues{};
+      clearValues[0].color = {{0.f, 0.f, 0.f, 1.f}};
+      clearValues[1].depthStencil = {1.f, 0};
+
+      VkRenderPassBeginInfo renderPassInfo{};
+      renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+      renderPassInfo.renderPass = renderPass_;
+      renderPassInfo.framebuffer = swapChainFrameBuffers_[imageIndex];
+      renderPassInfo.renderArea.offset = {0, 0};
+      renderPassInfo.renderArea.extent = swapChainExtent_;
+      renderPassInfo.clearValueCount =
+          static_cast<uint32_t>(clearValues.size());
+      renderPassInfo.pClearValues = clearValues.data();
+
+      vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                           VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+      vkCmdExecuteCommands(
+          commandBuffer, static_cast<uint32_t>(mainPassCommandBuffers_.size()),
+          mainPassCommandBuffers_.data());
+      vkCmdEndRenderPass(commandBuffer);
+    }
+
+    if (statistics && !async) {
+      vkCmdEndQuery(commandBuffer, statisticsQueryPool_, statisticsQuery);
+    }
+    if (timestamps) {
+      vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                          timestampQueryPool_, timestampQuery + 1);
+    }
+
+    result = vkEndCommandBuffer(commandBuffer);
+    if (VK_SUCCESS != result) {
+      throw std::runtime_error("Failed to record command buffer!");
+    }
+    if (async) {
+      asyncBatches |= 1u << i;
+    }
+  }
+  frameBatchCounts_[currentFrame_] = batchCount;
+  frameAsyncBatches_[currentFrame_] = asyncBatches;
+  queriesRecorded_[currentFrame_] = statistics || timestamps;
+  frameAntiAliasing_[currentFrame_] = antiAliasingName_;
+  frameGPUCulling_[currentFrame_] = cullingGraph_;
+  frameOcclusionCulling_[currentFrame_] = occlusionGraph_;
+
+  profiler_.setCounter("Draw calls", getSceneDrawCount());
+  profiler_.setCounter("Instances", instances_.size());
+  profiler_.setCounter("Worker threads", jobSystem_->getWorkerCount());
+  profiler_.setCounter("Scene re-records", sceneRecordCount_);
+  profiler_.setCounter("Recording slices",
+                       sceneCommandPools_[currentFrame_].size());
+}
+
+VkCommandBuffer Renderer::getBatchCommandBuffer(uint32_t batch, bool async) {
+  // Allocated the first time a graph splits into this many batches, and
+  // reset with their pool every frame
+  auto& commandBuffers = async ? computeCommandBuffers_[currentFrame_]
+                               : commandBuffers_[currentFrame_];
+  if (commandBuffers.size() <= batch) {
+    commandBuffers.resize(batch + 1, VK_NULL_HANDLE);
+  }
+  if (VK_NULL_HANDLE == commandBuffers[batch]) {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = async ? computeCommandPools_[currentFrame_]
+                                  : frameCommandPools_[currentFrame_];
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkResult result =
+        vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffers[batch]);
+    if (VK_SUCCESS != result) {
+      throw std::runtime_error("Failed to allocate command buffers!");
+    }
+  }
+
+  return commandBuffers[batch];
+}
+
+VkSemaphore Renderer::getBatchSemaphore(uint32_t batch) {
+  auto& semaphores = batchSemaphores_[currentFrame_];
+  if (semaphores.size() <= batch) {
+    semaphores.resize(batch + 1, VK_NULL_HANDLE);
+  }
+  if (VK_NULL_HANDLE == semaphores[batch]) {
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkResult result = vkCreateSemaphore(device_, &semaphoreInfo, nullptr,
+                                        &semaphores[batch]);
+    if (VK_SUCCESS != result) {
+      throw std::runtime_error("Failed to create semaphore!");
+    }
+  }
+
+  return semaphores[batch];
+}
+
+void Renderer::recordMainPass(VkCommandBuffer commandBuffer, bool first,
+                              bool last) {
+  // Occlusion culling renders the scene in two passes, the first one clears
+  // and the last one resolves
+  bool multisampled = VK_SAMPLE_COUNT_1_BIT != msaaSamples_;
+  VkImageView targetView = renderGraph_->getImageView(sceneTargetResource_);
+  VkAttachmentLoadOp loadOp =
+      first ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+  VkAttachmentStoreOp storeOp =
+      last ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+
+  VkRenderingAttachmentInfoKHR colorAttachment{};
+  colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.loadOp = loadOp;
+  colorAttachment.clearValue.color = {{0.f, 0.f, 0.f, 1.f}};
+  if (multisampled) {
+    colorAttachment.imageView = renderGraph_->getImageView(colorResource_);
+    colorAttachment.storeOp = storeOp;
+    if (last) {
+      colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT_KHR;
+      colorAttachment.resolveImageView = targetView;
+      colorAttachment.resolveImageLayout =
+          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+  } else {
+    colorAttachment.imageView = targetView;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  }
+
+  VkRenderingAttachmentInfoKHR depthAttachment{};
+  depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  depthAttachment.imageView = renderGraph_->getImageView(depthResource_);
+  depthAttachment.imageLayout =
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.loadOp = loadOp;
+  // TAA reprojects through the depth buffer
+  depthAttachment.storeOp = AntiAliasing::Taa == graphAntiAliasing_
+                                ? VK_ATTACHMENT_STORE_OP_STORE
+                                : storeOp;
+  depthAttachment.clearValue.depthStencil = {1.f, 0};
+
+  VkRenderingInfoKHR renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+  renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+  renderingInfo.renderArea.offset = {0, 0};
+  renderingInfo.renderArea.extent = renderExtent_;
+  renderingInfo.layerCount = 1;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachments = &colorAttachment;
+  renderingInfo.pDepthAttachment = &depthAttachment;
+
+  vkCmdBeginRenderingKHR_(commandBuffer, &renderingInfo);
+  vkCmdExecuteCommands(commandBuffer,
+                       static_cast<uint32_t>(mainPassCommandBuffers_.size()),
+                       mainPassCommandBuffers_.data());
+  vkCmdEndRenderingKHR_(commandBuffer);
+}
+
+void Renderer::recordUpscale(VkCommandBuffer commandBuffer) {
+  // Every pixel is written, so the old contents are not loaded
+  VkRenderingAttachmentInfoKHR colorAttachment{};
+  colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  colorAttachment.imageView = renderGraph_->getImageView(swapChainResource_);
+  colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+  VkRenderingInfoKHR renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+  renderingInfo.renderArea.offset = {0, 0};
+  renderingInfo.renderArea.extent = swapChainExtent_;
+  renderingInfo.layerCount = 1;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachments = &colorAttachment;
+
+  UpscaleDescriptors descriptors{};
+  descriptors.scene.sampler = upscaleSampler_;
+  descriptors.scene.imageView =
+      renderGraph_->getImageView(upscaleSourceResource_);
+  descriptors.scene.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkDescriptorSet descriptorSet =
+      frameDescriptors_[currentFrame_]->allocate(upscaleSetLayout_);
+  upscaleUpdate_->update(descriptorSet, &descriptors);
+
+  glm::vec2 extent(swapChainExtent_.width, swapChainExtent_.height);
+  UpscalePushConstants constants{};
+  constants.regionScale =
+      glm::vec2(renderExtent_.width, renderExtent_.height) / extent;
+  constants.texelSize = 1.f / extent;
+
+  VkViewport viewport{};
+  viewport.width = extent.x;
+  viewport.height = extent.y;
+  viewport.maxDepth = 1.f;
+
+  VkRect2D scissor{};
+  scissor.extent = swapChainExtent_;
+
+  vkCmdBeginRenderingKHR_(commandBuffer, &renderingInfo);
+  // Anti-aliasing alone leaves nothing to sharpen
+  bool sharpen = scaledGraph_ && activeSettings_.sharpenUpscale;
+  VkPipeline pipeline = pipelines_->get(upscalePipelines_[sharpen ? 1 : 0]);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          upscalePipelineLayout_, 0, 1, &descriptorSet, 0,
+                          nullptr);
+  vkCmdPushConstants(commandBuffer, upscalePipelineLayout_,
+                     VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants),
+                     &constants);
+  vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+  vkCmdEndRenderingKHR_(commandBuffer);
+}
+
+void Renderer::recordFxaa(VkCommandBuffer commandBuffer) {
+  FxaaDescriptors descriptors{};
+  descriptors.scene.sampler = upscaleSampler_;
+  descriptors.scene.imageView = renderGraph_->getImageView(sceneColorResource_);
+  descriptors.scene.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  descriptors.destination.imageView =
+      renderGraph_->getImageView(antiAliasedResource_);
+  descriptors.destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  VkDescriptorSet descriptorSet =
+      frameDescriptors_[currentFrame_]->allocate(fxaaSetLayout_);
+  fxaaUpdate_->update(descriptorSet, &descriptors);
+
+  FxaaPushConstants constants{};
+  constants.size = glm::ivec2(renderExtent_.width, renderExtent_.height);
+  constants.texelSize =
+      1.f / glm::vec2(swapChainExtent_.width, swapChainExtent_.height);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    fxaaPipeline_);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          fxaaPipelineLayout_, 0, 1, &descriptorSet, 0,
+                          nullptr);
+  vkCmdPushConstants(commandBuffer, fxaaPipelineLayout_,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+                     &constants);
+  vkCmdDispatch(
+      commandBuffer,
+      (renderExtent_.width + antiAliasingGroupSize - 1) / antiAliasingGroupSize,
+      (renderExtent_.height + antiAliasingGroupSize - 1) /
+          antiAliasingGroupSize,
+      1);
+}
+
+void Renderer::swapHistory() {
+  // Last frame's result becomes this frame's history
+  historyIndex_ ^= 1;
+  renderGraph_->setImportedImage(historyResource_,
+                                 historyImages_[historyIndex_ ^ 1],
+                                 historyImageViews_[historyIndex_ ^ 1]);
+  renderGraph_->setImportedImage(antiAliasedResource_,
+                                 historyImages_[historyIndex_],
+                                 historyImageViews_[historyIndex_]);
+}
+
+void Renderer::recordHistoryInit(VkCommandBuffer commandBuffer) {
+  if (!historyUndefined_) {
+    return;
+  }
+
+  // The graph expects the history in a read layout, which new images do
+  // not have yet. Their contents are ignored until the first resolve
+  std::array<VkImageMemoryBarrier, 2> barriers{};
+  for (size_t i = 0; i < barriers.size(); ++i) {
+    barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[i].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[i].image = historyImages_[i];
+    barriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barriers[i].subresourceRange.levelCount = 1;
+    barriers[i].subresourceRange.layerCount = 1;
+  }
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, static_cast<uint32_t>(barriers.size()),
+                       barriers.data());
+  historyUndefined_ = false;
+}
+
+void Renderer::recordTaa(VkCommandBuffer commandBuffer) {
+  TaaDescriptors descriptors{};
+  descriptors.scene.sampler = upscaleSampler_;
+  descriptors.scene.imageView = renderGraph_->getImageView(sceneColorResource_);
+  descriptors.scene.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  descriptors.depth.sampler = upscaleSampler_;
+  descriptors.depth.imageView = renderGraph_->getImageView(depthResource_);
+  descriptors.depth.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  descriptors.history.sampler = upscaleSampler_;
+  descriptors.history.imageView = renderGraph_->getImageView(historyResource_);
+  descriptors.history.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  descriptors.destination.imageView =
+      renderGraph_->getImageView(antiAliasedResource_);
+  descriptors.destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+  VkDescriptorSet descriptorSet =
+      frameDescriptors_[currentFrame_]->allocate(taaSetLayout_);
+  taaUpdate_->update(descriptorSet, &descriptors);
+
+  // Jitter left out on both sides, so a still camera maps every pixel onto
+  // itself and the history is never resampled
+  TaaPushConstants constants{};
+  constants.reprojection =
+      previousTransform_ * glm::inverse(unjitteredTransform_);
+  constants.size = glm::ivec2(renderExtent_.width, renderExtent_.height);
+  constants.texelSize =
+      1.f / glm::vec2(swapChainExtent_.width, swapChainExtent_.height);
+  constants.blend = historyValid_ ? taaBlend : 1.f;
+  previousTransform_ = unjitteredTransform_;
+  historyValid_ = true;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    taaPipeline_);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          taaPipelineLayout_, 0, 1, &descriptorSet, 0,
+                          nullptr);
+  vkCmdPushConstants(commandBuffer, taaPipelineLayout_,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+                     &constants);
+  vkCmdDispatch(
+      commandBuffer,
+      (renderExtent_.width + antiAliasingGroupSize - 1) / antiAliasingGroupSize,
+      (renderExtent_.height + antiAliasingGroupSize - 1) /
+          antiAliasingGroupSize,
+      1);
+}
+
+void Renderer::recordGUIPass(VkCommandBuffer commandBuffer) {
+  // Drawn over the finished scene at native resolution
+  VkRenderingAttachmentInfoKHR colorAttachment{};
+  colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+  colorAttachment.imageView = renderGraph_->getImageView(swapChainResource_);
+  colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+  VkRenderingInfoKHR renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+  renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+  renderingInfo.renderArea.offset = {0, 0};
+  renderingInfo.renderArea.extent = swapChainExtent_;
+  renderingInfo.layerCount = 1;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachments = &colorAttachment;
+
+  vkCmdBeginRenderingKHR_(commandBuffer, &renderingInfo);
+  vkCmdExecuteCommands(commandBuffer, 1, &guiCommandBuffers_[currentFrame_]);
+  vkCmdEndRenderingKHR_(commandBuffer);
+}
+
+void Renderer::recordCulling(VkCommandBuffer commandBuffer) {
+  VkBuffer drawCountBuffer = drawCountBuffers_[currentFrame_];
+  VkBuffer indirectBuffer = indirectBuffers_[currentFrame_];
+
+  vkCmdFillBuffer(commandBuffer, drawCountBuffer, 0, sizeof(uint32_t), 0);
+
+  VkBufferMemoryBarrier clearBarrier{};
+  clearBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  clearBarrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  clearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  clearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  clearBarrier.buffer = drawCountBuffer;
+  clearBarrier.offset = 0;
+  clearBarrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1,
+                       &clearBarrier, 0, nullptr);
+
+  // Same planes as the CPU path, in the space of the instance bounds
+  Frustum frustum = extractFrustum(sceneTransform_);
+  CullingPushConstants constants{};
+  std::copy(std::begin(frustum.planes), std::end(frustum.planes),
+            constants.planes);
+  constants.instanceCount = static_cast<uint32_t>(instances_.size());
+  constants.recordCount = static_cast<uint32_t>(drawCommands_.size());
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    cullingPipeline_);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          cullingPipelineLayout_, 0, 1,
+                          &cullingDescriptorSets_[currentFrame_], 0, nullptr);
+  vkCmdPushConstants(commandBuffer, cullingPipelineLayout_,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+                     &constants);
+  vkCmdDispatch(commandBuffer,
+                (constants.instanceCount + cullingGroupSize - 1) /
+                    cullingGroupSize,
+                1, 1);
+
+  // Consumed by the indirect draws, and by the host once the fence signals
+  std::array<VkBufferMemoryBarrier, 2> drawBarriers{};
+  for (auto& barrier : drawBarriers) {
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask =
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+  }
+  drawBarriers[0].buffer = indirectBuffer;
+  drawBarriers[1].buffer = drawCountBuffer;
+  vkCmdPipelineBarrier(
+      commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0,
+      nullptr, static_cast<uint32_t>(drawBarriers.size()),
+      drawBarriers.data(), 0, nullptr);
+}
+
+void Renderer::recordOcclusionCulling(VkCommandBuffer commandBuffer,
+                                      uint32_t phase) {
+  VkBuffer drawCountBuffer = drawCountBuffers_[currentFrame_];
+
+  // The first phase clears the statistics too, the second only the count
+  // the first phase's draws have consumed
+  vkCmdFillBuffer(commandBuffer, drawCountBuffer, 0,
+                  0 == phase ? VK_WHOLE_SIZE : sizeof(uint32_t), 0);
+
+  VkMemoryBarrier clearBarrier{};
+  clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  clearBarrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &clearBarrier, 0, nullptr, 0, nullptr);
+
+  OcclusionDescriptors descriptors{};
+  descriptors.bounds = {boundsBuffer_, 0, VK_WHOLE_SIZE};
+  descriptors.records = {drawRecordBuffer_, 0, VK_WHOLE_SIZE};
+  descriptors.commands = {indirectBuffers_[currentFrame_], 0, VK_WHOLE_SIZE};
+  descriptors.drawCount = {drawCountBuffer, 0, VK_WHOLE_SIZE};
+  descriptors.visibility = {visibilityBuffer_, 0, VK_WHOLE_SIZE};
+  descriptors.pyramid.sampler = hizSampler_;
+  descriptors.pyramid.imageView = hizImageView_;
+  descriptors.pyramid.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  VkDescriptorSet descriptorSet =
+      frameDescriptors_[currentFrame_]->allocate(occlusionSetLayout_);
+  occlusionUpdate_->update(descriptorSet, &descriptors);
+
+  OcclusionPushConstants constants{};
+  constants.viewProj = sceneTransform_;
+  constants.instanceCount = static_cast<uint32_t>(instances_.size());
+  constants.recordCount = static_cast<uint32_t>(drawCommands_.size());
+  constants.phase = phase;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    occlusionPipeline_);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          occlusionPipelineLayout_, 0, 1, &descriptorSet, 0,
+                          nullptr);
+  vkCmdPushConstants(commandBuffer, occlusionPipelineLayout_,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+                     &constants);
+  vkCmdDispatch(commandBuffer,
+                (constants.instanceCount + cullingGroupSize - 1) /
+                    cullingGroupSize,
+                1, 1);
+
+  // The statistics are read once the fence signals, after the second phase
+  if (1 == phase) {
+    VkMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0,
+                         nullptr, 0, nullptr);
+  }
+}
+
+void Renderer::recordHiZ(VkCommandBuffer commandBuffer) {
+  // Level 0 covers the rendered region alone, which keeps the pyramid in
+  // step with the clip space the culling pass projects into
+  VkExtent2D sourceExtent = renderExtent_;
+  for (uint32_t level = 0; level < hizMipViews_.size(); ++level) {
+    VkExtent2D extent{std::max(hizExtent_.width >> level, 1u),
+                      std::max(hizExtent_.height >> level, 1u)};
+
+    // Level 0 reads the depth buffer, every other level the one before it,
+    // which the previous dispatch has to finish writing first
+    HiZDescriptors descriptors{};
+    descriptors.source.sampler = hizSampler_;
+    if (0 == level) {
+      descriptors.source.imageView =
+          renderGraph_->getImageView(depthResource_);
+      descriptors.source.imageLayout =
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    } else {
+      descriptors.source.imageView = hizMipViews_[level - 1];
+      descriptors.source.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+      VkMemoryBarrier levelBarrier{};
+      levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+      levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                           &levelBarrier, 0, nullptr, 0, nullptr);
+    }
+    descriptors.destination.imageView = hizMipViews_[level];
+    descriptors.destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkDescriptorSet descriptorSet =
+        frameDescriptors_[currentFrame_]->allocate(hizSetLayout_);
+    hizUpdate_->update(descriptorSet, &descriptors);
+
+    HiZPushConstants constants{};
+    constants.sourceSize = glm::ivec2(sourceExtent.width, sourceExtent.height);
+    constants.destinationSize = glm::ivec2(extent.width, extent.height);
+
+    bool multisampled = 0 == level && VK_SAMPLE_COUNT_1_BIT != msaaSamples_;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      multisampled ? hizMultisampledPipeline_ : hizPipeline_);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            hizPipelineLayout_, 0, 1, &descriptorSet, 0,
+                            nullptr);
+    vkCmdPushConstants(commandBuffer, hizPipelineLayout_,
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+                       &constants);
+    vkCmdDispatch(commandBuffer,
+                  (extent.width + hizGroupSize - 1) / hizGroupSize,
+                  (extent.height + hizGroupSize - 1) / hizGroupSize, 1);
+
+    sourceExtent = extent;
+  }
+}
 
-  VkDescriptorPoolCreateInfo poolInfo{};
-  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  poolInfo.flags |= VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-  poolInfo.pPoolSizes = poolSizes.data();
-  poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT + 1);
+void Renderer::recordLightBinning(VkCommandBuffer commandBuffer) {
+  bool timestamps = VK_NULL_HANDLE != timestampQueryPool_;
+  uint32_t firstQuery = currentFrame_ * timestampsPerFrame;
+  if (timestamps) {
+    vkCmdResetQueryPool(commandBuffer, timestampQueryPool_, firstQuery, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        timestampQueryPool_, firstQuery);
+  }
 
-  VkResult result =
-      vkCreateDescriptorPool(device_, &poolInfo, nullptr, &descriptorPool_);
-  if (VK_SUCCESS != result) {
-    throw std::runtime_error("Failed to create descriptor pool!");
+  // Runs with no lights as well, which leaves every cluster empty
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    lightBinningPipeline_);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          lightBinningPipelineLayout_, 0, 1,
+                          &lightBinningDescriptorSets_[currentFrame_], 0,
+                          nullptr);
+  vkCmdDispatch(commandBuffer,
+                (clusterCount + lightBinningGroupSize - 1) /
+                    lightBinningGroupSize,
+                1, 1);
+
+  if (timestamps) {
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        timestampQueryPool_, firstQuery + 1);
   }
 }
 
-void Renderer::createDescriptorSets() {
-  std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT,
-                                             descriptorSetLayout_);
+void Renderer::recordShadows(VkCommandBuffer commandBuffer) {
+  VkPipeline pipeline = pipelines_->get(shadowPipeline_);
+  bool timestamps = VK_NULL_HANDLE != timestampQueryPool_;
+  uint32_t firstQuery =
+      currentFrame_ * timestampsPerFrame + firstShadowTimestamp;
 
-  VkDescriptorSetAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocInfo.descriptorPool = descriptorPool_;
-  allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-  allocInfo.pSetLayouts = layouts.data();
+  VkViewport viewport{};
+  viewport.x = 0.f;
+  viewport.y = 0.f;
+  viewport.width = static_cast<float>(shadowMapSize);
+  viewport.height = static_cast<float>(shadowMapSize);
+  viewport.minDepth = 0.f;
+  viewport.maxDepth = 1.f;
 
-  descriptorSets_.resize(MAX_FRAMES_IN_FLIGHT);
+  VkRect2D scissor{};
+  scissor.offset = {0, 0};
+  scissor.extent = {shadowMapSize, shadowMapSize};
 
-  VkResult result =
-      vkAllocateDescriptorSets(device_, &allocInfo, descriptorSets_.data());
-  if (VK_SUCCESS != result) {
-    throw std::runtime_error("Failed to allocate descriptor sets!");
+  if (timestamps) {
+    vkCmdResetQueryPool(commandBuffer, timestampQueryPool_, firstQuery,
+                        2 * shadowCascadeCount);
   }
+  for (uint32_t i = 0; i < shadowCascadeCount; ++i) {
+    // Cached cascades still write their queries, or none of the slot's
+    // results could be read back
+    if (timestamps) {
+      vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                          timestampQueryPool_, firstQuery + 2 * i);
+    }
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-    VkDescriptorBufferInfo bufferInfo{};
-    bufferInfo.buffer = uniformBuffers_[i];
-    bufferInfo.offset = 0;
-    bufferInfo.range = sizeof(UniformBufferObject);
-
-    VkDescriptorImageInfo imageInfo{};
-    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView = textureImageView_;
-    imageInfo.sampler = textureSampler_;
-
-    std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[0].dstSet = descriptorSets_[i];
-    descriptorWrites[0].dstBinding = 0;
-    descriptorWrites[0].dstArrayElement = 0;
-    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    descriptorWrites[0].descriptorCount = 1;
-    descriptorWrites[0].pBufferInfo = &bufferInfo;
-    descriptorWrites[0].pImageInfo = nullptr;
-    descriptorWrites[0].pTexelBufferView = nullptr;
-
-    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[1].dstSet = descriptorSets_[i];
-    descriptorWrites[1].dstBinding = 1;
-    descriptorWrites[1].dstArrayElement = 0;
-    descriptorWrites[1].descriptorType =
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorWrites[1].descriptorCount = 1;
-    descriptorWrites[1].pBufferInfo = nullptr;
-    descriptorWrites[1].pImageInfo = &imageInfo;
-    descriptorWrites[1].pTexelBufferView = nullptr;
-
-    vkUpdateDescriptorSets(device_,
-                           static_cast<uint32_t>(descriptorWrites.size()),
-                           descriptorWrites.data(), 0, nullptr);
+    if (shadowCascades_.isDue(i)) {
+      VkRenderingAttachmentInfoKHR depthAttachment{};
+      depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+      depthAttachment.imageView = shadowLayerViews_[i];
+      depthAttachment.imageLayout =
+          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+      depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+      depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+      depthAttachment.clearValue.depthStencil = {1.f, 0};
+
+      VkRenderingInfoKHR renderingInfo{};
+      renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+      renderingInfo.renderArea = scissor;
+      renderingInfo.layerCount = 1;
+      renderingInfo.colorAttachmentCount = 0;
+      renderingInfo.pDepthAttachment = &depthAttachment;
+
+      vkCmdBeginRenderingKHR_(commandBuffer, &renderingInfo);
+      if (VK_NULL_HANDLE != pipeline) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipeline);
+        VkBuffer vertexBuffers[] = {positionBuffer_, instanceBuffer_};
+        VkDeviceSize offsets[] = {0, 0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer_, 0,
+                             VK_INDEX_TYPE_UINT32);
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        // Always instanced, over the casters culled for this cascade
+        for (size_t command = 0; command < drawCommands_.size(); ++command) {
+          const DrawCommand& drawCommand = drawCommands_[command];
+          ObjectPushConstants constants{shadowCascades_.getMatrix(i),
+                                        drawModels_[command]};
+          vkCmdPushConstants(commandBuffer, pipelineLayout_,
+                             VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants),
+                             &constants);
+          for (const InstanceRun& run : shadowRuns_[i]) {
+            vkCmdDrawIndexed(commandBuffer, drawCommand.indexCount, run.count,
+                             drawCommand.firstIndex, drawCommand.vertexOffset,
+                             run.first);
+          }
+        }
+      }
+      vkCmdEndRenderingKHR_(commandBuffer);
+      frameShadowCascades_[currentFrame_] |= 1u << i;
+    }
+
+    if (timestamps) {
+      vkCmdWriteTimestamp(commandBuffer,
+                          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                          timestampQueryPool_, firstQuery + 2 * i + 1);
+    }
   }
 }
 
-void Renderer::createSyncObjects() {
-  imageAvailableSemaphores_.resize(MAX_FRAMES_IN_FLIGHT);
-  renderFinishiedSemephores_.resize(MAX_FRAMES_IN_FLIGHT);
-  inFlightFences_.resize(MAX_FRAMES_IN_FLIGHT);
+VkCommandBufferInheritanceInfo Renderer::getInheritanceInfo(
+    uint32_t imageIndex) {
+  VkCommandBufferInheritanceInfo inheritanceInfo{};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  if (dynamicRendering_) {
+    inheritanceInfo.pNext = &inheritanceRenderingInfo_;
+  } else {
+    inheritanceInfo.renderPass = renderPass_;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = swapChainFrameBuffers_[imageIndex];
+  }
+  if (VK_NULL_HANDLE != statisticsQueryPool_) {
+    inheritanceInfo.pipelineStatistics = sceneStatistics;
+  }
 
-  VkSemaphoreCreateInfo semaphoreInfo{};
-  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  return inheritanceInfo;
+}
 
-  VkFenceCreateInfo fenceInfo{};
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+VkCommandBufferInheritanceInfo Renderer::getGUIInheritanceInfo(
+    uint32_t imageIndex) {
+  VkCommandBufferInheritanceInfo inheritanceInfo =
+      getInheritanceInfo(imageIndex);
+  if (dynamicRendering_) {
+    inheritanceInfo.pNext = &guiInheritanceRenderingInfo_;
+  }
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-    VkResult result = vkCreateSemaphore(device_, &semaphoreInfo, nullptr,
-                                        &imageAvailableSemaphores_[i]);
-    if (VK_SUCCESS != result) {
-      std::runtime_error("Failed to create semaphore!");
-    }
+  return inheritanceInfo;
+}
 
-    result = vkCreateSemaphore(device_, &semaphoreInfo, nullptr,
-                               &renderFinishiedSemephores_[i]);
-    if (VK_SUCCESS != result) {
-      std::runtime_error("Failed to create semaphore!");
-    }
+void Renderer::recordSceneCommands(uint32_t sliceIndex) {
+  // The static scene is recorded once per swapchain image for the current
+  // frame slot and replayed until invalidateSceneCommands() is called. Only
+  // this frame slot's buffers are touched, and its fence has been waited on
+  VkCommandPool commandPool = sceneCommandPools_[currentFrame_][sliceIndex];
+  auto& commandBuffers = sceneCommandBuffers_[currentFrame_][sliceIndex];
+
+  vkResetCommandPool(device_, commandPool, 0);
+
+  size_t sceneDrawCount = getSceneDrawCount();
+  size_t sliceCount = sceneCommandPools_[currentFrame_].size();
+  size_t sliceSize = (sceneDrawCount + sliceCount - 1) / sliceCount;
+  size_t firstDraw = sliceIndex * sliceSize;
+  size_t drawCount = firstDraw < sceneDrawCount
+                         ? std::min(sliceSize, sceneDrawCount - firstDraw)
+                         : 0;
+
+  // Render pass buffers are tied to one framebuffer each, dynamic rendering
+  // needs a single buffer per slice. The depth pre-pass buffers follow them
+  size_t framebufferCount =
+      dynamicRendering_ ? 1 : swapChainFrameBuffers_.size();
+  size_t bufferCount =
+      framebufferCount * (activeSettings_.depthPrepass ? 2 : 1);
+
+  // Empty slices keep no buffers so they stay out of vkCmdExecuteCommands
+  bool allocated =
+      !commandBuffers.empty() && VK_NULL_HANDLE != commandBuffers[0];
+  if (allocated && (!drawCount || commandBuffers.size() != bufferCount)) {
+    vkFreeCommandBuffers(device_, commandPool,
+                         static_cast<uint32_t>(commandBuffers.size()),
+                         commandBuffers.data());
+    allocated = false;
+  }
+  if (!allocated) {
+    commandBuffers.assign(bufferCount, VK_NULL_HANDLE);
+  }
+  if (!drawCount) {
+    return;
+  }
 
-    result = vkCreateFence(device_, &fenceInfo, nullptr, &inFlightFences_[i]);
+  if (!allocated) {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+    VkResult result =
+        vkAllocateCommandBuffers(device_, &allocInfo, commandBuffers.data());
     if (VK_SUCCESS != result) {
-      std::runtime_error("Failed to create fence!");
+      throw std::runtime_error("Failed to allocate command buffers!");
     }
   }
+
+  for (size_t i = 0; i < commandBuffers.size(); ++i) {
+    VkCommandBufferInheritanceInfo inheritanceInfo =
+        getInheritanceInfo(static_cast<uint32_t>(i % framebufferCount));
+
+    recordDrawCommands(commandBuffers[i], inheritanceInfo, firstDraw,
+                       drawCount, i >= framebufferCount);
+  }
+}
+
+size_t Renderer::getSceneDrawCount() {
+  // A single indirect draw, the count comes from the culling pass
+  if (activeSettings_.gpuCulling) {
+    return 1;
+  }
+  if (activeSettings_.instancing) {
+    return drawCommands_.size() * visibleRuns_.size() * getDrawSplit();
+  }
+
+  return drawCommands_.size() * visibleInstances_.size() * getDrawSplit();
+}
+
+size_t Renderer::getDrawSplit() {
+  // With fewer draws than slices, as with a single instanced mesh, the
+  // index range of every draw is cut into pieces so every slice records
+  if (activeSettings_.gpuCulling) {
+    return 1;
+  }
+  size_t draws = drawCommands_.size() * (activeSettings_.instancing
+                                             ? visibleRuns_.size()
+                                             : visibleInstances_.size());
+  size_t sliceCount = sceneCommandPools_[currentFrame_].size();
+  return draws && draws < sliceCount ? sliceCount / draws : 1;
 }
 
-void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer,
-                                   uint32_t imageIndex) {
+void Renderer::recordDrawCommands(
+    VkCommandBuffer commandBuffer,
+    const VkCommandBufferInheritanceInfo& inheritanceInfo, size_t firstDraw,
+    size_t drawCount, bool depthOnly) {
   VkCommandBufferBeginInfo beginInfo{};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  beginInfo.flags = 0;
-  beginInfo.pInheritanceInfo = nullptr;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+  // Both occlusion culling phases replay the same indirect draw
+  if (activeSettings_.gpuCulling) {
+    beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+  }
 
   VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
   if (VK_SUCCESS != result) {
     throw std::runtime_error("Failed to begin recording command buffer!");
   }
 
-  VkRenderPassBeginInfo renderPassInfo{};
-  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-  renderPassInfo.renderPass = renderPass_;
-  renderPassInfo.framebuffer = swapChainFrameBuffers_[imageIndex];
-  renderPassInfo.renderArea.offset = {0, 0};
-  renderPassInfo.renderArea.extent = swapChainExtent_;
-
-  std::array<VkClearValue, 2> clearValues{};
-  clearValues[0].color = {{0.f, 0.f, 0.f, 1.f}};
-  clearValues[1].depthStencil = {1.f, 0};
-
-  renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-  renderPassInfo.pClearValues = clearValues.data();
-
-  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
-                       VK_SUBPASS_CONTENTS_INLINE);
-
-  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    graphicsPipeline_);
+  // Draws are skipped while no compatible pipeline exists yet
+  VkPipeline pipeline =
+      pipelines_->get(depthOnly ? depthPipeline_ : scenePipeline_);
+  if (VK_NULL_HANDLE == pipeline) {
+    drawCount = 0;
+  } else {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      pipeline);
+  }
 
-  VkBuffer vertexBuffers[] = {vertexBuffer_};
-  VkDeviceSize offsets[] = {0};
-  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+  // The depth-only pipeline reads positions alone
+  VkBuffer vertexBuffers[] = {depthOnly ? positionBuffer_ : vertexBuffer_,
+                              instanceBuffer_};
+  VkDeviceSize offsets[] = {0, 0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
 
   vkCmdBindIndexBuffer(commandBuffer, indexBuffer_, 0, VK_INDEX_TYPE_UINT32);
 
   VkViewport viewport{};
   viewport.x = 0.f;
   viewport.y = 0.f;
-  viewport.width = static_cast<float>(swapChainExtent_.width);
-  viewport.height = static_cast<float>(swapChainExtent_.height);
+  viewport.width = static_cast<float>(renderExtent_.width);
+  viewport.height = static_cast<float>(renderExtent_.height);
   viewport.minDepth = 0.f;
   viewport.maxDepth = 1.f;
   vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
   VkRect2D scissor{};
   scissor.offset = {0, 0};
-  scissor.extent = swapChainExtent_;
+  scissor.extent = renderExtent_;
   vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          pipelineLayout_, 0, 1,
-                          &descriptorSets_[currentFrame_], 0, nullptr);
+  // The lights are per frame in flight, like these command buffers
+  if (!depthOnly) {
+    VkDescriptorSet descriptorSets[] = {
+        descriptorSet_, lightingDescriptorSets_[currentFrame_]};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout_, 0, 2, descriptorSets, 0,
+                            nullptr);
+  }
+
+  if (activeSettings_.gpuCulling && drawCount) {
+    // One draw call covers every mesh part, all authored in model space,
+    // see loadModel()
+    ObjectPushConstants constants{sceneTransform_, glm::mat4(1.f)};
+    vkCmdPushConstants(commandBuffer, pipelineLayout_,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants),
+                       &constants);
+    vkCmdDrawIndexedIndirectCountKHR_(
+        commandBuffer, indirectBuffers_[currentFrame_], 0,
+        drawCountBuffers_[currentFrame_], 0, maxIndirectDraws_,
+        sizeof(VkDrawIndexedIndirectCommand));
+    drawCount = 0;
+  }
+
+  // Instanced, each mesh part is one draw per run of visible instances.
+  // Without instancing every visible instance of a part is its own draw,
+  // selected through firstInstance, so both modes run the same shaders on
+  // the same data. Split draws cover whole triangles of the part each
+  bool instancing = activeSettings_.instancing;
+  size_t drawsPerCommand =
+      instancing ? visibleRuns_.size() : visibleInstances_.size();
+  size_t split = getDrawSplit();
+  size_t pushedCommand = drawCommands_.size();
+  for (size_t i = firstDraw; i < firstDraw + drawCount; ++i) {
+    size_t draw = i / split;
+    size_t piece = i % split;
+    size_t command = draw / drawsPerCommand;
+    const DrawCommand& drawCommand = drawCommands_[command];
+    if (command != pushedCommand) {
+      ObjectPushConstants constants{sceneTransform_, drawModels_[command]};
+      vkCmdPushConstants(commandBuffer, pipelineLayout_,
+                         VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants),
+                         &constants);
+      pushedCommand = command;
+    }
+
+    uint32_t triangles = drawCommand.indexCount / 3;
+    uint32_t first = static_cast<uint32_t>(triangles * piece / split) * 3;
+    uint32_t end = static_cast<uint32_t>(triangles * (piece + 1) / split) * 3;
+    if (first == end) {
+      continue;
+    }
+    if (instancing) {
+      const InstanceRun& run = visibleRuns_[draw % drawsPerCommand];
+      vkCmdDrawIndexed(commandBuffer, end - first, run.count,
+                       drawCommand.firstIndex + first,
+                       drawCommand.vertexOffset, run.first);
+    } else {
+      vkCmdDrawIndexed(commandBuffer, end - first, 1,
+                       drawCommand.firstIndex + first,
+                       drawCommand.vertexOffset,
+                       visibleInstances_[draw % drawsPerCommand]);
+    }
+  }
+
+  result = vkEndCommandBuffer(commandBuffer);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to record command buffer!");
+  }
+}
 
-  vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices_.size()), 1, 0,
-                   0, 0);
+void Renderer::recordGUI(VkCommandBuffer commandBuffer,
+                         const VkCommandBufferInheritanceInfo& inheritanceInfo,
+                         const GUIFrame& frame) {
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                    VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
 
-  this->gui_->draw(commandBuffer);
+  VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+  if (VK_SUCCESS != result) {
+    throw std::runtime_error("Failed to begin recording command buffer!");
+  }
 
-  vkCmdEndRenderPass(commandBuffer);
+  this->gui_->draw(commandBuffer, frame);
 
   result = vkEndCommandBuffer(commandBuffer);
   if (VK_SUCCESS != result) {
@@ -1260,40 +3953,268 @@ void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer,
 }
 
 void Renderer::recreateSwapchain() {
-  int width = 0;
-  int height = 0;
-  this->window_->getFramebufferSize(&width, &height);
-  while (0 == width || 0 == height) {
-    if (this->window_->shouldClose()) {
+  // Wait out minimization; the main thread keeps pumping events meanwhile
+  uint64_t framebufferSize = this->framebufferSize_;
+  while (0 == (framebufferSize >> 32) || 0 == (framebufferSize & 0xffffffff)) {
+    if (this->stopRendering_) {
       return;
     }
-    this->window_->getFramebufferSize(&width, &height);
-    glfwWaitEvents();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    framebufferSize = this->framebufferSize_;
   }
 
-  vkDeviceWaitIdle(device_);
+  auto recreateStart = std::chrono::steady_clock::now();
 
-  cleanupSwapChain();
+  // Frames in flight keep rendering to the old objects, so they are retired
+  // instead of destroyed and the GPU is never drained
+  VkSwapchainKHR oldSwapChain = swapChain_;
+  retireSwapChain();
 
-  createSwapChain();
+  createSwapChain(oldSwapChain);
   createImageViews();
-  createColorResources();
-  createDepthResources();
+  if (dynamicRendering_) {
+    createRenderGraph();
+  } else {
+    createColorResources();
+    createDepthResources();
+  }
   createFramebuffers();
+
+  invalidateSceneCommands();
+
+  auto recreateEnd = std::chrono::steady_clock::now();
+  profiler_.setTime(
+      "Swapchain recreation",
+      std::chrono::duration<double, std::milli>(recreateEnd - recreateStart)
+          .count());
+  profiler_.setCounter("Swapchain recreations", ++swapchainRecreations_);
+}
+
+void Renderer::retireSwapChain() {
+  VkDevice device = device_;
+  VkSwapchainKHR swapChain = swapChain_;
+  VkImage colorImage = colorImage_;
+  VkDeviceMemory colorImageMemory = colorImageMemory_;
+  VkImageView colorImageView = colorImageView_;
+  VkImage depthImage = depthImage_;
+  VkDeviceMemory depthImageMemory = depthImageMemory_;
+  VkImageView depthImageView = depthImageView_;
+  std::vector<VkFramebuffer> framebuffers = std::move(swapChainFrameBuffers_);
+  std::vector<VkImageView> imageViews = std::move(swapChainImageViews_);
+  swapChainFrameBuffers_.clear();
+  swapChainImageViews_.clear();
+
+  retireRenderGraph();
+
+  // Every frame submitted so far may still reference these objects
+  deletionQueue_.push(submittedFrames_, [=]() mutable {
+    vkDestroyImageView(device, colorImageView, nullptr);
+    vkDestroyImage(device, colorImage, nullptr);
+    vkFreeMemory(device, colorImageMemory, nullptr);
+
+    vkDestroyImageView(device, depthImageView, nullptr);
+    vkDestroyImage(device, depthImage, nullptr);
+    vkFreeMemory(device, depthImageMemory, nullptr);
+
+    for (VkFramebuffer framebuffer : framebuffers) {
+      vkDestroyFramebuffer(device, framebuffer, nullptr);
+    }
+
+    for (VkImageView imageView : imageViews) {
+      vkDestroyImageView(device, imageView, nullptr);
+    }
+
+    vkDestroySwapchainKHR(device, swapChain, nullptr);
+  });
+}
+
+void Renderer::retireRenderGraph() {
+  VkDevice device = device_;
+  std::shared_ptr<RenderGraph> renderGraph = std::move(renderGraph_);
+  VkImage hizImage = hizImage_;
+  VkDeviceMemory hizImageMemory = hizImageMemory_;
+  VkImageView hizImageView = hizImageView_;
+  std::vector<VkImageView> hizMipViews = std::move(hizMipViews_);
+  hizImage_ = VK_NULL_HANDLE;
+  hizImageMemory_ = VK_NULL_HANDLE;
+  hizImageView_ = VK_NULL_HANDLE;
+  hizMipViews_.clear();
+  std::array<VkImage, 2> historyImages{historyImages_[0], historyImages_[1]};
+  std::array<VkDeviceMemory, 2> historyImageMemory{historyImageMemory_[0],
+                                                   historyImageMemory_[1]};
+  std::array<VkImageView, 2> historyImageViews{historyImageViews_[0],
+                                               historyImageViews_[1]};
+  for (size_t i = 0; i < historyImages.size(); ++i) {
+    historyImages_[i] = VK_NULL_HANDLE;
+    historyImageMemory_[i] = VK_NULL_HANDLE;
+    historyImageViews_[i] = VK_NULL_HANDLE;
+  }
+
+  deletionQueue_.push(submittedFrames_, [=]() mutable {
+    renderGraph.reset();
+
+    for (size_t i = 0; i < historyImages.size(); ++i) {
+      vkDestroyImageView(device, historyImageViews[i], nullptr);
+      vkDestroyImage(device, historyImages[i], nullptr);
+      vkFreeMemory(device, historyImageMemory[i], nullptr);
+    }
+
+    for (VkImageView imageView : hizMipViews) {
+      vkDestroyImageView(device, imageView, nullptr);
+    }
+    vkDestroyImageView(device, hizImageView, nullptr);
+    vkDestroyImage(device, hizImage, nullptr);
+    vkFreeMemory(device, hizImageMemory, nullptr);
+  });
+}
+
+uint64_t Renderer::getCompletedFrames() {
+  // A frame is complete once its fence signaled or the fence was waited on
+  // and reused by a later frame, so only unsignaled fences hold this back
+  uint64_t completedFrames = submittedFrames_;
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    if (VK_NOT_READY == vkGetFenceStatus(device_, inFlightFences_[i])) {
+      completedFrames = std::min(completedFrames, fenceFrames_[i]);
+    }
+  }
+
+  return completedFrames;
+}
+
+void Renderer::invalidateSceneCommands() { ++sceneVersion_; }
+
+void Renderer::updateTransforms(const FrameSnapshot& snapshot) {
+  auto start = std::chrono::steady_clock::now();
+
+  // View-projection is built once per frame instead of once per vertex
+  glm::mat4 transform = getProjection(
+      swapChainExtent_.width / static_cast<float>(swapChainExtent_.height));
+  multiply(transform, snapshot.view, transform);
+  multiply(transform, snapshot.model, transform);
+
+  // TAA shifts every frame by a different sub-pixel offset, so with it the
+  // scene is re-recorded every frame
+  unjitteredTransform_ = transform;
+  if (AntiAliasing::Taa == graphAntiAliasing_) {
+    const size_t jitterCount = sizeof(taaJitter) / sizeof(taaJitter[0]);
+    glm::vec2 jitter = taaJitter[jitterIndex_++ % jitterCount];
+    glm::mat4 jitterTransform(1.f);
+    jitterTransform[3][0] = jitter.x * 2.f / renderExtent_.width;
+    jitterTransform[3][1] = jitter.y * 2.f / renderExtent_.height;
+    multiply(jitterTransform, transform, transform);
+  }
+
+  // The transform and the visible instances are baked into the cached
+  // scene commands, so the scene is only re-recorded when it changes
+  if (0 != std::memcmp(&transform, &sceneTransform_, sizeof(transform))) {
+    sceneTransform_ = transform;
+    if (!activeSettings_.gpuCulling) {
+      cullInstances();
+    }
+    invalidateSceneCommands();
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  profiler_.setTime(
+      "Transform update",
+      std::chrono::duration<double, std::milli>(end - start).count());
 }
 
-void Renderer::updateUniformBuffer(uint32_t currentFrame) {
-  UniformBufferObject ubo{};
-  ubo.model = glm::mat4(1.f);
-  ubo.view = glm::lookAt(glm::vec3(2.f, 2.f, 2.f), glm::vec3(0.f, 0.f, 0.f),
-                         glm::vec3(0.f, 0.f, 1.f));
-  ubo.proj = glm::perspective(
-      glm::radians(45.f),
-      swapChainExtent_.width / static_cast<float>(swapChainExtent_.height),
-      0.1f, 10.f);
-  ubo.proj[1][1] *= -1.f;
+void Renderer::updateShadows(const FrameSnapshot& snapshot) {
+  if (!shadowGraph_) {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  glm::mat4 view(1.f);
+  multiply(snapshot.view, snapshot.model, view);
+  glm::mat4 proj = getProjection(
+      swapChainExtent_.width / static_cast<float>(swapChainExtent_.height));
+  shadowCascades_.update(view, proj, getSunDirection(activeSettings_),
+                         sceneBounds_, activeSettings_.shadowCaching,
+                         activeSettings_.shadowUpdateBudget);
+
+  // Instance bounds are in scene space, like the cascades. The depth range
+  // of each cascade already spans the whole scene
+  uint32_t renderedCascades = 0;
+  for (uint32_t i = 0; i < shadowCascadeCount; ++i) {
+    if (!shadowCascades_.isDue(i)) {
+      continue;
+    }
+    Frustum frustum = extractFrustum(shadowCascades_.getMatrix(i));
+    cullSpheres(*jobSystem_, frustum, instanceBounds_, shadowCasters_);
+    buildInstanceRuns(shadowCasters_, shadowRuns_[i]);
+    ++renderedCascades;
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  profiler_.setTime(
+      "Shadow cascade update",
+      std::chrono::duration<double, std::milli>(end - start).count());
+  profiler_.setCounter("Shadow cascades rendered", renderedCascades);
+  uint64_t lookups = shadowCascades_.getHits() + shadowCascades_.getMisses();
+  if (lookups) {
+    profiler_.setCounter("Shadow cache hit rate (%)",
+                         shadowCascades_.getHits() * 100 / lookups);
+  }
+}
 
-  memcpy(uniformBuffersMapped_[currentFrame], &ubo, sizeof(ubo));
+void Renderer::updateLighting(const FrameSnapshot& snapshot) {
+  // This slot's fence has signaled, so its buffer is no longer read. The
+  // lights only change with their count, so each slot copies them once
+  LightingHeader& header = *lightingData_[currentFrame_];
+  if (uploadedLightVersions_[currentFrame_] != lightsVersion_) {
+    std::copy(lights_.begin(), lights_.end(),
+              reinterpret_cast<PointLight*>(&header + 1));
+    uploadedLightVersions_[currentFrame_] = lightsVersion_;
+  }
+
+  // Clusters are binned without the TAA jitter, a fraction of a pixel
+  glm::mat4 proj = getProjection(
+      swapChainExtent_.width / static_cast<float>(swapChainExtent_.height));
+  glm::vec2 extent(renderExtent_.width, renderExtent_.height);
+  float depthRange = std::log(farPlane / nearPlane);
+
+  multiply(snapshot.view, snapshot.model, header.view);
+  header.camera = glm::inverse(header.view)[3];
+  header.projection = glm::vec4(proj[0][0], proj[1][1], nearPlane, farPlane);
+  header.tiles = glm::vec4(
+      extent, extent / glm::vec2(clusterGridX, clusterGridY));
+  header.slicing = glm::vec2(clusterGridZ / depthRange,
+                             -std::log(nearPlane) * clusterGridZ / depthRange);
+  header.lightCount = static_cast<uint32_t>(lights_.size());
+
+  // Each cascade is sampled with the matrix its map was rendered with
+  header.shadowCascadeMask = 0;
+  header.sunDirection = glm::vec4(0.f);
+  if (shadowGraph_) {
+    for (uint32_t i = 0; i < shadowCascadeCount; ++i) {
+      if (shadowCascades_.isValid(i)) {
+        header.shadowCascadeMask |= 1u << i;
+        header.shadowMatrices[i] = shadowCascades_.getMatrix(i);
+        header.shadowTexelSizes[i] = shadowCascades_.getTexelSize(i);
+      }
+    }
+    header.sunDirection = glm::vec4(getSunDirection(activeSettings_), 1.f);
+  }
+}
+
+void Renderer::cullInstances() {
+  auto start = std::chrono::steady_clock::now();
+
+  // Instance bounds are in the space of the scene transform. Mesh parts are
+  // culled with their instance, their own transforms are identity
+  Frustum frustum = extractFrustum(sceneTransform_);
+  cullSpheres(*jobSystem_, frustum, instanceBounds_, visibleInstances_);
+  buildInstanceRuns(visibleInstances_, visibleRuns_);
+
+  auto end = std::chrono::steady_clock::now();
+  profiler_.setTime(
+      "Frustum culling",
+      std::chrono::duration<double, std::milli>(end - start).count());
+  profiler_.setCounter("Visible instances", visibleInstances_.size());
+  profiler_.setText("Culling instruction set", getCullingInstructionSet());
 }
 
 std::vector<const char*> Renderer::getRequiredExtensions() {
@@ -1354,7 +4275,8 @@ void Renderer::populateDebugMessengerCreateInfo(
 bool Renderer::isDeviceSuitable(VkPhysicalDevice device) {
   QueueFamilyIndices indices = findQueueFamilies(device);
 
-  bool extensionSupported = checkDeviceExtensionSupport(device);
+  bool extensionSupported =
+      checkDeviceExtensionSupport(device, deviceExtensions);
 
   bool swapChainAdequate = false;
   if (extensionSupported) {
@@ -1402,12 +4324,33 @@ VkSurfaceFormatKHR Renderer::chooseSwapSurfaceFormat(
 
 VkPresentModeKHR Renderer::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR>& availablePresentModes) {
+  VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+  switch (activeSettings_.presentMode) {
+    case PresentMode::Fifo:
+      requestedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+      break;
+    case PresentMode::FifoRelaxed:
+      requestedPresentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+      break;
+    case PresentMode::Mailbox:
+      requestedPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+      break;
+    case PresentMode::Immediate:
+      requestedPresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+      break;
+  }
+
   for (const auto& availablePresentMode : availablePresentModes) {
-    if (VK_PRESENT_MODE_MAILBOX_KHR == availablePresentMode) {
+    if (requestedPresentMode == availablePresentMode) {
+      profiler_.setText("Present mode",
+                        getPresentModeName(activeSettings_.presentMode));
       return availablePresentMode;
     }
   }
 
+  // FIFO is the only mode every implementation has to support
+  std::string requestedName = getPresentModeName(activeSettings_.presentMode);
+  profiler_.setText("Present mode", "fifo (" + requestedName + " unsupported)");
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -1417,12 +4360,10 @@ VkExtent2D Renderer::chooseSwapExtent(
       std::numeric_limits<uint32_t>::max()) {
     return capabilities.currentExtent;
   } else {
-    int width = 0;
-    int height = 0;
-    this->window_->getFramebufferSize(&width, &height);
+    uint64_t framebufferSize = this->framebufferSize_;
 
-    VkExtent2D actualExtent{static_cast<uint32_t>(width),
-                            static_cast<uint32_t>(height)};
+    VkExtent2D actualExtent{static_cast<uint32_t>(framebufferSize >> 32),
+                            static_cast<uint32_t>(framebufferSize)};
     actualExtent.width =
         std::clamp(actualExtent.width, capabilities.minImageExtent.width,
                    capabilities.maxImageExtent.width);
@@ -1434,24 +4375,14 @@ VkExtent2D Renderer::chooseSwapExtent(
   }
 }
 
-VkShaderModule Renderer::createShaderModule(const std::vector<char>& code) {
-  VkShaderModule shaderModule{};
-
-  VkShaderModuleCreateInfo createInfo{};
-  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-  VkResult result =
-      vkCreateShaderModule(device_, &createInfo, nullptr, &shaderModule);
-  if (VK_SUCCESS != result) {
-    throw std::runtime_error("Failed to create shader module!");
+void Renderer::cleanupSwapChain() {
+  for (VkImageView imageView : hizMipViews_) {
+    vkDestroyImageView(device_, imageView, nullptr);
   }
+  vkDestroyImageView(device_, hizImageView_, nullptr);
+  vkDestroyImage(device_, hizImage_, nullptr);
+  vkFreeMemory(device_, hizImageMemory_, nullptr);
 
-  return shaderModule;
-}
-
-void Renderer::cleanupSwapChain() {
   vkDestroyImageView(device_, colorImageView_, nullptr);
   vkDestroyImage(device_, colorImage_, nullptr);
   vkFreeMemory(device_, colorImageMemory_, nullptr);
@@ -1473,12 +4404,21 @@ void Renderer::cleanupSwapChain() {
 
 void Renderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                             VkMemoryPropertyFlags properties, VkBuffer& buffer,
-                            VkDeviceMemory& bufferMemory) {
+                            VkDeviceMemory& bufferMemory, bool shared) {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
   bufferInfo.usage = usage;
   bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  uint32_t queueFamilies[2]{};
+  if (shared && asyncComputeSupported_) {
+    QueueFamilyIndices indices = findQueueFamilies(physicalDevice_);
+    queueFamilies[0] = indices.graphicsFamily.value();
+    queueFamilies[1] = indices.computeFamily.value();
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = 2;
+    bufferInfo.pQueueFamilyIndices = queueFamilies;
+  }
 
   VkResult result = vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer);
   if (VK_SUCCESS != result) {
@@ -1515,11 +4455,39 @@ void Renderer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer,
   endSingleTimeCommands(commandBuffer);
 }
 
+void Renderer::createDeviceLocalBuffer(const void* data, VkDeviceSize size,
+                                       VkBufferUsageFlags usage,
+                                       VkBuffer& buffer,
+                                       VkDeviceMemory& bufferMemory,
+                                       bool shared) {
+  VkBuffer stagingBuffer{};
+  VkDeviceMemory stagingBufferMemory{};
+  createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               stagingBuffer, stagingBufferMemory);
+
+  void* mapped = nullptr;
+  vkMapMemory(device_, stagingBufferMemory, 0, size, 0, &mapped);
+  memcpy(mapped, data, static_cast<size_t>(size));
+  vkUnmapMemory(device_, stagingBufferMemory);
+
+  createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory,
+               shared);
+
+  copyBuffer(stagingBuffer, buffer, size);
+
+  vkDestroyBuffer(device_, stagingBuffer, nullptr);
+  vkFreeMemory(device_, stagingBufferMemory, nullptr);
+}
+
 void Renderer::createImage(uint32_t width, uint32_t height, uint32_t mipLevels,
                            VkSampleCountFlagBits numSamples, VkFormat format,
                            VkImageTiling tiling, VkImageUsageFlags usage,
                            VkMemoryPropertyFlags properties, VkImage& image,
-                           VkDeviceMemory& imageMemory) {
+                           VkDeviceMemory& imageMemory,
+                           uint32_t arrayLayers) {
   VkImageCreateInfo imageInfo{};
   imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
   imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -1527,7 +4495,7 @@ void Renderer::createImage(uint32_t width, uint32_t height, uint32_t mipLevels,
   imageInfo.extent.height = static_cast<uint32_t>(height);
   imageInfo.extent.depth = 1;
   imageInfo.mipLevels = mipLevels;
-  imageInfo.arrayLayers = 1;
+  imageInfo.arrayLayers = arrayLayers;
   imageInfo.format = format;
   imageInfo.tiling = tiling;
   imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -1727,14 +4695,15 @@ void Renderer::generateMipMaps(VkImage image, VkFormat imageFormat,
 
 VkImageView Renderer::createImageView(VkImage image, VkFormat format,
                                       VkImageAspectFlags aspectFlags,
-                                      uint32_t mipLevels) {
+                                      uint32_t mipLevels,
+                                      uint32_t baseMipLevel) {
   VkImageViewCreateInfo viewInfo{};
   viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
   viewInfo.image = image;
   viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
   viewInfo.format = format;
   viewInfo.subresourceRange.aspectMask = aspectFlags;
-  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
   viewInfo.subresourceRange.levelCount = mipLevels;
   viewInfo.subresourceRange.baseArrayLayer = 0;
   viewInfo.subresourceRange.layerCount = 1;
@@ -1761,22 +4730,10 @@ bool Renderer::hasStencilComponent(VkFormat format) {
          format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
-VkSampleCountFlagBits Renderer::getMaxUsableSampleCount() {
-  VkPhysicalDeviceProperties physicalDeviceProperties{};
-  vkGetPhysicalDeviceProperties(physicalDevice_, &physicalDeviceProperties);
-
+VkSampleCountFlagBits Renderer::getUsableSampleCount(uint32_t requested) {
+  // The largest count up to the requested one, which is at most 8
   VkSampleCountFlags counts =
-      physicalDeviceProperties.limits.framebufferColorSampleCounts &
-      physicalDeviceProperties.limits.framebufferDepthSampleCounts;
-  if (counts & VK_SAMPLE_COUNT_64_BIT) {
-    return VK_SAMPLE_COUNT_64_BIT;
-  }
-  if (counts & VK_SAMPLE_COUNT_32_BIT) {
-    return VK_SAMPLE_COUNT_64_BIT;
-  }
-  if (counts & VK_SAMPLE_COUNT_16_BIT) {
-    return VK_SAMPLE_COUNT_16_BIT;
-  }
+      framebufferSampleCounts_ & ((std::clamp(requested, 1u, 8u) << 1) - 1);
   if (counts & VK_SAMPLE_COUNT_8_BIT) {
     return VK_SAMPLE_COUNT_8_BIT;
   }
@@ -1816,18 +4773,35 @@ QueueFamilyIndices Renderer::findQueueFamilies(VkPhysicalDevice device) {
     ++i;
   }
 
+  // A family without graphics runs beside the graphics queue rather than
+  // time-slicing with it. Its timestamps line up with the graphics ones
+  uint32_t graphicsBits =
+      indices.graphicsFamily
+          ? queueFamilies[indices.graphicsFamily.value()].timestampValidBits
+          : 0;
+  for (uint32_t j = 0; j < queueFamilyCount; ++j) {
+    const VkQueueFamilyProperties& queueFamily = queueFamilies[j];
+    if ((queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+        !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+        queueFamily.timestampValidBits >= graphicsBits) {
+      indices.computeFamily = j;
+      break;
+    }
+  }
+
   return indices;
 }
 
-bool Renderer::checkDeviceExtensionSupport(VkPhysicalDevice device) {
+bool Renderer::checkDeviceExtensionSupport(
+    VkPhysicalDevice device, const std::vector<const char*>& extensions) {
   uint32_t extensionCount = 0;
   vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
                                        nullptr);
   std::vector<VkExtensionProperties> availableExtensions(extensionCount);
   vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
                                        availableExtensions.data());
-  std::set<std::string> requiredExtensions(deviceExtensions.begin(),
-                                           deviceExtensions.end());
+  std::set<std::string> requiredExtensions(extensions.begin(),
+                                           extensions.end());
 
   for (const auto& extension : availableExtensions) {
     requiredExtensions.erase(extension.extensionName);
@@ -1836,6 +4810,137 @@ bool Renderer::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool Renderer::checkPresentWaitSupport(VkPhysicalDevice device) {
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(device, &properties);
+  if (properties.apiVersion < VK_API_VERSION_1_1) {
+    return false;
+  }
+
+  if (!checkDeviceExtensionSupport(device, presentWaitExtensions)) {
+    return false;
+  }
+
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+  presentIdFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+  presentWaitFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  presentWaitFeatures.pNext = &presentIdFeatures;
+
+  VkPhysicalDeviceFeatures2 features{};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &presentWaitFeatures;
+  vkGetPhysicalDeviceFeatures2(device, &features);
+
+  return presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+}
+
+bool Renderer::checkDynamicRenderingSupport(VkPhysicalDevice device) {
+  // Both core in 1.3; the extensions rely on 1.2 core for their dependencies.
+  // The render graph records its barriers with synchronization2
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(device, &properties);
+  if (properties.apiVersion < VK_API_VERSION_1_2 ||
+      (properties.apiVersion < VK_API_VERSION_1_3 &&
+       !checkDeviceExtensionSupport(
+           device, {VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+                    VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME}))) {
+    return false;
+  }
+
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+  dynamicRenderingFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+  VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+  synchronization2Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+  synchronization2Features.pNext = &dynamicRenderingFeatures;
+
+  VkPhysicalDeviceFeatures2 features{};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &synchronization2Features;
+  vkGetPhysicalDeviceFeatures2(device, &features);
+
+  return dynamicRenderingFeatures.dynamicRendering &&
+         synchronization2Features.synchronization2;
+}
+
+bool Renderer::checkGPUCullingSupport(VkPhysicalDevice device) {
+  // The pass writes one draw per visible instance and part, and a count that
+  // vkCmdDrawIndexedIndirectCount reads: core in 1.2 behind a feature bit,
+  // an extension before that
+  VkPhysicalDeviceFeatures supportedFeatures{};
+  vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+  if (!supportedFeatures.multiDrawIndirect ||
+      !supportedFeatures.drawIndirectFirstInstance) {
+    return false;
+  }
+
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(device, &properties);
+  if (properties.apiVersion < VK_API_VERSION_1_2) {
+    return checkDeviceExtensionSupport(
+        device, {VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME});
+  }
+
+  VkPhysicalDeviceVulkan12Features vulkan12Features{};
+  vulkan12Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+  VkPhysicalDeviceFeatures2 features{};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &vulkan12Features;
+  vkGetPhysicalDeviceFeatures2(device, &features);
+
+  return vulkan12Features.drawIndirectCount;
+}
+
+bool Renderer::checkPipelineStatisticsSupport(VkPhysicalDevice device) {
+  VkPhysicalDeviceFeatures supportedFeatures{};
+  vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+
+  return supportedFeatures.pipelineStatisticsQuery &&
+         supportedFeatures.inheritedQueries;
+}
+
+bool Renderer::checkTimestampSupport(VkPhysicalDevice device) {
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(device, &properties);
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
+                                           nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
+                                           queueFamilies.data());
+
+  return 0 < queueFamilies[findQueueFamilies(device).graphicsFamily.value()]
+                 .timestampValidBits &&
+         0.f < properties.limits.timestampPeriod;
+}
+
+bool Renderer::checkDepthSamplingSupport() {
+  // The Hi-Z pyramid and TAA sample the depth buffer. Its views and barriers
+  // cover depth alone, which needs a format without stencil
+  VkFormat depthFormat = findDepthFormat();
+  if (hasStencilComponent(depthFormat)) {
+    return false;
+  }
+
+  VkFormatProperties formatProperties{};
+  vkGetPhysicalDeviceFormatProperties(physicalDevice_, depthFormat,
+                                      &formatProperties);
+  if (!(formatProperties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+    return false;
+  }
+
+  return true;
+}
+
 SwapChainSupportDetails Renderer::querySwapChainSupprt(
     VkPhysicalDevice device) {
   SwapChainSupportDetails details{};
@@ -1964,22 +5069,6 @@ VKAPI_ATTR VkBool32 VKAPI_CALL Renderer::debugCallback(
   return VK_FALSE;
 }
 
-std::vector<char> Renderer::readFile(const std::string& filename) {
-  std::ifstream file(filename, std::ios::ate | std::ios::binary);
-  if (!file.is_open()) {
-    throw std::runtime_error("Failed to open file: " + filename + "!");
-  }
-
-  size_t fileSize = static_cast<size_t>(file.tellg());
-  std::vector<char> buffer(fileSize);
-  file.seekg(0);
-  file.read(buffer.data(), fileSize);
-
-  file.close();
-
-  return buffer;
-}
-
 void Renderer::checkVKResult(VkResult result) {
   if (VK_SUCCESS != result) {
     throw std::runtime_error("Vulkan result: " + std::to_string(result) + "!");
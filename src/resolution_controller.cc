@@ -0,0 +1,110 @@
+/**
+ * @file resolution_controller.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "resolution_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vkr {
+
+namespace {
+
+const float minScale = .5f;
+const float scaleStep = .05f;
+const double smoothing = .1;
+// Samples taken before the smoothed time is trusted
+const uint32_t minSamples = 8;
+// Frames in flight plus the one being recorded when the scale changed
+const uint32_t settleFrameCount = 4;
+// Raising a step costs about 20% more pixels, so it waits for that much room
+const double raiseThreshold = .8;
+
+}  // namespace
+
+void ResolutionController::setTargetTime(double milliseconds) {
+  this->targetTime_ = std::max(milliseconds, 1.0);
+}
+
+bool ResolutionController::update(double gpuTime) {
+  if (this->settleFrames_) {
+    --this->settleFrames_;
+    this->state_ = Settling;
+    return false;
+  }
+
+  this->smoothedTime_ =
+      this->sampleCount_
+          ? this->smoothedTime_ + smoothing * (gpuTime - this->smoothedTime_)
+          : gpuTime;
+  if (++this->sampleCount_ < minSamples) {
+    this->state_ = Measuring;
+    return false;
+  }
+
+  // Fragment work follows the pixel count, the square of the scale
+  float scale = this->scale_;
+  if (this->smoothedTime_ > this->targetTime_) {
+    float wanted = this->scale_ * static_cast<float>(std::sqrt(
+                                      this->targetTime_ / this->smoothedTime_));
+    scale = std::min(std::floor(wanted / scaleStep) * scaleStep,
+                     this->scale_ - scaleStep);
+    this->state_ = Lowering;
+  } else if (this->smoothedTime_ < this->targetTime_ * raiseThreshold) {
+    scale = this->scale_ + scaleStep;
+    this->state_ = Raising;
+  }
+  scale = std::clamp(scale, minScale, 1.f);
+
+  if (std::abs(scale - this->scale_) < scaleStep * .5f) {
+    this->state_ = Holding;
+    return false;
+  }
+
+  this->scale_ = scale;
+  this->sampleCount_ = 0;
+  this->settleFrames_ = settleFrameCount;
+
+  return true;
+}
+
+void ResolutionController::reset() {
+  this->smoothedTime_ = 0.0;
+  this->scale_ = 1.f;
+  this->sampleCount_ = 0;
+  this->settleFrames_ = 0;
+  this->state_ = Measuring;
+}
+
+float ResolutionController::getScale() const { return this->scale_; }
+
+double ResolutionController::getSmoothedTime() const {
+  return this->smoothedTime_;
+}
+
+const char* ResolutionController::getStateName() const {
+  switch (this->state_) {
+    case Measuring:
+      return "measuring";
+    case Settling:
+      return "settling";
+    case Holding:
+      return "holding";
+    case Lowering:
+      return "lowering";
+    case Raising:
+      return "raising";
+  }
+
+  return "unknown";
+}
+
+}  // namespace vkr
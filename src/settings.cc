@@ -0,0 +1,93 @@
+/**
+ * @file settings.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "settings.h"
+
+namespace vkr {
+
+const char* getPresentModeName(PresentMode presentMode) {
+  switch (presentMode) {
+    case PresentMode::Fifo:
+      return "fifo";
+    case PresentMode::FifoRelaxed:
+      return "fifo-relaxed";
+    case PresentMode::Mailbox:
+      return "mailbox";
+    case PresentMode::Immediate:
+      return "immediate";
+  }
+
+  return "unknown";
+}
+
+bool parsePresentMode(const std::string& name, PresentMode& presentMode) {
+  for (int i = PresentMode::Fifo; i <= PresentMode::Immediate; ++i) {
+    if (name == getPresentModeName(static_cast<PresentMode>(i))) {
+      presentMode = static_cast<PresentMode>(i);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const char* getAntiAliasingName(AntiAliasing antiAliasing) {
+  switch (antiAliasing) {
+    case AntiAliasing::Msaa:
+      return "msaa";
+    case AntiAliasing::Fxaa:
+      return "fxaa";
+    case AntiAliasing::Taa:
+      return "taa";
+  }
+
+  return "unknown";
+}
+
+bool parseAntiAliasing(const std::string& name, AntiAliasing& antiAliasing) {
+  for (int i = AntiAliasing::Msaa; i <= AntiAliasing::Taa; ++i) {
+    if (name == getAntiAliasingName(static_cast<AntiAliasing>(i))) {
+      antiAliasing = static_cast<AntiAliasing>(i);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const char* getShaderFeatureName(ShaderFeature feature) {
+  switch (feature) {
+    case ShaderFeature::VertexColor:
+      return "color";
+    case ShaderFeature::Texturing:
+      return "texture";
+    case ShaderFeature::AlphaTest:
+      return "alpha-test";
+    case ShaderFeature::SampleShading:
+      return "sample-shading";
+  }
+
+  return "unknown";
+}
+
+std::string getShaderVariantName(uint32_t shaderFeatures) {
+  std::string name{};
+  for (uint32_t i = 0; i < shaderFeatureCount; ++i) {
+    if (shaderFeatures & (1u << i)) {
+      name += name.empty() ? "" : "+";
+      name += getShaderFeatureName(static_cast<ShaderFeature>(1u << i));
+    }
+  }
+
+  return name.empty() ? "none" : name;
+}
+
+}  // namespace vkr
@@ -0,0 +1,592 @@
+/**
+ * @file shader_reflection.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "shader_reflection.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace vkr {
+
+namespace {
+
+const uint32_t spirvMagic = 0x07230203;
+
+// Opcodes, decorations and enumerants from the SPIR-V specification
+enum Op : uint32_t {
+  OpEntryPoint = 15,
+  OpTypeInt = 21,
+  OpTypeFloat = 22,
+  OpTypeVector = 23,
+  OpTypeMatrix = 24,
+  OpTypeImage = 25,
+  OpTypeSampler = 26,
+  OpTypeSampledImage = 27,
+  OpTypeArray = 28,
+  OpTypeRuntimeArray = 29,
+  OpTypeStruct = 30,
+  OpTypePointer = 32,
+  OpConstant = 43,
+  OpVariable = 59,
+  OpDecorate = 71,
+  OpMemberDecorate = 72,
+  OpTypeAccelerationStructureKHR = 5341,
+};
+
+enum Decoration : uint32_t {
+  DecorationBlock = 2,
+  DecorationBufferBlock = 3,
+  DecorationArrayStride = 6,
+  DecorationMatrixStride = 7,
+  DecorationBuiltIn = 11,
+  DecorationLocation = 30,
+  DecorationBinding = 33,
+  DecorationDescriptorSet = 34,
+  DecorationOffset = 35,
+};
+
+enum StorageClass : uint32_t {
+  StorageClassUniformConstant = 0,
+  StorageClassInput = 1,
+  StorageClassUniform = 2,
+  StorageClassPushConstant = 9,
+  StorageClassStorageBuffer = 12,
+};
+
+const uint32_t dimBuffer = 5;
+const uint32_t dimSubpassData = 6;
+const uint32_t unset = std::numeric_limits<uint32_t>::max();
+
+struct Decorations {
+  uint32_t set = unset;
+  uint32_t binding = unset;
+  uint32_t location = unset;
+  uint32_t arrayStride = 0;
+  bool builtIn = false;
+  bool block = false;
+  bool bufferBlock = false;
+};
+
+struct MemberDecorations {
+  uint32_t offset = 0;
+  uint32_t matrixStride = 0;
+  bool builtIn = false;
+};
+
+struct Variable {
+  uint32_t id;
+  uint32_t pointerType;
+  uint32_t storageClass;
+};
+
+class Module {
+ public:
+  Module(const uint32_t* code, size_t wordCount);
+
+  ShaderReflection reflect() const;
+
+ private:
+  VkShaderStageFlagBits stage_ = VK_SHADER_STAGE_ALL;
+  // Operands of every type and constant instruction, by result id
+  std::unordered_map<uint32_t, std::vector<uint32_t>> types_;
+  std::unordered_map<uint32_t, uint32_t> constants_;
+  std::unordered_map<uint32_t, Decorations> decorations_;
+  std::unordered_map<uint32_t, std::vector<MemberDecorations>> members_;
+  std::vector<Variable> variables_;
+
+  const std::vector<uint32_t>& getType(uint32_t id) const;
+  Decorations getDecorations(uint32_t id) const;
+  MemberDecorations getMember(uint32_t structId, uint32_t member) const;
+  uint32_t peelArrays(uint32_t typeId, uint32_t& count) const;
+  uint32_t getSize(uint32_t typeId, uint32_t matrixStride) const;
+  VkDescriptorType getDescriptorType(const Variable& variable,
+                                     uint32_t typeId) const;
+  VkFormat getFormat(uint32_t typeId) const;
+  bool hasBuiltInMembers(uint32_t typeId) const;
+};
+
+Module::Module(const uint32_t* code, size_t wordCount) {
+  if (wordCount < 5 || spirvMagic != code[0]) {
+    throw std::runtime_error("Invalid SPIR-V module!");
+  }
+
+  size_t offset = 5;
+  while (offset < wordCount) {
+    uint32_t opcode = code[offset] & 0xffff;
+    uint32_t length = code[offset] >> 16;
+    if (0 == length || offset + length > wordCount) {
+      throw std::runtime_error("Truncated SPIR-V instruction!");
+    }
+    const uint32_t* operands = code + offset + 1;
+    uint32_t operandCount = length - 1;
+    offset += length;
+
+    switch (opcode) {
+      case OpEntryPoint:
+        // First entry point wins, the renderer compiles one per module
+        if (VK_SHADER_STAGE_ALL == stage_ && operandCount >= 1) {
+          static const VkShaderStageFlagBits stages[] = {
+              VK_SHADER_STAGE_VERTEX_BIT,
+              VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+              VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+              VK_SHADER_STAGE_GEOMETRY_BIT,
+              VK_SHADER_STAGE_FRAGMENT_BIT,
+              VK_SHADER_STAGE_COMPUTE_BIT,
+          };
+          if (operands[0] < 6) {
+            stage_ = stages[operands[0]];
+          }
+        }
+        break;
+      case OpTypeInt:
+      case OpTypeFloat:
+      case OpTypeVector:
+      case OpTypeMatrix:
+      case OpTypeImage:
+      case OpTypeSampler:
+      case OpTypeSampledImage:
+      case OpTypeArray:
+      case OpTypeRuntimeArray:
+      case OpTypeStruct:
+      case OpTypePointer:
+      case OpTypeAccelerationStructureKHR:
+        if (operandCount >= 1) {
+          // Opcode first, then every operand after the result id
+          std::vector<uint32_t>& type = types_[operands[0]];
+          type.push_back(opcode);
+          type.insert(type.end(), operands + 1, operands + operandCount);
+        }
+        break;
+      case OpConstant:
+        if (operandCount >= 3) {
+          constants_[operands[1]] = operands[2];
+        }
+        break;
+      case OpVariable:
+        if (operandCount >= 3) {
+          variables_.push_back({operands[1], operands[0], operands[2]});
+        }
+        break;
+      case OpDecorate:
+        if (operandCount >= 2) {
+          Decorations& decorations = decorations_[operands[0]];
+          uint32_t value = operandCount >= 3 ? operands[2] : 0;
+          switch (operands[1]) {
+            case DecorationBlock:
+              decorations.block = true;
+              break;
+            case DecorationBufferBlock:
+              decorations.bufferBlock = true;
+              break;
+            case DecorationArrayStride:
+              decorations.arrayStride = value;
+              break;
+            case DecorationBuiltIn:
+              decorations.builtIn = true;
+              break;
+            case DecorationLocation:
+              decorations.location = value;
+              break;
+            case DecorationBinding:
+              decorations.binding = value;
+              break;
+            case DecorationDescriptorSet:
+              decorations.set = value;
+              break;
+          }
+        }
+        break;
+      case OpMemberDecorate:
+        if (operandCount >= 3) {
+          auto& members = members_[operands[0]];
+          if (members.size() <= operands[1]) {
+            members.resize(operands[1] + 1);
+          }
+          MemberDecorations& member = members[operands[1]];
+          uint32_t value = operandCount >= 4 ? operands[3] : 0;
+          switch (operands[2]) {
+            case DecorationOffset:
+              member.offset = value;
+              break;
+            case DecorationMatrixStride:
+              member.matrixStride = value;
+              break;
+            case DecorationBuiltIn:
+              member.builtIn = true;
+              break;
+          }
+        }
+        break;
+    }
+  }
+
+  if (VK_SHADER_STAGE_ALL == stage_) {
+    throw std::runtime_error("SPIR-V module has no entry point!");
+  }
+}
+
+ShaderReflection Module::reflect() const {
+  ShaderReflection reflection{};
+  reflection.stage = stage_;
+
+  uint32_t pushConstantEnd = 0;
+  for (const Variable& variable : variables_) {
+    const std::vector<uint32_t>& pointer = getType(variable.pointerType);
+    if (OpTypePointer != pointer[0] || pointer.size() < 3) {
+      continue;
+    }
+    uint32_t typeId = pointer[2];
+    Decorations decorations = getDecorations(variable.id);
+
+    switch (variable.storageClass) {
+      case StorageClassUniformConstant:
+      case StorageClassUniform:
+      case StorageClassStorageBuffer: {
+        if (unset == decorations.binding) {
+          continue;
+        }
+        uint32_t count = 1;
+        uint32_t elementType = peelArrays(typeId, count);
+        ShaderBinding binding{};
+        binding.set = unset == decorations.set ? 0 : decorations.set;
+        binding.binding = decorations.binding;
+        binding.descriptorType = getDescriptorType(variable, elementType);
+        binding.descriptorCount = count;
+        reflection.bindings.push_back(binding);
+        break;
+      }
+      case StorageClassPushConstant: {
+        const std::vector<uint32_t>& block = getType(typeId);
+        uint32_t begin = unset;
+        for (uint32_t i = 1; i < block.size(); ++i) {
+          MemberDecorations member = getMember(typeId, i - 1);
+          begin = std::min(begin, member.offset);
+          pushConstantEnd = std::max(
+              pushConstantEnd,
+              member.offset + getSize(block[i], member.matrixStride));
+        }
+        if (unset != begin) {
+          reflection.pushConstantOffset = begin;
+          reflection.pushConstantSize = pushConstantEnd - begin;
+        }
+        break;
+      }
+      case StorageClassInput: {
+        if (VK_SHADER_STAGE_VERTEX_BIT != stage_ || decorations.builtIn ||
+            unset == decorations.location || hasBuiltInMembers(typeId)) {
+          continue;
+        }
+        // Matrices take one location per column
+        const std::vector<uint32_t>& type = getType(typeId);
+        uint32_t columns = OpTypeMatrix == type[0] ? type[2] : 1;
+        uint32_t columnType = OpTypeMatrix == type[0] ? type[1] : typeId;
+        for (uint32_t i = 0; i < columns; ++i) {
+          reflection.inputs.push_back(
+              {decorations.location + i, getFormat(columnType)});
+        }
+        break;
+      }
+    }
+  }
+
+  std::sort(reflection.bindings.begin(), reflection.bindings.end(),
+            [](const ShaderBinding& lhs, const ShaderBinding& rhs) {
+              return lhs.set != rhs.set ? lhs.set < rhs.set
+                                        : lhs.binding < rhs.binding;
+            });
+  std::sort(reflection.inputs.begin(), reflection.inputs.end(),
+            [](const ShaderInput& lhs, const ShaderInput& rhs) {
+              return lhs.location < rhs.location;
+            });
+
+  return reflection;
+}
+
+const std::vector<uint32_t>& Module::getType(uint32_t id) const {
+  auto it = types_.find(id);
+  if (types_.end() == it) {
+    throw std::runtime_error("SPIR-V type " + std::to_string(id) +
+                             " is not declared!");
+  }
+
+  return it->second;
+}
+
+Decorations Module::getDecorations(uint32_t id) const {
+  auto it = decorations_.find(id);
+  return decorations_.end() == it ? Decorations{} : it->second;
+}
+
+MemberDecorations Module::getMember(uint32_t structId, uint32_t member) const {
+  auto it = members_.find(structId);
+  if (members_.end() == it || it->second.size() <= member) {
+    return MemberDecorations{};
+  }
+
+  return it->second[member];
+}
+
+uint32_t Module::peelArrays(uint32_t typeId, uint32_t& count) const {
+  const std::vector<uint32_t>* type = &getType(typeId);
+  while (OpTypeArray == (*type)[0] || OpTypeRuntimeArray == (*type)[0]) {
+    if (OpTypeRuntimeArray == (*type)[0]) {
+      throw std::runtime_error("Unsized descriptor arrays are not supported!");
+    }
+    auto length = constants_.find((*type)[2]);
+    if (constants_.end() == length) {
+      throw std::runtime_error("Descriptor array length is not a constant!");
+    }
+    count *= length->second;
+    typeId = (*type)[1];
+    type = &getType(typeId);
+  }
+
+  return typeId;
+}
+
+uint32_t Module::getSize(uint32_t typeId, uint32_t matrixStride) const {
+  const std::vector<uint32_t>& type = getType(typeId);
+  switch (type[0]) {
+    case OpTypeInt:
+    case OpTypeFloat:
+      return type[1] / 8;
+    case OpTypeVector:
+      return type[2] * getSize(type[1], 0);
+    case OpTypeMatrix:
+      return type[2] * (matrixStride ? matrixStride : getSize(type[1], 0));
+    case OpTypeArray: {
+      auto length = constants_.find(type[2]);
+      uint32_t count = constants_.end() == length ? 1 : length->second;
+      uint32_t stride = getDecorations(typeId).arrayStride;
+      return count * (stride ? stride : getSize(type[1], matrixStride));
+    }
+    case OpTypeStruct: {
+      uint32_t size = 0;
+      for (uint32_t i = 1; i < type.size(); ++i) {
+        MemberDecorations member = getMember(typeId, i - 1);
+        size = std::max(size, member.offset +
+                                  getSize(type[i], member.matrixStride));
+      }
+      return size;
+    }
+  }
+
+  throw std::runtime_error("Push constant member has no size!");
+}
+
+VkDescriptorType Module::getDescriptorType(const Variable& variable,
+                                           uint32_t typeId) const {
+  const std::vector<uint32_t>& type = getType(typeId);
+  switch (type[0]) {
+    case OpTypeSampledImage:
+      return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    case OpTypeSampler:
+      return VK_DESCRIPTOR_TYPE_SAMPLER;
+    case OpTypeImage: {
+      // Sampled type, Dim, Depth, Arrayed, MS, Sampled, Format
+      uint32_t dim = type[2];
+      bool storage = 2 == type[6];
+      if (dimSubpassData == dim) {
+        return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+      }
+      if (dimBuffer == dim) {
+        return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                       : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+      }
+      return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                     : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    }
+    case OpTypeAccelerationStructureKHR:
+      return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+    case OpTypeStruct:
+      // GLSL before SPIR-V 1.3 marks storage buffers with BufferBlock
+      if (StorageClassStorageBuffer == variable.storageClass ||
+          getDecorations(typeId).bufferBlock) {
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      }
+      return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  }
+
+  throw std::runtime_error("Unsupported descriptor type in SPIR-V module!");
+}
+
+VkFormat Module::getFormat(uint32_t typeId) const {
+  const std::vector<uint32_t>& type = getType(typeId);
+  uint32_t components = OpTypeVector == type[0] ? type[2] : 1;
+  const std::vector<uint32_t>& scalar =
+      OpTypeVector == type[0] ? getType(type[1]) : type;
+  if (32 != scalar[1] || components < 1 || components > 4) {
+    return VK_FORMAT_UNDEFINED;
+  }
+
+  static const VkFormat floats[] = {
+      VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+      VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+  static const VkFormat ints[] = {
+      VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT,
+      VK_FORMAT_R32G32B32A32_SINT};
+  static const VkFormat uints[] = {
+      VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT,
+      VK_FORMAT_R32G32B32A32_UINT};
+  if (OpTypeFloat == scalar[0]) {
+    return floats[components - 1];
+  }
+  if (OpTypeInt == scalar[0]) {
+    return scalar[2] ? ints[components - 1] : uints[components - 1];
+  }
+
+  return VK_FORMAT_UNDEFINED;
+}
+
+bool Module::hasBuiltInMembers(uint32_t typeId) const {
+  auto it = members_.find(typeId);
+  if (members_.end() == it) {
+    return false;
+  }
+
+  return std::any_of(
+      it->second.begin(), it->second.end(),
+      [](const MemberDecorations& member) { return member.builtIn; });
+}
+
+enum NumericType {
+  NumericUnknown,
+  NumericFloat,
+  NumericSint,
+  NumericUint,
+};
+
+NumericType getNumericType(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R32_SFLOAT:
+    case VK_FORMAT_R32G32_SFLOAT:
+    case VK_FORMAT_R32G32B32_SFLOAT:
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+    case VK_FORMAT_R16G16_SFLOAT:
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SNORM:
+    case VK_FORMAT_R16G16_UNORM:
+    case VK_FORMAT_R16G16_SNORM:
+    case VK_FORMAT_R16G16B16A16_UNORM:
+    case VK_FORMAT_R16G16B16A16_SNORM:
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+    case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
+      return NumericFloat;
+    case VK_FORMAT_R32_SINT:
+    case VK_FORMAT_R32G32_SINT:
+    case VK_FORMAT_R32G32B32_SINT:
+    case VK_FORMAT_R32G32B32A32_SINT:
+    case VK_FORMAT_R8G8B8A8_SINT:
+    case VK_FORMAT_R16G16B16A16_SINT:
+      return NumericSint;
+    case VK_FORMAT_R32_UINT:
+    case VK_FORMAT_R32G32_UINT:
+    case VK_FORMAT_R32G32B32_UINT:
+    case VK_FORMAT_R32G32B32A32_UINT:
+    case VK_FORMAT_R8G8B8A8_UINT:
+    case VK_FORMAT_R16G16B16A16_UINT:
+      return NumericUint;
+    default:
+      return NumericUnknown;
+  }
+}
+
+}  // namespace
+
+ShaderReflection reflectShader(const uint32_t* code, size_t wordCount) {
+  return Module(code, wordCount).reflect();
+}
+
+PipelineLayoutDescription mergeReflections(
+    const std::vector<ShaderReflection>& reflections) {
+  PipelineLayoutDescription description{};
+
+  VkPushConstantRange pushConstantRange{};
+  uint32_t pushConstantEnd = 0;
+  for (const ShaderReflection& reflection : reflections) {
+    for (const ShaderBinding& binding : reflection.bindings) {
+      if (description.sets.size() <= binding.set) {
+        description.sets.resize(binding.set + 1);
+      }
+      auto& set = description.sets[binding.set];
+      auto it = std::find_if(set.begin(), set.end(),
+                             [&](const VkDescriptorSetLayoutBinding& other) {
+                               return other.binding == binding.binding;
+                             });
+      if (set.end() == it) {
+        VkDescriptorSetLayoutBinding layoutBinding{};
+        layoutBinding.binding = binding.binding;
+        layoutBinding.descriptorType = binding.descriptorType;
+        layoutBinding.descriptorCount = binding.descriptorCount;
+        layoutBinding.stageFlags = reflection.stage;
+        layoutBinding.pImmutableSamplers = nullptr;
+        set.push_back(layoutBinding);
+      } else if (it->descriptorType != binding.descriptorType ||
+                 it->descriptorCount != binding.descriptorCount) {
+        throw std::runtime_error(
+            "Stages disagree on set " + std::to_string(binding.set) +
+            ", binding " + std::to_string(binding.binding) + "!");
+      } else {
+        it->stageFlags |= reflection.stage;
+      }
+    }
+
+    if (reflection.pushConstantSize) {
+      uint32_t end =
+          reflection.pushConstantOffset + reflection.pushConstantSize;
+      if (!pushConstantRange.stageFlags) {
+        pushConstantRange.offset = reflection.pushConstantOffset;
+      }
+      pushConstantRange.offset =
+          std::min(pushConstantRange.offset, reflection.pushConstantOffset);
+      pushConstantEnd = std::max(pushConstantEnd, end);
+      pushConstantRange.stageFlags |= reflection.stage;
+    }
+  }
+
+  if (pushConstantRange.stageFlags) {
+    pushConstantRange.size = pushConstantEnd - pushConstantRange.offset;
+    description.pushConstantRanges.push_back(pushConstantRange);
+  }
+
+  return description;
+}
+
+void validateVertexInputs(
+    const ShaderReflection& reflection,
+    const std::vector<VkVertexInputAttributeDescription>& attributes,
+    const std::string& name) {
+  for (const ShaderInput& input : reflection.inputs) {
+    auto it = std::find_if(attributes.begin(), attributes.end(),
+                           [&](const VkVertexInputAttributeDescription& a) {
+                             return a.location == input.location;
+                           });
+    if (attributes.end() == it) {
+      throw std::runtime_error("No vertex attribute for location " +
+                               std::to_string(input.location) + " of " +
+                               name + "!");
+    }
+
+    NumericType expected = getNumericType(input.format);
+    NumericType provided = getNumericType(it->format);
+    if (NumericUnknown != expected && NumericUnknown != provided &&
+        expected != provided) {
+      throw std::runtime_error("Vertex attribute at location " +
+                               std::to_string(input.location) + " of " +
+                               name + " has the wrong numeric type!");
+    }
+  }
+}
+
+}  // namespace vkr
@@ -0,0 +1,155 @@
+/**
+ * @file shadows.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "shadows.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "transform.h"
+
+namespace vkr {
+
+namespace {
+
+// Blend of uniform and logarithmic splits, more logarithmic towards 1
+const float splitBlend = .75f;
+// Cached cascades cover this much more than their slice needs, so the
+// camera can move a while before they are rendered again
+const float cacheMargin = 1.25f;
+
+glm::mat4 getLightView(const glm::vec3& sunDirection) {
+  glm::vec3 up = std::abs(sunDirection.z) < .99f ? glm::vec3(0.f, 0.f, 1.f)
+                                                 : glm::vec3(0.f, 1.f, 0.f);
+  return glm::lookAt(glm::vec3(0.f), -sunDirection, up);
+}
+
+}  // namespace
+
+void ShadowCascades::update(const glm::mat4& view,
+                            const glm::mat4& projection,
+                            const glm::vec3& sunDirection,
+                            const glm::vec4& bounds, bool caching,
+                            uint32_t updateBudget) {
+  ++frame_;
+  glm::vec3 direction = glm::normalize(sunDirection);
+  glm::mat4 lightView = getLightView(direction);
+  glm::mat4 sceneToLight = lightView * glm::inverse(view);
+  // Squared distance from the view axis to a frustum corner at depth 1
+  float tangents = 1.f / (projection[0][0] * projection[0][0]) +
+                   1.f / (projection[1][1] * projection[1][1]);
+
+  std::array<glm::vec3, shadowCascadeCount> centers{};
+  std::array<float, shadowCascadeCount> radii{};
+  float previousSplit = nearPlane;
+  for (uint32_t i = 0; i < shadowCascadeCount; ++i) {
+    float t = (i + 1) / static_cast<float>(shadowCascadeCount);
+    float split =
+        glm::mix(nearPlane + (farPlane - nearPlane) * t,
+                 nearPlane * std::pow(farPlane / nearPlane, t), splitBlend);
+
+    // The smallest sphere around the slice is centered on the view axis,
+    // at the depth where its near and far corners are equally far away.
+    // Rounded up, so float noise does not change the texel size
+    float depth =
+        std::min((previousSplit + split) * (1.f + tangents) * .5f, split);
+    float radius = std::sqrt((split - depth) * (split - depth) +
+                             split * split * tangents);
+    radii[i] = std::ceil(radius * 64.f) / 64.f;
+    centers[i] = glm::vec3(sceneToLight * glm::vec4(0.f, 0.f, -depth, 1.f));
+    previousSplit = split;
+
+    Cascade& cascade = cascades_[i];
+    bool cached = caching && shadowNearCascadeCount <= i;
+    glm::vec2 offset =
+        glm::abs(glm::vec2(centers[i]) - cascade.center) + radii[i];
+    bool covered = cascade.valid && version_ == cascade.version &&
+                   direction == cascade.direction &&
+                   offset.x <= cascade.halfExtent &&
+                   offset.y <= cascade.halfExtent;
+    cascade.due = !cached || !covered;
+    if (cached && covered) {
+      ++hits_;
+    } else if (cached) {
+      ++misses_;
+    }
+  }
+
+  // The cached cascades that waited longest take the budget, the rest keep
+  // what they have until a later frame
+  for (uint32_t i = shadowNearCascadeCount; caching && i < shadowCascadeCount;
+       ++i) {
+    uint32_t earlier = 0;
+    for (uint32_t j = shadowNearCascadeCount; j < shadowCascadeCount; ++j) {
+      const Cascade& other = cascades_[j];
+      if (other.due && j != i &&
+          (other.renderedFrame < cascades_[i].renderedFrame ||
+           (other.renderedFrame == cascades_[i].renderedFrame && j < i))) {
+        ++earlier;
+      }
+    }
+    cascades_[i].due = cascades_[i].due && earlier < updateBudget;
+  }
+
+  // The depth range spans every caster, whatever the slice covers
+  glm::vec3 boundsCenter = glm::vec3(lightView * glm::vec4(glm::vec3(bounds),
+                                                           1.f));
+  float boundsRadius = std::max(bounds.w, nearPlane);
+  for (uint32_t i = 0; i < shadowCascadeCount; ++i) {
+    Cascade& cascade = cascades_[i];
+    if (!cascade.due) {
+      continue;
+    }
+
+    bool cached = caching && shadowNearCascadeCount <= i;
+    cascade.halfExtent = cached ? radii[i] * cacheMargin : radii[i];
+    cascade.texelSize = 2.f * cascade.halfExtent / shadowMapSize;
+    cascade.center =
+        glm::floor(glm::vec2(centers[i]) / cascade.texelSize + .5f) *
+        cascade.texelSize;
+    glm::mat4 projection = glm::orthoRH_ZO(
+        cascade.center.x - cascade.halfExtent,
+        cascade.center.x + cascade.halfExtent,
+        cascade.center.y - cascade.halfExtent,
+        cascade.center.y + cascade.halfExtent,
+        -boundsCenter.z - boundsRadius, -boundsCenter.z + boundsRadius);
+    cascade.matrix = projection * lightView;
+    cascade.direction = direction;
+    cascade.version = version_;
+    cascade.renderedFrame = frame_;
+    cascade.valid = true;
+  }
+}
+
+void ShadowCascades::invalidate() { ++version_; }
+
+bool ShadowCascades::isDue(uint32_t cascade) const {
+  return cascades_[cascade].due;
+}
+
+bool ShadowCascades::isValid(uint32_t cascade) const {
+  return cascades_[cascade].valid;
+}
+
+const glm::mat4& ShadowCascades::getMatrix(uint32_t cascade) const {
+  return cascades_[cascade].matrix;
+}
+
+float ShadowCascades::getTexelSize(uint32_t cascade) const {
+  return cascades_[cascade].texelSize;
+}
+
+uint64_t ShadowCascades::getHits() const { return hits_; }
+
+uint64_t ShadowCascades::getMisses() const { return misses_; }
+
+}  // namespace vkr
@@ -0,0 +1,80 @@
+/**
+ * @file transform.cc
+ * @author MaoZ (mao.zhang233@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "transform.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VK_RENDERER_TRANSFORM_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace vkr {
+
+namespace {
+
+#ifdef VK_RENDERER_TRANSFORM_SSE
+struct Columns {
+  __m128 c0;
+  __m128 c1;
+  __m128 c2;
+  __m128 c3;
+};
+
+inline Columns load(const glm::mat4& m) {
+  return {_mm_loadu_ps(&m[0][0]), _mm_loadu_ps(&m[1][0]),
+          _mm_loadu_ps(&m[2][0]), _mm_loadu_ps(&m[3][0])};
+}
+
+// Column j of lhs * rhs is lhs applied to column j of rhs
+inline __m128 combine(const Columns& lhs, const float* column) {
+  __m128 result = _mm_mul_ps(lhs.c0, _mm_set1_ps(column[0]));
+  result = _mm_add_ps(result, _mm_mul_ps(lhs.c1, _mm_set1_ps(column[1])));
+  result = _mm_add_ps(result, _mm_mul_ps(lhs.c2, _mm_set1_ps(column[2])));
+  result = _mm_add_ps(result, _mm_mul_ps(lhs.c3, _mm_set1_ps(column[3])));
+  return result;
+}
+
+inline void multiply(const Columns& lhs, const glm::mat4& rhs,
+                     glm::mat4& out) {
+  // All columns are computed before storing, out may alias rhs
+  __m128 r0 = combine(lhs, &rhs[0][0]);
+  __m128 r1 = combine(lhs, &rhs[1][0]);
+  __m128 r2 = combine(lhs, &rhs[2][0]);
+  __m128 r3 = combine(lhs, &rhs[3][0]);
+  _mm_storeu_ps(&out[0][0], r0);
+  _mm_storeu_ps(&out[1][0], r1);
+  _mm_storeu_ps(&out[2][0], r2);
+  _mm_storeu_ps(&out[3][0], r3);
+}
+#endif
+
+}  // namespace
+
+glm::mat4 getProjection(float aspect) {
+  glm::mat4 proj = glm::perspective(glm::radians(45.f), aspect, nearPlane,
+                                    farPlane);
+  proj[1][1] *= -1.f;
+
+  return proj;
+}
+
+void multiply(const glm::mat4& lhs, const glm::mat4& rhs, glm::mat4& out) {
+#ifdef VK_RENDERER_TRANSFORM_SSE
+  multiply(load(lhs), rhs, out);
+#else
+  out = lhs * rhs;
+#endif
+}
+
+}  // namespace vkr
@@ -58,7 +58,7 @@ void Window::getFramebufferSize(int* width, int* height) const {
 void Window::frameBufferResizeCallback(GLFWwindow* window, int width,
                                        int height) {
   auto renderer = reinterpret_cast<Renderer*>(glfwGetWindowUserPointer(window));
-  renderer->setFramebufferResized(true);
+  renderer->setFramebufferSize(width, height);
 }
 
 }  // namespace vkr